@@ -1,8 +1,9 @@
 #ifndef __NEWTONSIM__H
 #define __NEWTONSIM__H
 
+#include <deque>
 #include <functional>
-#include <map>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -24,9 +25,14 @@ class NewtonSim {
     int GetChannel(uint64_t hex_addr) const;
     void PrintStats() const;
     void ResetStats();
+    // DRAM state at a point where no transaction is in flight (see Controller::Save)
+    void SaveState(std::ostream &os) const;
+    void LoadState(std::istream &is);
 
     uint64_t GetAvgPIMCycles();
     void ResetPIMCycle();
+    // cycles the PIM queue of `channel` was held back by refresh
+    uint64_t GetRefreshStallCycles(int channel);
 
     uint64_t MakeAddress(int channel, int rank, int bankgroup, int bank, int row, int col);
     uint64_t EncodePIMHeader(int channel, int row, bool for_gwrite, int num_comps, int num_readres);
@@ -50,13 +56,9 @@ class NewtonSim {
     std::vector<ResponseQueue> response_queues_rd_;
     std::vector<ResponseQueue> response_queues_wr_;
     std::vector<ResponseQueue> response_queues_pim_;
-    std::multimap<uint64_t, void *> pending_read_q_;
-    std::multimap<uint64_t, void *> pending_write_q_;
 
     int income_req_cnt_ = 0;
     int outcome_req_cnt_ = 0;
-
-    void PushToPendingQueue(uint64_t addr, TransactionType req_type, void *original_req);
 };
 class NewtonSim::ResponseQueue {
   public:
@@ -72,7 +74,7 @@ class NewtonSim::ResponseQueue {
   private:
     const uint32_t Size;
     uint32_t NumReserved;
-    std::vector<void *> OutputQueue;
+    std::deque<void *> OutputQueue;
 };
 
 } // namespace dramsim3
@@ -7,30 +7,13 @@
 namespace dramsim3 {
 NewtonSim::NewtonSim(const std::string &config_file, const std::string &output_dir)
     : config_(new Config(config_file, output_dir)) {
-    std::function<void(uint64_t)> read_callback = [&](uint64_t addr) {
-        PrintInfo("(NewtonSim) read_callback");
-        int channel = GetChannel(addr);
-        assert(pending_read_q_.count(addr) > 0);
-        if (pending_read_q_.count(addr) == 0)
-            exit(1);
-
-        auto it = pending_read_q_.find(addr);       // search
-        response_queues_[channel].push(it->second); // push
-        pending_read_q_.erase(it);                  // pop
-    };
-    std::function<void(uint64_t)> write_callback = [&](uint64_t addr) {
-        PrintInfo("(NewtonSim) write_callback");
-        int channel = GetChannel(addr);
-        assert(pending_write_q_.count(addr) > 0); // assert does not work
-        if (pending_write_q_.count(addr) == 0)
-            exit(1);
-
-        auto it = pending_write_q_.find(addr);      // search
-        response_queues_[channel].push(it->second); // push
-        pending_write_q_.erase(it);                 // pop
+    // the controllers carry original_req with the transaction, so it comes back directly
+    TransactionCallback callback = [&](uint64_t addr, void *original_req) {
+        PrintInfo("(NewtonSim) callback");
+        response_queues_[GetChannel(addr)].push(original_req);
     };
 
-    dram_system_ = new JedecDRAMSystem(*config_, output_dir, read_callback, write_callback);
+    dram_system_ = new JedecDRAMSystem(*config_, output_dir, callback, callback);
 
     // printf("Newtonsim: # of channel= %d\n", config_->channels);
     // # channels = # reponse queues,
@@ -54,6 +37,9 @@ NewtonSim::NewtonSim(const std::string &config_file, const std::string &output_d
 
 uint64_t NewtonSim::GetAvgPIMCycles() { return dram_system_->GetAvgPIMCycles(); }
 void NewtonSim::ResetPIMCycle() { dram_system_->ResetPIMCycle(); }
+uint64_t NewtonSim::GetRefreshStallCycles(int channel) {
+    return dram_system_->GetRefreshStallCycles(channel);
+}
 
 NewtonSim::~NewtonSim() {
     // std::cout << "NewtonSim delete" << std::endl;
@@ -106,29 +92,10 @@ bool NewtonSim::AddTransaction(uint64_t hex_addr, int req_type, void *original_r
     int channel = GetChannel(hex_addr);
     if (type != TransactionType::P_HEADER) {
         response_queues_[channel].reserve();
-        PushToPendingQueue(hex_addr, type, original_req);
         income_req_cnt_++;
     }
 
-    return dram_system_->AddTransaction(hex_addr, type);
-}
-
-void NewtonSim::PushToPendingQueue(uint64_t addr, TransactionType req_type, void *original_req) {
-    switch (req_type) {
-    case TransactionType::GWRITE:
-    case TransactionType::COMP:
-    case TransactionType::READRES:
-    case TransactionType::READ:
-    case TransactionType::COMPS_READRES:
-        pending_read_q_.insert(std::make_pair(addr, original_req));
-        break;
-    case TransactionType::WRITE:
-        pending_write_q_.insert(std::make_pair(addr, original_req));
-        break;
-    default: // P_HEADER
-        break;
-    }
-    return;
+    return dram_system_->AddTransaction(hex_addr, type, original_req);
 }
 
 bool NewtonSim::IsEmpty(uint32_t channel) const {
@@ -150,6 +117,14 @@ void NewtonSim::PrintStats() const { dram_system_->PrintStats(); }
 
 void NewtonSim::ResetStats() { dram_system_->ResetStats(); }
 
+void NewtonSim::SaveState(std::ostream &os) const {
+    for (auto &response_queue : response_queues_)
+        if (!response_queue.isEmpty()) PrintError("cannot checkpoint with pending responses");
+    dram_system_->Save(os);
+}
+
+void NewtonSim::LoadState(std::istream &is) { dram_system_->Load(is); }
+
 NewtonSim::ResponseQueue::ResponseQueue(int Size) : Size(Size), NumReserved(0) {}
 
 bool NewtonSim::ResponseQueue::isAvailable() const {
@@ -174,10 +149,7 @@ void NewtonSim::ResponseQueue::push(void *original_req) {
 
 bool NewtonSim::ResponseQueue::isEmpty() const { return OutputQueue.empty(); }
 
-void NewtonSim::ResponseQueue::pop() {
-    auto it = OutputQueue.begin();
-    OutputQueue.erase(it);
-}
+void NewtonSim::ResponseQueue::pop() { OutputQueue.pop_front(); }
 void *NewtonSim::ResponseQueue::top() const { return OutputQueue.front(); }
 
 } // namespace dramsim3
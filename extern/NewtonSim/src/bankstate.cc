@@ -579,4 +579,29 @@ void BankState::UpdateStateSingle(const Command &cmd) {
     return;
 }
 
+void BankState::Save(std::ostream &os) const {
+    SaveState(os, static_cast<int>(state_));
+    SaveState(os, static_cast<int>(pim_state_));
+    SaveState(os, pim_lock_);
+    SaveState(os, cmd_timing_);
+    SaveState(os, open_row_);
+    SaveState(os, pim_open_row_);
+    SaveState(os, row_hit_count_);
+    SaveState(os, pim_enter_count_);
+}
+
+void BankState::Load(std::istream &is) {
+    int state, pim_state;
+    LoadState(is, state);
+    LoadState(is, pim_state);
+    state_ = static_cast<State>(state);
+    pim_state_ = static_cast<State>(pim_state);
+    LoadState(is, pim_lock_);
+    LoadState(is, cmd_timing_);
+    LoadState(is, open_row_);
+    LoadState(is, pim_open_row_);
+    LoadState(is, row_hit_count_);
+    LoadState(is, pim_enter_count_);
+}
+
 }  // namespace dramsim3
@@ -42,6 +42,8 @@ class BankState {
     int OpenRow() const { return open_row_; }
     int PIMOpenRow() const { return enable_dual_buffer_ ? pim_open_row_ : open_row_; }
     int RowHitCount() const { return row_hit_count_; }
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
     std::string StateToString() const {
         switch (state_) {
             case State::OPEN:
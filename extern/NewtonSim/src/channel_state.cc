@@ -25,6 +25,32 @@ ChannelState::ChannelState(int channel_id, const Config &config, const Timing &t
 }
 
 // gsheo: just for all idle cycle count purpose.
+void ChannelState::Save(std::ostream &os) const {
+    SaveState(os, rank_is_sref_);
+    for (auto &rank : bank_states_)
+        for (auto &bankgroup : rank)
+            for (auto &bank : bankgroup) bank.Save(os);
+    SaveState(os, refresh_q_);
+    SaveState(os, four_aw_);
+    SaveState(os, thirty_two_aw_);
+    SaveState(os, comp_overhead_flag_);
+    SaveState(os, rank_idle_cycles);
+    SaveState(os, pim_open_row_);
+}
+
+void ChannelState::Load(std::istream &is) {
+    LoadState(is, rank_is_sref_);
+    for (auto &rank : bank_states_)
+        for (auto &bankgroup : rank)
+            for (auto &bank : bankgroup) bank.Load(is);
+    LoadState(is, refresh_q_);
+    LoadState(is, four_aw_);
+    LoadState(is, thirty_two_aw_);
+    LoadState(is, comp_overhead_flag_);
+    LoadState(is, rank_idle_cycles);
+    LoadState(is, pim_open_row_);
+}
+
 bool ChannelState::IsAllBankIdleInRank(int rank) const {
     for (int j = 0; j < config_.bankgroups; j++) {
         for (int k = 0; k < config_.banks_per_group; k++) {
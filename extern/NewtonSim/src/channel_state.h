@@ -44,6 +44,9 @@ class ChannelState {
 
     int EstimatePIMOperationLatency(const Command &cmd, uint64_t clk);
 
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
+
     std::vector<int> rank_idle_cycles;
     int pim_open_row_ = -1;
 
@@ -33,6 +33,24 @@ CommandQueue::CommandQueue(int channel_id, const Config &config, const ChannelSt
 }
 
 // called from controller:ClockTick()
+void CommandQueue::Save(std::ostream &os) const {
+    SaveState(os, queues_);
+    SaveState(os, ref_q_indices_);
+    SaveState(os, is_in_ref_);
+    SaveState(os, queue_idx_);
+    SaveState(os, clk_);
+    SaveState(os, rank_q_empty);
+}
+
+void CommandQueue::Load(std::istream &is) {
+    LoadState(is, queues_);
+    LoadState(is, ref_q_indices_);
+    LoadState(is, is_in_ref_);
+    LoadState(is, queue_idx_);
+    LoadState(is, clk_);
+    LoadState(is, rank_q_empty);
+}
+
 Command CommandQueue::GetCommandToIssue() {
     for (int i = 0; i < num_queues_; i++) {
         auto &queue = GetNextQueue();
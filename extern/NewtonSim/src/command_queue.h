@@ -26,6 +26,8 @@ class CommandQueue {
     bool AddCommand(Command cmd);
     bool QueueEmpty() const;
     int QueueUsage() const;
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
     std::vector<bool> rank_q_empty;
 
    private:
@@ -51,6 +51,39 @@ std::istream &operator>>(std::istream &is, Transaction &trans) {
     return is;
 }
 
+void SaveState(std::ostream &os, const Address &addr) {
+    for (int field : {addr.channel, addr.rank, addr.bankgroup, addr.bank, addr.row, addr.column})
+        SaveState(os, field);
+}
+
+void LoadState(std::istream &is, Address &addr) {
+    for (int *field :
+         {&addr.channel, &addr.rank, &addr.bankgroup, &addr.bank, &addr.row, &addr.column})
+        LoadState(is, *field);
+}
+
+void SaveState(std::ostream &os, const Command &cmd) {
+    SaveState(os, static_cast<int>(cmd.cmd_type));
+    SaveState(os, cmd.addr);
+    SaveState(os, cmd.hex_addr);
+    SaveState(os, cmd.for_gwrite);
+    SaveState(os, cmd.num_comps);
+    SaveState(os, cmd.num_readres);
+    SaveState(os, cmd.is_last_comps);
+}
+
+void LoadState(std::istream &is, Command &cmd) {
+    int cmd_type;
+    LoadState(is, cmd_type);
+    cmd.cmd_type = static_cast<CommandType>(cmd_type);
+    LoadState(is, cmd.addr);
+    LoadState(is, cmd.hex_addr);
+    LoadState(is, cmd.for_gwrite);
+    LoadState(is, cmd.num_comps);
+    LoadState(is, cmd.num_readres);
+    LoadState(is, cmd.is_last_comps);
+}
+
 int GetBitInPos(uint64_t bits, int pos) {
     // given a uint64_t value get the binary value of pos-th bit
     // from MSB to LSB indexed as 63 - 0
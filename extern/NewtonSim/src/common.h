@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace dramsim3 {
@@ -264,15 +265,17 @@ enum class TransactionType {
 
 struct Transaction {
     Transaction() {}
-    Transaction(uint64_t addr, TransactionType req_type)
-        : addr(addr), added_cycle(0), complete_cycle(0), req_type(req_type) {}
+    Transaction(uint64_t addr, TransactionType req_type, void *handle = nullptr)
+        : addr(addr), added_cycle(0), complete_cycle(0), req_type(req_type), handle(handle) {}
     Transaction(const Transaction &tran)
         : addr(tran.addr), added_cycle(tran.added_cycle), complete_cycle(tran.complete_cycle),
-          req_type(tran.req_type) {}
+          req_type(tran.req_type), handle(tran.handle) {}
     uint64_t addr;
     uint64_t added_cycle;
     uint64_t complete_cycle;
     TransactionType req_type;
+    // opaque pointer of the requester, handed back untouched on completion
+    void *handle = nullptr;
     bool is_dram_trans() const {
         return req_type == TransactionType::WRITE || req_type == TransactionType::READ;
     }
@@ -385,5 +388,43 @@ std::string HexString(uint64_t addr);
 void PrintControllerLog(std::string method_name, int channel_id, int clk, const Command &cmd);
 void PrintTransactionLog(std::string method_name, int channel_id, int clk,
                          const Transaction &trans);
+
+// Checkpoints are whitespace separated text, loaded in the order they were saved
+template <typename T> void SaveState(std::ostream &os, const T &value) { os << value << ' '; }
+template <typename T> void LoadState(std::istream &is, T &value) { is >> value; }
+void SaveState(std::ostream &os, const Address &addr);
+void LoadState(std::istream &is, Address &addr);
+void SaveState(std::ostream &os, const Command &cmd);
+void LoadState(std::istream &is, Command &cmd);
+
+template <typename T> void SaveState(std::ostream &os, const std::vector<T> &values) {
+    SaveState(os, values.size());
+    for (size_t i = 0; i < values.size(); i++) SaveState(os, values[i]);
+}
+template <typename T> void LoadState(std::istream &is, std::vector<T> &values) {
+    size_t size;
+    LoadState(is, size);
+    values.clear();
+    values.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        T value;
+        LoadState(is, value);
+        values.push_back(value);
+    }
+}
+template <typename T> void SaveState(std::ostream &os, const std::unordered_set<T> &values) {
+    SaveState(os, values.size());
+    for (auto &value : values) SaveState(os, value);
+}
+template <typename T> void LoadState(std::istream &is, std::unordered_set<T> &values) {
+    size_t size;
+    LoadState(is, size);
+    values.clear();
+    for (size_t i = 0; i < size; i++) {
+        T value;
+        LoadState(is, value);
+        values.insert(value);
+    }
+}
 } // namespace dramsim3
 #endif
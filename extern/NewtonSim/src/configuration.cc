@@ -293,6 +293,7 @@ void Config::InitSystemParams() {
     }
 
     enable_self_refresh = reader.GetBoolean("system", "enable_self_refresh", false);
+    refresh_coschedule = reader.GetBoolean("system", "refresh_coschedule", false);
     sref_threshold = GetInteger("system", "sref_threshold", 1000);
     aggressive_precharging_enabled =
         reader.GetBoolean("system", "aggressive_precharging_enabled", false);
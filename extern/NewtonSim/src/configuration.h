@@ -144,6 +144,7 @@ class Config {
     int trans_queue_size;
     int write_buf_size;
     bool enable_self_refresh;
+    bool refresh_coschedule;  // NeuPIMS: reorder GEMVs into refresh slack & pull in refreshes
     int sref_threshold;
     bool aggressive_precharging_enabled;
     bool enable_hbm_dual_cmd;
@@ -26,9 +26,13 @@ class Controller {
     virtual void PrintEpochStats() = 0;
     virtual void PrintFinalStats() = 0;
     virtual void ResetStats() = 0;
-    virtual std::pair<uint64_t, TransactionType> ReturnDoneTrans(uint64_t clock) = 0;
+    virtual Transaction ReturnDoneTrans(uint64_t clock) = 0;
     virtual void ResetPIMCycle() = 0;
     virtual uint64_t GetPIMCycle() = 0;
+    virtual uint64_t GetRefreshStallCycles() = 0;
+    // clocks, command queues, bank and refresh state; the transaction queues must be empty
+    virtual void Save(std::ostream &os) const = 0;
+    virtual void Load(std::istream &is) = 0;
 };
 } // namespace dramsim3
 #endif
@@ -37,7 +37,7 @@ DRAMController::DRAMController(int channel, const Config &config, const Timing &
 #endif  // CMD_TRACE
 }
 
-std::pair<uint64_t, TransactionType> DRAMController::ReturnDoneTrans(uint64_t clk) {
+Transaction DRAMController::ReturnDoneTrans(uint64_t clk) {
     auto it = return_queue_.begin();
     while (it != return_queue_.end()) {
         if (clk >= it->complete_cycle) {
@@ -47,14 +47,40 @@ std::pair<uint64_t, TransactionType> DRAMController::ReturnDoneTrans(uint64_t cl
                 simple_stats_.Increment("num_reads_done");
                 simple_stats_.AddValue("read_latency", clk_ - it->added_cycle);
             }
-            auto pair = std::make_pair(it->addr, it->req_type);
+            Transaction trans = *it;
             it = return_queue_.erase(it);
-            return pair;
+            return trans;
         } else {
             ++it;
         }
     }
-    return std::make_pair(-1, TransactionType::SIZE);
+    return Transaction(-1, TransactionType::SIZE);
+}
+
+void DRAMController::Save(std::ostream &os) const {
+    // transactions hold pointers of the caller, so only drained controllers are saved
+    if (!(read_queue_.empty() && write_buffer_.empty() && unified_queue_.empty() &&
+          return_queue_.empty() && pending_rd_q_.empty() && pending_wr_q_.empty()))
+        PrintError("cid:", channel_id_, "cannot checkpoint with pending transactions");
+    SaveState(os, clk_);
+    SaveState(os, last_trans_clk_);
+    SaveState(os, rw_dependency_lock_);
+    SaveState(os, rw_dependency_addr_);
+    SaveState(os, write_draining_);
+    channel_state_.Save(os);
+    cmd_queue_.Save(os);
+    refresh_.Save(os);
+}
+
+void DRAMController::Load(std::istream &is) {
+    LoadState(is, clk_);
+    LoadState(is, last_trans_clk_);
+    LoadState(is, rw_dependency_lock_);
+    LoadState(is, rw_dependency_addr_);
+    LoadState(is, write_draining_);
+    channel_state_.Load(is);
+    cmd_queue_.Load(is);
+    refresh_.Load(is);
 }
 
 void DRAMController::ClockTick() {
@@ -6,11 +6,11 @@ namespace dramsim3 {
 
 // alternative way is to assign the id in constructor but this is less
 // destructive
-int BaseDRAMSystem::total_channels_ = 0;
+std::atomic<int> BaseDRAMSystem::total_channels_{0};
 
 BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
-                               std::function<void(uint64_t)> read_callback,
-                               std::function<void(uint64_t)> write_callback)
+                               TransactionCallback read_callback,
+                               TransactionCallback write_callback)
     : read_callback_(read_callback), write_callback_(write_callback), last_req_clk_(0),
       config_(config), timing_(config_), clk_(0) {
     total_channels_ += config_.channels;
@@ -70,16 +70,28 @@ void BaseDRAMSystem::ResetStats() {
     }
 }
 
-void BaseDRAMSystem::RegisterCallbacks(std::function<void(uint64_t)> read_callback,
-                                       std::function<void(uint64_t)> write_callback) {
+void BaseDRAMSystem::Save(std::ostream &os) const {
+    SaveState(os, clk_);
+    SaveState(os, last_req_clk_);
+    for (auto ctrl : ctrls_) ctrl->Save(os);
+}
+
+void BaseDRAMSystem::Load(std::istream &is) {
+    LoadState(is, clk_);
+    LoadState(is, last_req_clk_);
+    for (auto ctrl : ctrls_) ctrl->Load(is);
+}
+
+void BaseDRAMSystem::RegisterCallbacks(TransactionCallback read_callback,
+                                       TransactionCallback write_callback) {
     // this should be propagated to controllers
     read_callback_ = read_callback;
     write_callback_ = write_callback;
 }
 
 JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
-                                 std::function<void(uint64_t)> read_callback,
-                                 std::function<void(uint64_t)> write_callback)
+                                 TransactionCallback read_callback,
+                                 TransactionCallback write_callback)
     : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
     ctrls_.reserve(config_.channels);
     for (auto i = 0; i < config_.channels; i++) {
@@ -118,6 +130,10 @@ void JedecDRAMSystem::ResetPIMCycle() {
     }
 }
 
+uint64_t JedecDRAMSystem::GetRefreshStallCycles(int channel) {
+    return ctrls_[channel]->GetRefreshStallCycles();
+}
+
 JedecDRAMSystem::~JedecDRAMSystem() {
     for (auto it = ctrls_.begin(); it != ctrls_.end(); it++) {
         delete (*it);
@@ -129,7 +145,8 @@ bool JedecDRAMSystem::WillAcceptTransaction(uint64_t hex_addr, TransactionType r
     return ctrls_[channel]->WillAcceptTransaction(hex_addr, req_type);
 }
 
-bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, TransactionType req_type) {
+bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, TransactionType req_type,
+                                     void *handle) {
 // Record trace - Record address trace for debugging or other purposes
 #ifdef ADDR_TRACE
     address_trace_ << std::hex << hex_addr << std::dec << " " << (is_write ? "WRITE " : "READ ")
@@ -141,7 +158,7 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, TransactionType req_type
 
     assert(ok);
     if (ok) {
-        Transaction trans = Transaction(hex_addr, req_type);
+        Transaction trans = Transaction(hex_addr, req_type, handle);
         ctrls_[channel]->AddTransaction(trans);
     }
     last_req_clk_ = clk_;
@@ -152,16 +169,16 @@ void JedecDRAMSystem::ClockTick() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         // look ahead and return earlier
         while (true) {
-            auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
-            TransactionType trans_type = pair.second;
+            Transaction trans = ctrls_[i]->ReturnDoneTrans(clk_);
+            TransactionType trans_type = trans.req_type;
             if (trans_type == TransactionType::WRITE) {
-                write_callback_(pair.first);
+                write_callback_(trans.addr, trans.handle);
             } else if (trans_type == TransactionType::READ ||
                        trans_type == TransactionType::GWRITE ||
                        trans_type == TransactionType::COMP ||
                        trans_type == TransactionType::READRES ||
                        trans_type == TransactionType::COMPS_READRES) {
-                read_callback_(pair.first);
+                read_callback_(trans.addr, trans.handle);
             } else {
                 break;
             }
@@ -179,15 +196,16 @@ void JedecDRAMSystem::ClockTick() {
 }
 
 IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
-                                 std::function<void(uint64_t)> read_callback,
-                                 std::function<void(uint64_t)> write_callback)
+                                 TransactionCallback read_callback,
+                                 TransactionCallback write_callback)
     : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
       latency_(config_.ideal_memory_latency) {}
 
 IdealDRAMSystem::~IdealDRAMSystem() {}
 
-bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, TransactionType req_type) {
-    auto trans = Transaction(hex_addr, req_type);
+bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, TransactionType req_type,
+                                     void *handle) {
+    auto trans = Transaction(hex_addr, req_type, handle);
     trans.added_cycle = clk_;
     infinite_buffer_q_.push_back(trans);
     return true;
@@ -197,9 +215,9 @@ void IdealDRAMSystem::ClockTick() {
     for (auto trans_it = infinite_buffer_q_.begin(); trans_it != infinite_buffer_q_.end();) {
         if (clk_ - trans_it->added_cycle >= static_cast<uint64_t>(latency_)) {
             if (trans_it->is_write()) {
-                write_callback_(trans_it->addr);
+                write_callback_(trans_it->addr, trans_it->handle);
             } else {
-                read_callback_(trans_it->addr);
+                read_callback_(trans_it->addr, trans_it->handle);
             }
             trans_it = infinite_buffer_q_.erase(trans_it++);
         }
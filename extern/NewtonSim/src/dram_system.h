@@ -1,6 +1,7 @@
 #ifndef __DRAM_SYSTEM_H
 #define __DRAM_SYSTEM_H
 
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -15,28 +16,35 @@
 
 namespace dramsim3 {
 
+// (address, handle passed to AddTransaction)
+using TransactionCallback = std::function<void(uint64_t, void *)>;
+
 class BaseDRAMSystem {
   public:
     BaseDRAMSystem(Config &config, const std::string &output_dir,
-                   std::function<void(uint64_t)> read_callback,
-                   std::function<void(uint64_t)> write_callback);
+                   TransactionCallback read_callback,
+                   TransactionCallback write_callback);
     virtual ~BaseDRAMSystem() {}
-    void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
-                           std::function<void(uint64_t)> write_callback);
+    void RegisterCallbacks(TransactionCallback read_callback,
+                           TransactionCallback write_callback);
     void PrintEpochStats();
     void PrintStats();
     void ResetStats();
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
 
     virtual bool WillAcceptTransaction(uint64_t hex_addr, TransactionType req_type) const = 0;
-    virtual bool AddTransaction(uint64_t hex_addr, TransactionType req_type) = 0;
+    virtual bool AddTransaction(uint64_t hex_addr, TransactionType req_type,
+                                void *handle = nullptr) = 0;
     virtual void ClockTick() = 0;
     int GetChannel(uint64_t hex_addr) const;
 
-    std::function<void(uint64_t req_id)> read_callback_, write_callback_;
-    static int total_channels_;
+    TransactionCallback read_callback_, write_callback_;
+    static std::atomic<int> total_channels_;  // several simulations may run in one process
 
     virtual uint64_t GetAvgPIMCycles() = 0;
     virtual void ResetPIMCycle() = 0;
+    virtual uint64_t GetRefreshStallCycles(int channel) = 0;
 
   protected:
     uint64_t id_;
@@ -57,14 +65,16 @@ class BaseDRAMSystem {
 class JedecDRAMSystem : public BaseDRAMSystem {
   public:
     JedecDRAMSystem(Config &config, const std::string &output_dir,
-                    std::function<void(uint64_t)> read_callback,
-                    std::function<void(uint64_t)> write_callback);
+                    TransactionCallback read_callback,
+                    TransactionCallback write_callback);
     ~JedecDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr, TransactionType req_type) const override;
-    bool AddTransaction(uint64_t hex_addr, TransactionType req_type) override;
+    bool AddTransaction(uint64_t hex_addr, TransactionType req_type,
+                        void *handle = nullptr) override;
     void ClockTick() override;
     uint64_t GetAvgPIMCycles() override;
     void ResetPIMCycle() override;
+    uint64_t GetRefreshStallCycles(int channel) override;
 };
 
 // Model a memorysystem with an infinite bandwidth and a fixed latency (possibly
@@ -73,13 +83,14 @@ class JedecDRAMSystem : public BaseDRAMSystem {
 class IdealDRAMSystem : public BaseDRAMSystem {
   public:
     IdealDRAMSystem(Config &config, const std::string &output_dir,
-                    std::function<void(uint64_t)> read_callback,
-                    std::function<void(uint64_t)> write_callback);
+                    TransactionCallback read_callback,
+                    TransactionCallback write_callback);
     ~IdealDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr, TransactionType req_type) const override {
         return true;
     };
-    bool AddTransaction(uint64_t hex_addr, TransactionType req_type) override;
+    bool AddTransaction(uint64_t hex_addr, TransactionType req_type,
+                        void *handle = nullptr) override;
     void ClockTick() override;
 
   private:
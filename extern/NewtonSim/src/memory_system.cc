@@ -1,13 +1,21 @@
 #include "memory_system.h"
 
 namespace dramsim3 {
+namespace {
+// MemorySystem callers only get the address back
+TransactionCallback WrapCallback(std::function<void(uint64_t)> callback) {
+    return [callback](uint64_t addr, void *) { callback(addr); };
+}
+}  // namespace
+
 MemorySystem::MemorySystem(const std::string &config_file, const std::string &output_dir,
                            std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback)
     : config_(new Config(config_file, output_dir)) {
     // todo: ideal memory type?
 
-    dram_system_ = new JedecDRAMSystem(*config_, output_dir, read_callback, write_callback);
+    dram_system_ = new JedecDRAMSystem(*config_, output_dir, WrapCallback(read_callback),
+                                       WrapCallback(write_callback));
     // just use read_callback for all pim callback
 }
 
@@ -28,7 +36,7 @@ int MemorySystem::GetQueueSize() const { return config_->trans_queue_size; }
 
 void MemorySystem::RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                                      std::function<void(uint64_t)> write_callback) {
-    dram_system_->RegisterCallbacks(read_callback, write_callback);
+    dram_system_->RegisterCallbacks(WrapCallback(read_callback), WrapCallback(write_callback));
 }
 
 bool MemorySystem::WillAcceptTransaction(uint64_t hex_addr, TransactionType req_type) const {
@@ -6,7 +6,7 @@ NeuPIMSCommandQueue::NeuPIMSCommandQueue(int channel_id, const Config &config,
                                          ChannelState &channel_state, SimpleStats &simple_stats)
     : channel_id_(channel_id), rank_q_empty(config.ranks, true), config_(config),
       channel_state_(channel_state), simple_stats_(simple_stats), is_in_ref_(false),
-      is_gwriting_(false), skip_pim_(false),
+      is_gwriting_(false), skip_pim_(false), want_refresh_pull_in_(false),
       queue_size_(static_cast<size_t>(config_.cmd_queue_size)), queue_idx_(0), clk_(0) {
     if (config_.queue_structure == "PER_BANK") {
         queue_structure_ = QueueStructure::PER_BANK;
@@ -19,6 +19,7 @@ NeuPIMSCommandQueue::NeuPIMSCommandQueue(int channel_id, const Config &config,
         AbruptExit(__FILE__, __LINE__);
     }
     total_pim_cycles_ = 0;
+    refresh_stall_cycles_ = 0;
     queues_.reserve(num_queues_);
 
     for (int i = 0; i < num_queues_; i++) {
@@ -31,11 +32,51 @@ NeuPIMSCommandQueue::NeuPIMSCommandQueue(int channel_id, const Config &config,
     pim_queue_ = std::vector<Command>();
     pim_queue_.reserve(pim_cmd_queue_size_);
 }
+void NeuPIMSCommandQueue::Save(std::ostream &os) const {
+    SaveState(os, queues_);
+    SaveState(os, pim_queue_);
+    SaveState(os, ref_q_indices_);
+    SaveState(os, is_in_ref_);
+    SaveState(os, skip_pim_);
+    SaveState(os, queue_idx_);
+    SaveState(os, clk_);
+    SaveState(os, remain_slack_);
+    SaveState(os, reserved_row_for_pim_);
+    SaveState(os, is_gwriting_);
+    SaveState(os, gwrite_target_);
+    SaveState(os, rank_q_empty);
+    SaveState(os, total_pim_cycles_);
+    SaveState(os, want_refresh_pull_in_);
+    SaveState(os, refresh_stall_cycles_);
+}
+
+void NeuPIMSCommandQueue::Load(std::istream &is) {
+    LoadState(is, queues_);
+    LoadState(is, pim_queue_);
+    LoadState(is, ref_q_indices_);
+    LoadState(is, is_in_ref_);
+    LoadState(is, skip_pim_);
+    LoadState(is, queue_idx_);
+    LoadState(is, clk_);
+    LoadState(is, remain_slack_);
+    LoadState(is, reserved_row_for_pim_);
+    LoadState(is, is_gwriting_);
+    LoadState(is, gwrite_target_);
+    LoadState(is, rank_q_empty);
+    LoadState(is, total_pim_cycles_);
+    LoadState(is, want_refresh_pull_in_);
+    LoadState(is, refresh_stall_cycles_);
+}
+
 void NeuPIMSCommandQueue::ClockTick() {
     clk_ += 1;
     if (!pim_queue_.empty()) {
         total_pim_cycles_++;
         simple_stats_.Increment("pim_cycles");
+        if (skip_pim_ || is_in_ref_) {
+            refresh_stall_cycles_++;
+            simple_stats_.Increment("pim_refresh_stall_cycles");
+        }
     }
 }
 
@@ -261,6 +302,36 @@ bool NeuPIMSCommandQueue::CanMeetRefreshDeadline(const CMDIterator cmd_it,
     return remain_slack > 0;
 }
 
+// past the last command of the GEMV group (P_HEADER + COMP/READRES) starting at header_it
+CMDIterator NeuPIMSCommandQueue::PIMGroupEnd(CMDIterator header_it) {
+    auto it = header_it + 1;
+    while (it != pim_queue_.end() && !it->IsPIMHeader() && !it->IsGwrite())
+        it++;
+    return it;
+}
+
+// Move the first later GEMV group that fits in the refresh slack in front of cmd_it.
+// Groups are independent rows, but never move across a GWRITE since they read the global
+// buffer it writes. The last group in the queue may still be arriving, so it is not moved.
+bool NeuPIMSCommandQueue::ReorderPIMHeader(CMDIterator cmd_it,
+                                           std::pair<int, int> refresh_slack) {
+    int remain_to_refresh = refresh_slack.second;
+    for (auto it = PIMGroupEnd(cmd_it); it != pim_queue_.end() && it->IsPIMHeader();
+         it = PIMGroupEnd(it)) {
+        auto group_end = PIMGroupEnd(it);
+        if (group_end == pim_queue_.end())
+            break;
+
+        int estimated_latency = channel_state_.EstimatePIMOperationLatency(*it, clk_);
+        if (estimated_latency < remain_to_refresh) {
+            std::rotate(cmd_it, it, group_end);
+            simple_stats_.Increment("num_pim_header_reorders");
+            return true;
+        }
+    }
+    return false;
+}
+
 void NeuPIMSCommandQueue::PrintQueue(CMDQueue &queue) const {
     // print all commands in pim cmd queue
     std::string commands_in_q = "";
@@ -297,6 +368,7 @@ Command NeuPIMSCommandQueue::GetReadyInPIMQueue(std::pair<int, int> refresh_slac
                 return ready_cmd;
             } else {
                 skip_pim_ = true;
+                want_refresh_pull_in_ = config_.refresh_coschedule;
                 if (channel_id_ == 4)
                     PrintWarning("cid:", channel_id_, "skip_pim ON", "gwrite//");
                 return Command();
@@ -312,6 +384,10 @@ Command NeuPIMSCommandQueue::GetReadyInPIMQueue(std::pair<int, int> refresh_slac
             //            cmd_it->num_comps, cmd_it->num_readres);
             // ready for GEMV
             bool can_issue_gemv = CanMeetRefreshDeadline(cmd_it, refresh_slack);
+            if (!can_issue_gemv && config_.refresh_coschedule &&
+                ReorderPIMHeader(cmd_it, refresh_slack)) {
+                can_issue_gemv = CanMeetRefreshDeadline(cmd_it, refresh_slack);
+            }
             if (can_issue_gemv) {
                 reserved_row_for_pim_ = cmd_it->Row();
                 Command cmd = channel_state_.GetReadyCommand(*cmd_it, clk_);
@@ -321,6 +397,7 @@ Command NeuPIMSCommandQueue::GetReadyInPIMQueue(std::pair<int, int> refresh_slac
                 if (channel_id_ == 4)
                     PrintWarning("cid:", channel_id_, "skip_pim ON", "gemv//");
                 skip_pim_ = true;
+                want_refresh_pull_in_ = config_.refresh_coschedule;
                 return Command();
             }
         }
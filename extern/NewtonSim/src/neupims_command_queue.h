@@ -30,10 +30,17 @@ class NeuPIMSCommandQueue {
         remain_slack_ = 0;
     }
     void PrintAllQueue() const; // for debugging
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
     std::vector<bool> rank_q_empty;
     uint64_t total_pim_cycles_;
     void ResetPIMCycle() { total_pim_cycles_ = 0; }
     uint64_t GetPIMCycle() { return total_pim_cycles_; }
+    uint64_t refresh_stall_cycles_;
+    uint64_t GetRefreshStallCycles() { return refresh_stall_cycles_; }
+    // set when a PIM command is held back for an upcoming refresh (refresh_coschedule)
+    bool WantRefreshPullIn() const { return want_refresh_pull_in_; }
+    void ClearRefreshPullIn() { want_refresh_pull_in_ = false; }
 
   private:
     bool ArbitratePrecharge(const CMDIterator &cmd_it, const CMDQueue &queue) const;
@@ -47,6 +54,8 @@ class NeuPIMSCommandQueue {
     void EraseRWCommand(const Command &cmd);
     Command PrepRefCmd(const CMDIterator &it, const Command &ref) const;
     bool CanMeetRefreshDeadline(const CMDIterator cmd_it, std::pair<int, int> refresh_slack);
+    bool ReorderPIMHeader(CMDIterator cmd_it, std::pair<int, int> refresh_slack);
+    CMDIterator PIMGroupEnd(CMDIterator header_it);
     // for debug
     void PrintQueue(CMDQueue &queue) const;
 
@@ -63,6 +72,7 @@ class NeuPIMSCommandQueue {
     bool is_in_ref_;
     bool is_pim_mode_;
     bool skip_pim_;
+    bool want_refresh_pull_in_;
 
     int num_queues_;
     size_t queue_size_;
@@ -31,6 +31,40 @@ NewtonCommandQueue::NewtonCommandQueue(int channel_id, const Config &config,
     pim_queue_ = std::vector<Command>();
     pim_queue_.reserve(pim_cmd_queue_size_);
 }
+void NewtonCommandQueue::Save(std::ostream &os) const {
+    SaveState(os, queues_);
+    SaveState(os, pim_queue_);
+    SaveState(os, ref_q_indices_);
+    SaveState(os, is_in_ref_);
+    SaveState(os, is_pim_mode_);
+    SaveState(os, skip_pim_);
+    SaveState(os, queue_idx_);
+    SaveState(os, clk_);
+    SaveState(os, remain_slack_);
+    SaveState(os, reserved_row_for_pim_);
+    SaveState(os, is_gwriting_);
+    SaveState(os, gwrite_target_);
+    SaveState(os, rank_q_empty);
+    SaveState(os, total_pim_cycles_);
+}
+
+void NewtonCommandQueue::Load(std::istream &is) {
+    LoadState(is, queues_);
+    LoadState(is, pim_queue_);
+    LoadState(is, ref_q_indices_);
+    LoadState(is, is_in_ref_);
+    LoadState(is, is_pim_mode_);
+    LoadState(is, skip_pim_);
+    LoadState(is, queue_idx_);
+    LoadState(is, clk_);
+    LoadState(is, remain_slack_);
+    LoadState(is, reserved_row_for_pim_);
+    LoadState(is, is_gwriting_);
+    LoadState(is, gwrite_target_);
+    LoadState(is, rank_q_empty);
+    LoadState(is, total_pim_cycles_);
+}
+
 void NewtonCommandQueue::ClockTick() {
     clk_ += 1;
     if (!pim_queue_.empty()) {
@@ -30,6 +30,8 @@ class NewtonCommandQueue {
         remain_slack_ = 0;
     }
     void PrintAllQueue() const; // for debugging
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
     std::vector<bool> rank_q_empty;
     uint64_t total_pim_cycles_;
     void ResetPIMCycle() { total_pim_cycles_ = 0; }
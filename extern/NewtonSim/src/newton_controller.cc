@@ -28,7 +28,7 @@ void NewtonController::ResetPIMCycle() { pim_cmd_queue_.ResetPIMCycle(); }
 uint64_t NewtonController::GetPIMCycle() { return pim_cmd_queue_.GetPIMCycle(); }
 
 // - [x] handle pim command
-std::pair<uint64_t, TransactionType> NewtonController::ReturnDoneTrans(uint64_t clk) {
+Transaction NewtonController::ReturnDoneTrans(uint64_t clk) {
     auto it = return_queue_.begin();
     while (it != return_queue_.end()) {
         if (clk >= it->complete_cycle) {
@@ -52,14 +52,43 @@ std::pair<uint64_t, TransactionType> NewtonController::ReturnDoneTrans(uint64_t
                 simple_stats_.Increment("num_readres_done");
             }
 
-            auto pair = std::make_pair(it->addr, it->req_type);
+            Transaction trans = *it;
             it = return_queue_.erase(it);
-            return pair;
+            return trans;
         } else {
             ++it;
         }
     }
-    return std::make_pair(-1, TransactionType::SIZE);
+    return Transaction(-1, TransactionType::SIZE);
+}
+
+void NewtonController::Save(std::ostream &os) const {
+    // transactions hold pointers of the caller, so only drained controllers are saved
+    if (!(read_queue_.empty() && write_buffer_.empty() && pim_queue_.empty() &&
+          return_queue_.empty() && pending_rd_q_.empty() && pending_wr_q_.empty() &&
+          pending_pim_q_.empty()))
+        PrintError("cid:", channel_id_, "cannot checkpoint with pending transactions");
+    SaveState(os, clk_);
+    SaveState(os, last_issue_clk_);
+    SaveState(os, last_trans_clk_);
+    SaveState(os, rw_dependency_lock_);
+    SaveState(os, rw_dependency_addr_);
+    SaveState(os, write_draining_);
+    channel_state_.Save(os);
+    pim_cmd_queue_.Save(os);
+    refresh_.Save(os);
+}
+
+void NewtonController::Load(std::istream &is) {
+    LoadState(is, clk_);
+    LoadState(is, last_issue_clk_);
+    LoadState(is, last_trans_clk_);
+    LoadState(is, rw_dependency_lock_);
+    LoadState(is, rw_dependency_addr_);
+    LoadState(is, write_draining_);
+    channel_state_.Load(is);
+    pim_cmd_queue_.Load(is);
+    refresh_.Load(is);
 }
 
 void NewtonController::ClockTick() {
@@ -24,13 +24,16 @@ class NewtonController : public Controller {
     void PrintEpochStats() override;
     void PrintFinalStats() override;
     void ResetStats() override { simple_stats_.Reset(); }
-    std::pair<uint64_t, TransactionType> ReturnDoneTrans(uint64_t clock) override;
+    Transaction ReturnDoneTrans(uint64_t clock) override;
+    void Save(std::ostream &os) const override;
+    void Load(std::istream &is) override;
 
     int channel_id_;
 
     // stat for pim utilization
     void ResetPIMCycle() override;
     uint64_t GetPIMCycle() override;
+    uint64_t GetRefreshStallCycles() override { return 0; }
 
   private:
     uint64_t clk_;
@@ -17,11 +17,30 @@ Refresh::Refresh(const Config &config, ChannelState &channel_state, SimpleStats
     } else {  // default refresh scheme: RANK STAGGERED
         refresh_interval_ = config_.tREFI / config_.ranks;
     }
+    next_refresh_clk_ = refresh_interval_;
+    max_pull_in_ = 8;  // JEDEC allows up to 8 REF commands to be pulled in
+}
+
+void Refresh::Save(std::ostream &os) const {
+    SaveState(os, clk_);
+    SaveState(os, next_refresh_clk_);
+    SaveState(os, next_rank_);
+    SaveState(os, next_bg_);
+    SaveState(os, next_bank_);
+}
+
+void Refresh::Load(std::istream &is) {
+    LoadState(is, clk_);
+    LoadState(is, next_refresh_clk_);
+    LoadState(is, next_rank_);
+    LoadState(is, next_bg_);
+    LoadState(is, next_bank_);
 }
 
 void Refresh::ClockTick() {
-    if (clk_ % refresh_interval_ == 0 && clk_ > 0) {
+    if (clk_ == next_refresh_clk_) {
         InsertRefresh();
+        next_refresh_clk_ += refresh_interval_;
     }
     clk_++;
     return;
@@ -29,11 +48,21 @@ void Refresh::ClockTick() {
 
 std::pair<int, int> Refresh::GetRefreshSlack() {
     // target_rank, slack
-
     if (refresh_policy_ != RefreshPolicy::RANK_LEVEL_STAGGERED)
         PrintError("Refresh policy is not RANK_LEVEL_STAGGERED");
 
-    return std::make_pair(next_rank_, refresh_interval_ - (clk_ % refresh_interval_));
+    return std::make_pair(next_rank_, next_refresh_clk_ - clk_);
+}
+
+bool Refresh::PullIn() {
+    if (next_refresh_clk_ - clk_ > (uint64_t)max_pull_in_ * refresh_interval_)
+        return false;
+
+    // the refresh due at next_refresh_clk_ is done now, so the schedule moves one interval
+    InsertRefresh();
+    next_refresh_clk_ += refresh_interval_;
+    simple_stats_.Increment("num_early_refresh_cuz_pim");
+    return true;
 }
 
 void Refresh::InsertRefresh() {
@@ -15,10 +15,17 @@ class Refresh {
     Refresh(const Config &config, ChannelState &channel_state, SimpleStats &simple_stats);
     void ClockTick();
     std::pair<int, int> GetRefreshSlack();
+    // issue the next refresh now instead of at its deadline (JEDEC pull-in),
+    // false if the pull-in budget is used up
+    bool PullIn();
+    void Save(std::ostream &os) const;
+    void Load(std::istream &is);
 
    private:
     uint64_t clk_;
+    uint64_t next_refresh_clk_;
     int refresh_interval_;
+    int max_pull_in_;  // max # of refreshes issued ahead of schedule
     const Config &config_;
     ChannelState &channel_state_;
     RefreshPolicy refresh_policy_;
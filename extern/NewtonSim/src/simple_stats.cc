@@ -41,6 +41,10 @@ SimpleStats::SimpleStats(const Config &config, int channel_id)
     // pim stats
     InitStat("num_early_refresh_cuz_pim", "counter", "Number of Early REFRESH commands due to PIM");
     InitStat("num_yield_for_rdwr", "counter", "Number of yield for Read/Wrtie");
+    InitStat("num_pim_header_reorders", "counter",
+             "Number of GEMVs moved ahead to fit in the slack before REFRESH");
+    InitStat("pim_refresh_stall_cycles", "counter",
+             "Number of cycles that pim cmd queue is blocked by REFRESH");
     InitStat("num_gwrite_cmds", "counter", "Number of GWRITE commands");
     InitStat("num_gact_cmds", "counter", "Number of GACT commands");
     InitStat("num_comp_cmds", "counter", "Number of COMP commands");
@@ -0,0 +1,292 @@
+#include "AnalyticalModel.h"
+
+#include <chrono>
+
+#include "MoERouter.h"
+#include "RequestGenerator.h"
+#include "newtonsim/NewtonSim.h"
+
+AnalyticalModel::AnalyticalModel(SimulationConfig config)
+    : _config(config), _pim_latency_model(config) {
+    if (_config.pim_calibration) _pim_latency_model.calibrate();
+
+    // a request of BL * bus bytes holds the channel for BL / 2 cycles (see PIM::PIM)
+    dramsim3::NewtonSim mem(_config.pim_config_path, _config.log_dir);
+    _dram_bytes_per_cycle = (double)mem.GetBusBits() / 8 * 2 * _config.dram_channels;
+    _dram_to_core = (double)_config.core_freq / _config.dram_freq;
+}
+
+// loops of MatMul::calculate_loops, instructions of MatMul::initialize_instructions
+AnalyticalModel::MatMulCost AnalyticalModel::matmul(uint32_t m, uint32_t k, uint32_t n,
+                                                    bool weights) {
+    bool dequant = weights && _config.weight_bits < 8 * _config.precision;
+    uint32_t width = _config.core_width;
+    uint32_t height = _config.core_height;
+    auto pad = [&](uint64_t x) { return (x + width - 1) / width * width; };
+
+    std::vector<uint64_t> inner{m, k, n};
+    std::vector<uint64_t> outer{1, 1, 1};
+    auto sram_size_needed = [&] {
+        return (pad(inner[0]) * pad(inner[1]) + pad(inner[1]) * pad(inner[2]) +
+                pad(inner[2]) * pad(inner[0]) + (dequant ? pad(inner[1]) * pad(inner[2]) : 0)) *
+               _config.precision;
+    };
+    while (sram_size_needed() > _config.spad_size KB / 2) {
+        auto max_el = max_element(inner.begin(), inner.end());
+        outer[max_el - inner.begin()] *= 2;
+        *max_el = ((*max_el) & 1) + ((*max_el) >> 1);
+    }
+
+    uint64_t tiles = outer[0] * outer[1] * outer[2];
+    uint64_t preloads = pad(inner[1]) / width * (pad(inner[2]) / width);
+    uint64_t gemms = preloads * (pad(inner[0]) / width);
+    cycle_type gemm_offset = MAX(width / 8, 4);
+    cycle_type tile_cycles = (2 * height - 1) + preloads * height +
+                             (gemms - preloads) * gemm_offset + (height + width - 2 + gemm_offset);
+
+    MatMulCost cost;
+    cost.sa_cycles = (tiles + _config.num_cores - 1) / _config.num_cores * tile_cycles;
+    // operands are loaded per tile, outputs and bias once per (m, n) tile, weights packed
+    uint32_t kn_bits = weights ? _config.weight_bits : 8 * _config.precision;
+    cost.bytes =
+        (tiles * inner[0] * inner[1] + outer[0] * outer[2] * (inner[0] * inner[2] + inner[2])) *
+            _config.precision +
+        tiles * inner[1] * inner[2] * kn_bits / 8;
+    return cost;
+}
+
+// FFN GEMMs of a layer over `tokens` rows. MoE: the router, then each expert over its expected
+// rows given that it gets any, weighted by the chance that it does (a token takes an expert
+// with about top-k times its share, see MoERouter)
+std::vector<AnalyticalModel::MatMulCost> AnalyticalModel::ffn(uint32_t tokens) {
+    uint32_t E = _config.model_n_embd;
+    uint32_t tp = _config.n_tp;
+    if (_config.model_n_experts == 0)
+        return {matmul(tokens, E, 4 * E / tp), matmul(tokens, 4 * E / tp, E)};
+
+    uint32_t F = _config.model_expert_ffn_dim / tp;
+    std::vector<MatMulCost> costs{matmul(tokens, E, _config.model_n_experts)};
+    for (double share : MoERouter::expert_load(_config)) {
+        double pick = MIN(share * _config.model_n_experts_per_token, 1.0);
+        double active = 1 - pow(1 - pick, tokens);
+        if (active <= 0) continue;
+        uint32_t rows = MAX((uint32_t)ceil(tokens * pick / active), 1);
+        for (auto cost : {matmul(rows, E, F), matmul(rows, F, E)})
+            costs.push_back({.sa_cycles = (cycle_type)(cost.sa_cycles * active),
+                             .bytes = (uint64_t)(cost.bytes * active)});
+    }
+    return costs;
+}
+
+// GWRITE and GEMV counts of Scheduler::estimate_mha_latency, in DRAM cycles
+cycle_type AnalyticalModel::mha_cycles(uint32_t seq_len) {
+    uint32_t nh = _config.model_n_head / _config.n_tp;
+    uint32_t dk = _config.model_n_embd / _config.model_n_head;
+    uint32_t page_size = kv_page_elements(_config);
+    uint32_t banks = _config.dram_banks_per_ch;
+
+    uint64_t chunks = ceil((double)nh * dk / page_size);
+    uint64_t gwrites = chunks;
+    uint64_t gemvs = chunks * (uint64_t)ceil((double)seq_len / banks);
+
+    chunks = ceil((double)seq_len / page_size) * nh;
+    gwrites += chunks;
+    gemvs += chunks * (uint64_t)ceil((double)dk / banks);
+
+    return gwrites * _pim_latency_model.get_gwrite_latency() +
+           gemvs * _pim_latency_model.get_gemv_latency();
+}
+
+// every layer on the SA: QKV, projection and FFN GEMMs over the prompt, QK^T and SV per head,
+// then the LM head of the first token. A layer takes max(SA, DRAM)
+cycle_type AnalyticalModel::prefill_cycles(uint32_t tokens) {
+    uint32_t E = _config.model_n_embd;
+    uint32_t tp = _config.n_tp;
+    uint32_t nh = _config.model_n_head / tp;
+    uint32_t dk = _config.model_n_embd / _config.model_n_head;
+
+    cycle_type sa_cycles = 0;
+    uint64_t bytes = 0;
+    auto add = [&](MatMulCost cost, uint32_t count) {
+        sa_cycles += cost.sa_cycles * count;
+        bytes += cost.bytes * count;
+    };
+    add(matmul(tokens, E, 3 * E / tp), 1);
+    add(matmul(tokens, dk, tokens, false), nh);
+    add(matmul(tokens, tokens, dk, false), nh);
+    add(matmul(tokens, E / tp, E), 1);
+    for (auto &cost : ffn(tokens)) add(cost, 1);
+    auto dram_cycles = [&](uint64_t bytes) -> cycle_type {
+        return bytes / _dram_bytes_per_cycle * _dram_to_core;
+    };
+    cycle_type layer_cycles = MAX(sa_cycles, dram_cycles(bytes));
+
+    MatMulCost lm_head = matmul(1, E, _config.model_vocab_size / tp);
+    return layer_cycles * _config.model_n_layer +
+           MAX(lm_head.sa_cycles, dram_cycles(lm_head.bytes));
+}
+
+// per channel, the longest MHA goes to the sub-batch with the least MHA time so far
+std::vector<std::vector<AnalyticalModel::Request>> AnalyticalModel::group_sub_batches(
+    std::vector<Request> batch) {
+    uint32_t num_sub_batches = _config.num_sub_batches;
+    std::vector<std::vector<Request>> sub_batches(num_sub_batches);
+    std::sort(batch.begin(), batch.end(),
+              [](const Request &a, const Request &b) { return a.mha_cycles > b.mha_cycles; });
+
+    std::vector<std::vector<cycle_type>> loads(_config.dram_channels,
+                                               std::vector<cycle_type>(num_sub_batches, 0));
+    for (auto &request : batch) {
+        auto &load = loads[request.channel];
+        int sb = std::min_element(load.begin(), load.end()) - load.begin();
+        load[sb] += request.mha_cycles;
+        sub_batches[sb].push_back(request);
+    }
+    return sub_batches;
+}
+
+AnalyticalModel::StageEstimate AnalyticalModel::estimate_stage(
+    Stage stage, std::vector<std::vector<Request>> &sub_batches) {
+    uint32_t period = stagePeriod();
+    uint32_t s = static_cast<uint32_t>(stage);
+    uint32_t sa_idx = s % period;
+    uint32_t pim_idx = (s - 1) % period;
+    uint32_t E = _config.model_n_embd;
+    uint32_t tp = _config.n_tp;
+
+    StageEstimate estimate{.stage = stage, .sa_cycles = 0, .dram_cycles = 0, .pim_cycles = 0};
+
+    // SA: Pj/FFNs in stages [P, ...), QKVgen in stages [0, 2P), embedding in [0, P) and
+    // LM head in [2P, ...) (see StageProgram)
+    if (sa_idx < sub_batches.size() && !sub_batches[sa_idx].empty()) {
+        uint32_t N = sub_batches[sa_idx].size();
+        std::vector<MatMulCost> costs;
+        if (s >= period) {
+            costs.push_back(matmul(N, E / tp, E));
+            auto ffn_costs = ffn(N);
+            costs.insert(costs.end(), ffn_costs.begin(), ffn_costs.end());
+        }
+        if (s < 2 * period) costs.push_back(matmul(N, E, 3 * E / tp));
+        if (s >= 2 * period) costs.push_back(matmul(N, E, _config.model_vocab_size / tp));
+
+        uint64_t bytes = 0;
+        for (auto &cost : costs) {
+            estimate.sa_cycles += cost.sa_cycles;
+            bytes += cost.bytes;
+        }
+        // embedding gather: a table row in and an activation row out per token
+        if (s < period) bytes += 2 * (uint64_t)N * E * _config.precision;
+        estimate.dram_cycles = bytes / _dram_bytes_per_cycle * _dram_to_core;
+    }
+
+    // PIM: MHA in stages [1, 2P]
+    if (_config.run_mode == RunMode::NPU_PIM && s >= 1 && s <= 2 * period &&
+        pim_idx < sub_batches.size()) {
+        std::vector<cycle_type> channel_cycles(_config.dram_channels, 0);
+        for (auto &request : sub_batches[pim_idx])
+            channel_cycles[request.channel] += request.mha_cycles;
+        cycle_type max_cycles = *std::max_element(channel_cycles.begin(), channel_cycles.end());
+        estimate.pim_cycles = max_cycles * _dram_to_core;
+    }
+
+    estimate.cycles = MAX(estimate.sa_cycles, MAX(estimate.dram_cycles, estimate.pim_cycles));
+    return estimate;
+}
+
+std::vector<AnalyticalModel::StageEstimate> AnalyticalModel::run() {
+    auto start = std::chrono::steady_clock::now();
+
+    // arrival times are ignored: every request is queued at once. Requests without a channel
+    // go round-robin
+    if (_config.models.size() > 1)
+        spdlog::warn("Analytical model: all requests are estimated as {} ({} models co-located)",
+                     _config.model_name, _config.models.size());
+    RequestGenerator::init(_config.request_dataset_path);
+    std::vector<Request> requests;
+    while (RequestGenerator::has_data()) {
+        auto row = RequestGenerator::next();
+        ast(row.output_size > 0);
+        uint32_t channel = row.channel >= 0 ? row.channel : requests.size() % _config.dram_channels;
+        requests.push_back(Request{row.input_size, channel, row.output_size, 0, 0});
+    }
+
+    // like Scheduler with fcfs admission, every iteration decodes one token of the first (up to)
+    // max_batch_size unfinished requests and finished requests make room for the next ones
+    uint32_t batch_size = MIN(_config.max_batch_size, _config.max_active_reqs);
+    uint32_t period = stagePeriod();
+    uint32_t num_stages = 2 * period + _config.num_sub_batches;
+    std::vector<StageEstimate> estimates;
+    std::deque<Request> queue(requests.begin(), requests.end());
+    for (uint32_t iteration = 0; !queue.empty(); iteration++) {
+        std::vector<Request> batch(queue.begin(),
+                                   queue.begin() + std::min<size_t>(batch_size, queue.size()));
+        for (auto &request : batch)
+            request.mha_cycles = mha_cycles(request.input_size + request.generated);
+        auto sub_batches = _config.sub_batch_mode ? group_sub_batches(batch)
+                                                  : std::vector<std::vector<Request>>{batch};
+
+        // stage order of Scheduler::refresh_stage
+        for (uint32_t s = 0; s < num_stages; s++) {
+            estimates.push_back(estimate_stage(static_cast<Stage>(s), sub_batches));
+            estimates.back().iteration = iteration;
+            if (!_config.sub_batch_mode && s + 1 == period) s = 2 * period - 1;
+        }
+
+        std::deque<Request> next;
+        for (size_t i = 0; i < queue.size(); i++) {
+            Request request = queue[i];
+            if (i < batch.size() && ++request.generated == request.output_size) continue;
+            next.push_back(request);
+        }
+        queue.swap(next);
+    }
+
+    double elapsed_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    spdlog::info("Analytical model: {} requests, {} stages in {:.1f} ms", requests.size(),
+                 estimates.size(), elapsed_ms);
+    return estimates;
+}
+
+void AnalyticalModel::log(std::vector<StageEstimate> estimates, std::string fname,
+                          std::vector<cycle_type> simulated) {
+    std::ofstream ofile(fname + ".tsv");
+    if (!ofile.is_open()) {
+        assert(0);
+    }
+    bool validate = !simulated.empty();
+    ofile << "Iteration\tStage\tsa_cycles\tdram_cycles\tpim_cycles\test_cycles";
+    if (validate) ofile << "\tsim_cycles\terror";
+    ofile << "\n";
+
+    cycle_type total = 0;
+    double abs_error = 0;
+    uint32_t compared = 0;
+    for (size_t i = 0; i < estimates.size(); i++) {
+        auto &estimate = estimates[i];
+        total += estimate.cycles;
+        ofile << fmt::format("{}\t{}\t{}\t{}\t{}\t{}", estimate.iteration,
+                             stageToString(estimate.stage), estimate.sa_cycles,
+                             estimate.dram_cycles, estimate.pim_cycles, estimate.cycles);
+        if (validate && i < simulated.size()) {
+            double error = simulated[i] > 0
+                               ? ((double)estimate.cycles - simulated[i]) / simulated[i]
+                               : 0;
+            ofile << fmt::format("\t{}\t{:.4f}", simulated[i], error);
+            abs_error += std::abs(error);
+            compared++;
+        }
+        ofile << "\n";
+    }
+    ofile.close();
+
+    spdlog::info("Analytical model: {} cycles estimated", total);
+    if (validate) {
+        if (simulated.size() != estimates.size())
+            spdlog::warn("Analytical model: {} estimated stages, {} simulated", estimates.size(),
+                         simulated.size());
+        spdlog::info("Analytical model: mean absolute stage error {:.2f}% over {} stages",
+                     compared > 0 ? 100 * abs_error / compared : 0, compared);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Common.h"
+#include "scheduler/PIMLatencyModel.h"
+
+/**
+ * AnalyticalModel estimates stage times without cycle simulation (analytical_model config).
+ * It takes the same inputs as Simulator: Config::global_config and the request trace, batched
+ * and staged like Scheduler does.
+ *   SA:   GEMM / weight preload instructions of each MatMul tile, timed like NeuPIMSystolicWS
+ *         (systolic fill and drain per tile), tiles spread over the cores
+ *   PIM:  GWRITE and GEMV counts of the MHA of each request times the PIMLatencyModel
+ *         latencies; the most loaded channel bounds the stage
+ *   DRAM: bytes loaded and stored by the SA tiles over the peak bandwidth of all channels
+ * A stage takes max(SA, DRAM, PIM). Vector ops and contention between SA and PIM traffic are
+ * not modeled.
+ */
+class AnalyticalModel {
+   public:
+    AnalyticalModel(SimulationConfig config);
+
+    typedef struct {
+        uint32_t iteration;
+        Stage stage;
+        cycle_type sa_cycles;  // core cycles, like every column below
+        cycle_type dram_cycles;
+        cycle_type pim_cycles;
+        cycle_type cycles;
+    } StageEstimate;
+
+    std::vector<StageEstimate> run();  // every stage of every iteration of the trace
+    cycle_type prefill_cycles(uint32_t tokens);  // prefill of a prompt on its own (PrefillPool)
+
+    // writes {fname}.tsv; given the stage cycles of the cycle-level run, also the error per stage
+    void log(std::vector<StageEstimate> estimates, std::string fname,
+             std::vector<cycle_type> simulated = {});
+
+   private:
+    SimulationConfig _config;
+    PIMLatencyModel _pim_latency_model;
+    double _dram_bytes_per_cycle;  // all channels, per DRAM cycle
+    double _dram_to_core;          // core cycles per DRAM cycle
+
+    typedef struct {
+        uint32_t input_size;
+        uint32_t channel;
+        uint32_t output_size;
+        uint32_t generated;
+        cycle_type mha_cycles;  // DRAM cycles, at the current sequence length
+    } Request;
+
+    typedef struct {
+        cycle_type sa_cycles;
+        uint64_t bytes;
+    } MatMulCost;
+
+    MatMulCost matmul(uint32_t m, uint32_t k, uint32_t n, bool weights = true);
+    std::vector<MatMulCost> ffn(uint32_t tokens);
+    cycle_type mha_cycles(uint32_t seq_len);
+    std::vector<std::vector<Request>> group_sub_batches(std::vector<Request> batch);
+    StageEstimate estimate_stage(Stage stage, std::vector<std::vector<Request>> &sub_batches);
+};
@@ -0,0 +1,265 @@
+#include "ChromeTrace.h"
+
+namespace ChromeTrace {
+namespace {
+using EventTrace::Event;
+using EventTrace::Type;
+
+constexpr int stage_pid = 0;
+constexpr int core_pid_base = 1;     // + core id
+constexpr int dram_pid_base = 1000;  // + channel
+
+// tids inside a core / DRAM channel process. Overlapping slices go to tid + lane.
+constexpr int sa_tid = 0;
+constexpr int vector_tid_base = 1000;  // * (1 + vector pipeline)
+constexpr int memory_tid = 100000;
+constexpr int tile_tid = 100001;
+constexpr int pim_tid = 0;
+constexpr int normal_tid = 1000;
+
+class Writer {
+   public:
+    Writer(std::string path) : _out(path) {
+        if (!_out.is_open()) {
+            spdlog::error("Failed to open {}", path);
+            return;
+        }
+        _out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    }
+    ~Writer() { _out << "\n]}\n"; }
+
+    bool is_open() { return _out.is_open(); }
+
+    void process(int pid, std::string name) {
+        if (_named_processes.count(pid)) return;
+        _named_processes.insert(pid);
+        write(fmt::format(
+            "\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"{}\"}}", pid,
+            name));
+        write(fmt::format("\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":{},"
+                          "\"args\":{{\"sort_index\":{}}}",
+                          pid, pid));
+    }
+    void thread(int pid, int tid, std::string name) {
+        if (_named_threads.count({pid, tid})) return;
+        _named_threads.insert({pid, tid});
+        write(fmt::format("\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{},\"tid\":{},"
+                          "\"args\":{{\"name\":\"{}\"}}",
+                          pid, tid, name));
+        write(fmt::format("\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":{},\"tid\":{},"
+                          "\"args\":{{\"sort_index\":{}}}",
+                          pid, tid, tid));
+    }
+    void slice(int pid, int tid, std::string name, double ts, double dur) {
+        write(fmt::format("\"ph\":\"X\",\"name\":\"{}\",\"pid\":{},\"tid\":{},\"ts\":{:.3f},"
+                          "\"dur\":{:.3f}",
+                          name, pid, tid, ts, dur));
+    }
+    void instant(int pid, int tid, std::string name, double ts) {
+        write(fmt::format(
+            "\"ph\":\"i\",\"s\":\"t\",\"name\":\"{}\",\"pid\":{},\"tid\":{},\"ts\":{:.3f}", name,
+            pid, tid, ts));
+    }
+    // ph: s (start), t (step), f (finish). binds to the slice enclosing ts on (pid, tid)
+    void flow(char ph, uint64_t id, int pid, int tid, double ts) {
+        write(fmt::format("\"ph\":\"{}\",\"bp\":\"e\",\"cat\":\"mem\",\"name\":\"MemoryAccess\","
+                          "\"id\":{},\"pid\":{},\"tid\":{},\"ts\":{:.3f}",
+                          ph, id, pid, tid, ts));
+    }
+
+   private:
+    std::ofstream _out;
+    bool _first = true;
+    std::set<int> _named_processes;
+    std::set<std::pair<int, int>> _named_threads;
+
+    void write(std::string fields) {
+        if (!_first) _out << ",\n";
+        _first = false;
+        _out << "{" << fields << "}";
+    }
+};
+
+// Puts each slice on the first lane that is free when it starts
+class Lanes {
+   public:
+    int acquire(uint64_t start, uint64_t end) {
+        for (size_t lane = 0; lane < _ends.size(); lane++) {
+            if (_ends[lane] <= start) {
+                _ends[lane] = end;
+                return static_cast<int>(lane);
+            }
+        }
+        _ends.push_back(end);
+        return _ends.size() - 1;
+    }
+    void release(int lane, uint64_t end) { _ends[lane] = end; }
+
+   private:
+    std::vector<uint64_t> _ends;
+};
+
+std::string lane_name(std::string name, int lane) {
+    return lane == 0 ? name : fmt::format("{} #{}", name, lane);
+}
+
+bool is_pim_request(MemoryAccessType type) {
+    return type != MemoryAccessType::READ && type != MemoryAccessType::WRITE;
+}
+
+struct OpenRequest {
+    uint64_t issue_cycle;
+    int tid;
+    int lane;
+};
+}  // namespace
+
+void convert(std::string events_path, std::string json_path, SimulationConfig config) {
+    FILE *file = fopen(events_path.c_str(), "rb");
+    if (file == nullptr) {
+        spdlog::error("Failed to open event trace {}", events_path);
+        return;
+    }
+    Writer writer(json_path);
+    if (!writer.is_open()) {
+        fclose(file);
+        return;
+    }
+
+    // timestamps are in us
+    auto core_ts = [&](uint64_t cycle) { return (double)cycle / config.core_freq; };
+    auto dram_ts = [&](uint64_t cycle) { return (double)cycle / config.dram_freq; };
+
+    std::map<std::pair<int, int>, Lanes> lanes;  // (pid, base tid)
+    std::map<uint64_t, uint64_t> flow_ids;       // MemoryAccess* -> flow id, while in flight
+    std::map<uint64_t, OpenRequest> open_requests;  // MemoryAccess* -> DRAM slice being built
+    uint64_t next_flow_id = 0;
+
+    uint64_t stage_begin = 0;
+    int64_t stage_sa_sub_batch = -1;
+    int64_t stage_pim_sub_batch = -1;
+
+    writer.process(stage_pid, "Sub-batches");
+
+    std::vector<Event> events(4096);
+    size_t count;
+    while ((count = fread(events.data(), sizeof(Event), events.size(), file)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            Event &event = events[i];
+            switch (event.type) {
+                case Type::StageBegin:
+                    stage_begin = event.cycle;
+                    stage_sa_sub_batch = static_cast<int64_t>(event.arg0);
+                    stage_pim_sub_batch = static_cast<int64_t>(event.arg1);
+                    break;
+                case Type::StageEnd: {
+                    std::string stage = stageToString(static_cast<Stage>(event.id));
+                    double ts = core_ts(stage_begin);
+                    double dur = core_ts(event.cycle) - ts;
+                    if (stage_sa_sub_batch >= 0) {
+                        writer.thread(stage_pid, stage_sa_sub_batch,
+                                      fmt::format("sub-batch {}", stage_sa_sub_batch));
+                        writer.slice(stage_pid, stage_sa_sub_batch, stage + " SA", ts, dur);
+                    }
+                    if (stage_pim_sub_batch >= 0) {
+                        writer.thread(stage_pid, stage_pim_sub_batch,
+                                      fmt::format("sub-batch {}", stage_pim_sub_batch));
+                        writer.slice(stage_pid, stage_pim_sub_batch, stage + " PIM", ts, dur);
+                    }
+                    break;
+                }
+                case Type::TileIssue:
+                case Type::TileFinish: {
+                    int pid = core_pid_base + event.unit;
+                    writer.process(pid, fmt::format("Core {}", event.unit));
+                    writer.thread(pid, tile_tid, "Tiles");
+                    writer.instant(pid, tile_tid,
+                                   fmt::format("{} op {} batch {}",
+                                               event.type == Type::TileIssue ? "issue" : "finish",
+                                               event.id, event.arg0),
+                                   core_ts(event.cycle));
+                    break;
+                }
+                case Type::SAInst:
+                case Type::VectorInst: {
+                    int pid = core_pid_base + event.unit;
+                    bool is_sa = event.type == Type::SAInst;
+                    int base_tid = is_sa ? sa_tid : vector_tid_base * (1 + event.arg1);
+                    std::string name = is_sa ? "SA" : fmt::format("Vector {}", event.arg1);
+                    int lane = lanes[{pid, base_tid}].acquire(event.cycle, event.arg0);
+                    writer.process(pid, fmt::format("Core {}", event.unit));
+                    writer.thread(pid, base_tid + lane, lane_name(name, lane));
+                    writer.slice(pid, base_tid + lane,
+                                 opcodeToString(static_cast<Opcode>(event.id)),
+                                 core_ts(event.cycle), core_ts(event.arg0 - event.cycle));
+                    break;
+                }
+                case Type::MemIssue:
+                case Type::MemResponse: {
+                    int pid = core_pid_base + event.unit;
+                    bool is_issue = event.type == Type::MemIssue;
+                    std::string type = memAccessTypeString(static_cast<MemoryAccessType>(event.id));
+                    writer.process(pid, fmt::format("Core {}", event.unit));
+                    writer.thread(pid, memory_tid, "Memory");
+                    writer.slice(pid, memory_tid, (is_issue ? "issue " : "response ") + type,
+                                 core_ts(event.cycle), core_ts(1));
+                    if (is_issue) {
+                        flow_ids[event.arg0] = next_flow_id;
+                        writer.flow('s', next_flow_id, pid, memory_tid, core_ts(event.cycle));
+                        next_flow_id++;
+                    } else if (flow_ids.count(event.arg0)) {
+                        writer.flow('f', flow_ids[event.arg0], pid, memory_tid,
+                                    core_ts(event.cycle));
+                        flow_ids.erase(event.arg0);
+                    }
+                    break;
+                }
+                case Type::DramIssue: {
+                    int pid = dram_pid_base + event.unit;
+                    auto type = static_cast<MemoryAccessType>(event.id);
+                    int base_tid = is_pim_request(type) ? pim_tid : normal_tid;
+                    int lane = lanes[{pid, base_tid}].acquire(event.cycle, UINT64_MAX);
+                    writer.process(pid, fmt::format("DRAM ch {}", event.unit));
+                    writer.thread(pid, base_tid + lane,
+                                  lane_name(is_pim_request(type) ? "PIM" : "Normal", lane));
+
+                    if (type == MemoryAccessType::P_HEADER) {
+                        // P_HEADER gets no response
+                        lanes[{pid, base_tid}].release(lane, event.cycle + 1);
+                        writer.slice(pid, base_tid + lane, memAccessTypeString(type),
+                                     dram_ts(event.cycle), dram_ts(1));
+                        if (flow_ids.count(event.arg1)) {
+                            writer.flow('f', flow_ids[event.arg1], pid, base_tid + lane,
+                                        dram_ts(event.cycle));
+                            flow_ids.erase(event.arg1);
+                        }
+                        break;
+                    }
+                    open_requests[event.arg1] = OpenRequest{event.cycle, base_tid, lane};
+                    if (flow_ids.count(event.arg1))
+                        writer.flow('t', flow_ids[event.arg1], pid, base_tid + lane,
+                                    dram_ts(event.cycle));
+                    break;
+                }
+                case Type::DramResponse: {
+                    int pid = dram_pid_base + event.unit;
+                    auto it = open_requests.find(event.arg1);
+                    if (it == open_requests.end()) break;
+                    OpenRequest &request = it->second;
+                    lanes[{pid, request.tid}].release(request.lane, event.cycle);
+                    writer.slice(pid, request.tid + request.lane,
+                                 memAccessTypeString(static_cast<MemoryAccessType>(event.id)),
+                                 dram_ts(request.issue_cycle),
+                                 dram_ts(event.cycle - request.issue_cycle));
+                    open_requests.erase(it);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+    fclose(file);
+    spdlog::info("Chrome trace: {}", json_path);
+}
+}  // namespace ChromeTrace
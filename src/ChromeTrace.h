@@ -0,0 +1,16 @@
+#pragma once
+#include "Common.h"
+
+/**
+ * Converts {log_dir}/events.bin (EventTrace) into Chrome trace-event JSON, viewable in
+ * ui.perfetto.dev or chrome://tracing.
+ *   "Sub-batches" : one track per sub-batch with the stage it runs on SA / PIM
+ *   "Core N"      : systolic array, each vector pipeline, tile issue/finish and memory accesses
+ *   "DRAM ch N"   : PIM and normal requests from DRAM enqueue to response
+ * Flow arrows follow each MemoryAccess from the core through DRAM and back.
+ * Overlapping slices (pipelined SA instructions, in-flight DRAM requests) are spread over
+ * extra tracks so every track is properly nested.
+ */
+namespace ChromeTrace {
+void convert(std::string events_path, std::string json_path, SimulationConfig config);
+}
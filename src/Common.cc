@@ -1,50 +1,108 @@
 #include "Common.h"
 
 uint32_t generate_id() {
-    static uint32_t id_counter{0};
+    static thread_local uint32_t id_counter{0};
     return id_counter++;
 }
 uint32_t generate_mem_access_id() {
-    static uint32_t id_counter{0};
+    static thread_local uint32_t id_counter{0};
     return id_counter++;
 }
 
 namespace AddressConfig {
-addr_type alignment = Config::global_config.dram_req_size;  // BL * dev width / 8 bytes
-addr_type channel_mask;                                     // not used
-addr_type channel_offset;                                   // not used
+thread_local addr_type alignment = Config::global_config.dram_req_size;  // BL * dev width / 8
+thread_local Layout dram_layout;
+thread_local Layout linear_layout;
+thread_local bool bank_xor_hash = false;
 }  // namespace AddressConfig
 
-int MemoryAccess::req_count = 0;
-int MemoryAccess::pre_req_count = 0;
+thread_local int MemoryAccess::req_count = 0;
+thread_local int MemoryAccess::pre_req_count = 0;
 
-// FIXME: Magic Numbers
-uint32_t AddressConfig::mask_channel(addr_type address) {
-    const int col_bits = 4;
-    const int offset = 6;
-
-    int ch = (address >> (col_bits + offset)) & channel_mask;
-    return ch;
+void AddressConfig::init(SimulationConfig config) {
+    alignment = config.dram_req_size;
+    dram_layout.init(config.dram_address_mapping);
+    if (config.dram_interleave == "cacheline")
+        linear_layout.init("rorabgbacoch");  // consecutive requests go to consecutive channels
+    else if (config.dram_interleave == "row")
+        linear_layout.init("rorabgbachco");  // fill the columns of a row before the next channel
+    else
+        linear_layout.init(config.dram_interleave);
+    bank_xor_hash = config.dram_bank_xor_hash;
+    spdlog::info("DRAM address mapping {}, interleave {}{}", dram_layout.order,
+                 linear_layout.order, bank_xor_hash ? ", bank XOR hash" : "");
 }
 
-addr_type AddressConfig::switch_co_ch(addr_type addr) {
-    const int num_col_bits = 4;
-    const int num_ch_bits = 5;
-    const int num_offset = 6;
+// HBM2_8Gb_x128_pim.ini, the PIM constructor checks them against the loaded NewtonSim config
+int AddressConfig::field_bits(Field field) {
+    switch (field) {
+        case CH:
+            return LogBase2(Config::global_config.dram_channels);
+        case RA:
+            return 1;
+        case BG:
+            return 2;
+        case BA:
+            return 2;
+        case RO:
+            return 15;
+        case CO:
+            return 4;
+        default:
+            ast(0);
+            return 0;
+    }
+}
 
-    const addr_type ch_mask = ((1 << num_ch_bits) - 1) << (num_col_bits + num_offset);
-    const addr_type col_mask = ((1 << num_col_bits) - 1) << num_offset;
+void AddressConfig::Layout::init(std::string order) {
+    const std::string names[NUM_FIELDS] = {"ch", "ra", "bg", "ba", "ro", "co"};
+    if (order.size() != 2 * NUM_FIELDS)
+        throw std::runtime_error(fmt::format("Invalid address mapping {}", order));
+
+    this->order = order;
+    std::fill(pos, pos + NUM_FIELDS, -1);
+    int bit = 0;
+    for (int i = NUM_FIELDS - 1; i >= 0; i--) {
+        auto name = std::find(names, names + NUM_FIELDS, order.substr(2 * i, 2));
+        int field = name - names;
+        if (name == names + NUM_FIELDS || pos[field] >= 0)
+            throw std::runtime_error(fmt::format("Invalid address mapping {}", order));
+        pos[field] = bit;
+        mask[field] = (1ULL << field_bits(static_cast<Field>(field))) - 1;
+        bit += field_bits(static_cast<Field>(field));
+    }
+}
 
-    const addr_type mask = ch_mask | col_mask;
+addr_type AddressConfig::Layout::encode(const addr_type fields[NUM_FIELDS]) const {
+    addr_type addr = 0;
+    for (int field = 0; field < NUM_FIELDS; field++) {
+        addr |= (fields[field] & mask[field]) << pos[field];
+    }
+    return addr << LogBase2(alignment);
+}
 
-    addr_type new_col_bits = (addr & (col_mask << num_ch_bits)) >> num_ch_bits;
-    addr_type new_ch_bits = (addr & (ch_mask >> num_col_bits)) << num_col_bits;
+void AddressConfig::Layout::decode(addr_type addr, addr_type fields[NUM_FIELDS]) const {
+    addr >>= LogBase2(alignment);
+    for (int field = 0; field < NUM_FIELDS; field++) {
+        fields[field] = (addr >> pos[field]) & mask[field];
+    }
+}
 
-    addr = addr & (~mask);
-    addr = addr | new_col_bits;
-    addr = addr | new_ch_bits;
+uint32_t AddressConfig::mask_channel(addr_type address) {
+    return (address >> (LogBase2(alignment) + dram_layout.pos[CH])) & dram_layout.mask[CH];
+}
 
-    return addr;
+// Maps a linear tensor address onto the DRAM: linear_layout picks the interleaving, and the bank
+// XOR hash spreads rows that would conflict in one bank over the banks of the channel.
+// PIM commands encode their own fields with make_address and never go through this.
+addr_type AddressConfig::linear_to_dram(addr_type addr) {
+    addr_type fields[NUM_FIELDS];
+    linear_layout.decode(addr, fields);
+    if (bank_xor_hash) {
+        fields[BA] ^= fields[RO] & dram_layout.mask[BA];
+        fields[BG] ^= (fields[RO] >> field_bits(BA)) & dram_layout.mask[BG];
+    }
+    return dram_layout.encode(fields) | (addr & (alignment - 1));
 }
 
 // used in NPU-only
@@ -52,7 +110,7 @@ addr_type AddressConfig::switch_co_ch(addr_type addr) {
 // align cachline size to 4B
 // ex) allocate 31 bytes => align to 32 bytes
 addr_type AddressConfig::allocate_address(uint32_t size) {
-    static addr_type base_addr{0};
+    static thread_local addr_type base_addr{0};
 
     addr_type result = base_addr;
     base_addr += size;
@@ -75,7 +133,7 @@ std::vector<MemoryAccess *> MemoryAccess::from_instruction(Instruction &inst, ui
                                                            bool request, uint32_t core_id,
                                                            cycle_type start_cycle, int buffer_id,
                                                            StagePlatform stage_platform) {
-    static addr_type const_addr = 0;
+    static thread_local addr_type const_addr = 0;
     const addr_type max_address = Config::global_config.model_n_embd *
                                   Config::global_config.model_n_embd * 5 * 2 /
                                   Config::global_config.n_tp;
@@ -83,11 +141,15 @@ std::vector<MemoryAccess *> MemoryAccess::from_instruction(Instruction &inst, ui
     robin_hood::unordered_set<addr_type> aligned_src_addrs;
     for (auto addr : inst.src_addrs) {
         pre_req_count++;
+        if (inst.direct_dram_addr) {
+            aligned_src_addrs.insert(AddressConfig::align(addr));
+            continue;
+        }
         const_addr += 2;
         if (const_addr >= max_address) {
             const_addr = 0;
         }
-        aligned_src_addrs.insert(AddressConfig::align(AddressConfig::switch_co_ch(const_addr)));
+        aligned_src_addrs.insert(AddressConfig::align(AddressConfig::linear_to_dram(const_addr)));
     }
 
     std::vector<MemoryAccess *> ret;
@@ -141,7 +203,7 @@ void PrintColor(Color color, std::string str) {
     std::cout << color_code << str << "\033[0m" << std::endl;
 }
 
-SimulationConfig Config::global_config;
+thread_local SimulationConfig Config::global_config;
 
 SimulationConfig initialize_config(json config) {
     SimulationConfig parsed_config;
@@ -164,6 +226,8 @@ SimulationConfig initialize_config(json config) {
 
     parsed_config.vector_core_count = config["vector_core_count"];
     parsed_config.vector_core_width = config["vector_core_width"];
+    if (config.contains("vector_initiation_interval"))
+        parsed_config.vector_initiation_interval = config["vector_initiation_interval"];
     parsed_config.add_latency = config["add_latency"];
     parsed_config.mul_latency = config["mul_latency"];
     parsed_config.exp_latency = config["exp_latency"];
@@ -198,11 +262,18 @@ SimulationConfig initialize_config(json config) {
     parsed_config.precision = config["precision"];
     parsed_config.layout = config["layout"];
     parsed_config.scheduler_type = config["scheduler"];
+    std::set<std::string> schedulers = {"simple", "neupims", "fcfs", "sjf", "edf", "fair"};
+    if (schedulers.find(parsed_config.scheduler_type) == schedulers.end())
+        throw std::runtime_error(
+            fmt::format("Not implemented scheduler {} ", parsed_config.scheduler_type));
     return parsed_config;
 }
 
 void initialize_memory_config(std::string mem_config_path) {
-    json mem_config = load_config(mem_config_path);
+    initialize_memory_config(load_config(mem_config_path));
+}
+
+void initialize_memory_config(json mem_config) {
     PrintColor(Color::RED, (std::string)mem_config["dram_type"]);
     /* DRAM config */
     if ((std::string)mem_config["dram_type"] == "dram")
@@ -219,6 +290,14 @@ void initialize_memory_config(std::string mem_config_path) {
     Config::global_config.dram_channels = mem_config["dram_channels"];
     if (mem_config.contains("dram_req_size"))
         Config::global_config.dram_req_size = mem_config["dram_req_size"];
+    if (mem_config.contains("dram_address_mapping"))
+        Config::global_config.dram_address_mapping = mem_config["dram_address_mapping"];
+    if (mem_config.contains("dram_interleave"))
+        Config::global_config.dram_interleave = mem_config["dram_interleave"];
+    if (mem_config.contains("dram_bank_xor_hash"))
+        Config::global_config.dram_bank_xor_hash = mem_config["dram_bank_xor_hash"];
+    if (mem_config.contains("weight_striping"))
+        Config::global_config.weight_striping = mem_config["weight_striping"];
 
     /* PIM config */
     if (mem_config.contains("pim_config_path")) {
@@ -228,6 +307,8 @@ void initialize_memory_config(std::string mem_config_path) {
         Config::global_config.dram_banks_per_ch = mem_config["dram_banks_per_ch"];
         // # params per PIM_COMP command
         Config::global_config.pim_comp_coverage = mem_config["pim_comp_coverage"];
+        if (mem_config.contains("pim_calibration"))
+            Config::global_config.pim_calibration = mem_config["pim_calibration"];
     }
 
     Config::global_config.HBM_size = (uint64_t)(mem_config["HBM_size"])GB;
@@ -246,19 +327,90 @@ void initialize_client_config(std::string cli_config_path) {
 }
 
 void initialize_model_config(std::string model_config_path) {
-    json model_config = load_config(model_config_path);
+    initialize_model_config(load_config(model_config_path));
+}
+
+namespace {
+// bits per element of a weight or KV cache dtype, "" = precision
+uint32_t dtype_bits(std::string dtype, uint32_t precision) {
+    if (dtype.empty()) return 8 * precision;
+    if (dtype == "fp32") return 32;
+    if (dtype == "fp16" || dtype == "bf16") return 16;
+    if (dtype == "fp8" || dtype == "int8") return 8;
+    if (dtype == "int4") return 4;
+    throw std::runtime_error(fmt::format("Not implemented dtype {} ", dtype));
+}
+
+void set_model_config(SimulationConfig &config, json model_config) {
     /* GPT configs */
-    Config::global_config.model_name = model_config["model_name"];
-    Config::global_config.model_params_b = model_config["model_params_b"];
-    Config::global_config.model_vocab_size = model_config["model_vocab_size"];
-    Config::global_config.model_n_layer = model_config["model_n_layer"];
-    Config::global_config.model_n_head = model_config["model_n_head"];
-    Config::global_config.model_n_embd = model_config["model_n_embd"];
+    config.model_name = model_config["model_name"];
+    config.model_params_b = model_config["model_params_b"];
+    config.model_vocab_size = model_config["model_vocab_size"];
+    config.model_n_layer = model_config["model_n_layer"];
+    config.model_n_head = model_config["model_n_head"];
+    config.model_n_embd = model_config["model_n_embd"];
+    /* MoE configs */
+    config.model_n_experts = 0;
+    if (model_config.contains("model_n_experts"))
+        config.model_n_experts = model_config["model_n_experts"];
+    config.model_n_experts_per_token = 2;
+    if (model_config.contains("model_n_experts_per_token"))
+        config.model_n_experts_per_token = model_config["model_n_experts_per_token"];
+    config.model_expert_ffn_dim = 4 * config.model_n_embd;
+    if (model_config.contains("model_expert_ffn_dim"))
+        config.model_expert_ffn_dim = model_config["model_expert_ffn_dim"];
+    if (config.model_n_experts > 0 &&
+        (config.model_n_experts_per_token == 0 ||
+         config.model_n_experts_per_token > config.model_n_experts))
+        throw std::runtime_error("model_n_experts_per_token has to be in [1, model_n_experts]");
     /* parallelism config */
-    Config::global_config.n_tp = model_config["n_tp"];
+    config.n_tp = model_config["n_tp"];
+}
+}  // namespace
+
+void initialize_model_config(json model_config) {
+    initialize_models_config(json::array({model_config}));
+}
+
+// A JSON array with an entry per model: a model config path, or
+// {"model_config": path, "kv_share": fraction of the KV rows of each channel}. Returns the
+// model configs, with kv_share added where given.
+json load_models_list(std::string models_list_path) {
+    json models = json::array();
+    for (auto &entry : load_config(models_list_path)) {
+        json model = load_config(entry.is_string() ? entry : entry["model_config"]);
+        if (entry.is_object() && entry.contains("kv_share")) model["kv_share"] = entry["kv_share"];
+        models.push_back(model);
+    }
+    return models;
+}
+
+void initialize_models_config(json models) {
+    if (!models.is_array() || models.empty())
+        throw std::runtime_error("models list has no model");
+    set_model_config(Config::global_config, models[0]);
+    Config::global_config.models = models;
+}
+
+uint32_t kv_page_elements(const SimulationConfig &config) {
+    return config.dram_page_size * 8 / config.kv_bits;
+}
+
+uint32_t kv_comp_coverage(const SimulationConfig &config) {
+    return config.pim_comp_coverage * 8 * config.precision / config.kv_bits;
+}
+
+SimulationConfig model_config_of(const SimulationConfig &config, uint32_t model) {
+    ast(model < config.models.size());
+    SimulationConfig ret = config;
+    set_model_config(ret, config.models[model]);
+    return ret;
 }
 void initialize_system_config(std::string sys_config_path) {
-    json sys_config = load_config(sys_config_path);
+    initialize_system_config(load_config(sys_config_path));
+}
+
+void initialize_system_config(json sys_config) {
     /* Batch configs */
     if ((std::string)sys_config["run_mode"] == "npu")
         Config::global_config.run_mode = RunMode::NPU_ONLY;
@@ -268,6 +420,10 @@ void initialize_system_config(std::string sys_config_path) {
         Config::global_config.run_mode = RunMode::NPU_ONLY;
 
     Config::global_config.ch_load_balancing = sys_config["ch_load_balancing"];
+    if (sys_config.contains("kv_migration"))
+        Config::global_config.kv_migration = sys_config["kv_migration"];
+    if (sys_config.contains("kv_migration_threshold"))
+        Config::global_config.kv_migration_threshold = sys_config["kv_migration_threshold"];
 
     Config::global_config.kernel_fusion = sys_config["kernel_fusion"];
 
@@ -276,6 +432,159 @@ void initialize_system_config(std::string sys_config_path) {
     Config::global_config.max_batch_size = sys_config["max_batch_size"];
 
     Config::global_config.sub_batch_mode = sys_config["sub_batch_mode"];
+    Config::global_config.num_sub_batches = Config::global_config.sub_batch_mode ? 2 : 1;
+
+    if (sys_config.contains("event_trace"))
+        Config::global_config.event_trace = sys_config["event_trace"];
+    if (sys_config.contains("chrome_trace"))
+        Config::global_config.chrome_trace = sys_config["chrome_trace"];
+    if (sys_config.contains("stats_format"))
+        Config::global_config.stats_format = sys_config["stats_format"];
+    if (sys_config.contains("stats_skip_zero"))
+        Config::global_config.stats_skip_zero = sys_config["stats_skip_zero"];
+    if (sys_config.contains("stats_buffer_rows"))
+        Config::global_config.stats_buffer_rows = sys_config["stats_buffer_rows"];
+    if (sys_config.contains("checkpoint_stage"))
+        Config::global_config.checkpoint_stage = sys_config["checkpoint_stage"];
+    if (sys_config.contains("checkpoint_iteration"))
+        Config::global_config.checkpoint_iteration = sys_config["checkpoint_iteration"];
+    if (sys_config.contains("restore_checkpoint"))
+        Config::global_config.restore_checkpoint = sys_config["restore_checkpoint"];
+    if (sys_config.contains("sampling_detailed_iters"))
+        Config::global_config.sampling_detailed_iters = sys_config["sampling_detailed_iters"];
+    if (sys_config.contains("sampling_seq_bin"))
+        Config::global_config.sampling_seq_bin = sys_config["sampling_seq_bin"];
+    if (sys_config.contains("sampling_batch_bin"))
+        Config::global_config.sampling_batch_bin = sys_config["sampling_batch_bin"];
+    if (sys_config.contains("analytical_model"))
+        Config::global_config.analytical_model = sys_config["analytical_model"];
+    std::string analytical_model = Config::global_config.analytical_model;
+    if (analytical_model != "off" && analytical_model != "only" && analytical_model != "validate")
+        throw std::runtime_error(
+            fmt::format("Not implemented analytical_model {} ", analytical_model));
+    if (sys_config.contains("trace_sampler_stats"))
+        Config::global_config.trace_sampler_stats = sys_config["trace_sampler_stats"];
+    if (sys_config.contains("trace_sampler_requests"))
+        Config::global_config.trace_sampler_requests = sys_config["trace_sampler_requests"];
+    if (sys_config.contains("trace_sampler_seed"))
+        Config::global_config.trace_sampler_seed = sys_config["trace_sampler_seed"];
+    if (sys_config.contains("trace_sampler_rate"))
+        Config::global_config.trace_sampler_rate = sys_config["trace_sampler_rate"];
+    if (sys_config.contains("decode_top_k"))
+        Config::global_config.decode_top_k = sys_config["decode_top_k"];
+    if (sys_config.contains("decode_top_p"))
+        Config::global_config.decode_top_p = sys_config["decode_top_p"];
+    if (sys_config.contains("preemption"))
+        Config::global_config.preemption = sys_config["preemption"];
+    std::string preemption = Config::global_config.preemption;
+    if (preemption != "recompute" && preemption != "swap")
+        throw std::runtime_error(fmt::format("Not implemented preemption {} ", preemption));
+    if (sys_config.contains("preemption_victim"))
+        Config::global_config.preemption_victim = sys_config["preemption_victim"];
+    std::string preemption_victim = Config::global_config.preemption_victim;
+    if (preemption_victim != "lru" && preemption_victim != "priority")
+        throw std::runtime_error(
+            fmt::format("Not implemented preemption_victim {} ", preemption_victim));
+    if (sys_config.contains("swap_bandwidth"))
+        Config::global_config.swap_bandwidth = sys_config["swap_bandwidth"];
+    if (sys_config.contains("swap_space"))
+        Config::global_config.swap_space = sys_config["swap_space"];
+    if (sys_config.contains("slo_ttft")) Config::global_config.slo_ttft = sys_config["slo_ttft"];
+    if (sys_config.contains("slo_tpot")) Config::global_config.slo_tpot = sys_config["slo_tpot"];
+    if (sys_config.contains("sjf_prediction_error"))
+        Config::global_config.sjf_prediction_error = sys_config["sjf_prediction_error"];
+    if (sys_config.contains("kv_partition"))
+        Config::global_config.kv_partition = sys_config["kv_partition"];
+    std::string kv_partition = Config::global_config.kv_partition;
+    if (kv_partition != "shared" && kv_partition != "static")
+        throw std::runtime_error(fmt::format("Not implemented kv_partition {} ", kv_partition));
+    double kv_shares = 0;
+    for (auto &model : Config::global_config.models)
+        kv_shares += model.value("kv_share", 1.0 / Config::global_config.models.size());
+    if (kv_partition == "static" && kv_shares > 1 + 1e-9)
+        throw std::runtime_error(fmt::format("kv_share of the models sums to {} > 1", kv_shares));
+    if (sys_config.contains("prefill_devices"))
+        Config::global_config.prefill_devices = sys_config["prefill_devices"];
+    if (sys_config.contains("prefill_config"))
+        Config::global_config.prefill_config = sys_config["prefill_config"];
+    if (sys_config.contains("prefill_router"))
+        Config::global_config.prefill_router = sys_config["prefill_router"];
+    std::string prefill_router = Config::global_config.prefill_router;
+    if (prefill_router != "round_robin" && prefill_router != "least_loaded")
+        throw std::runtime_error(fmt::format("Not implemented prefill_router {} ", prefill_router));
+    if (sys_config.contains("kv_link_bandwidth"))
+        Config::global_config.kv_link_bandwidth = sys_config["kv_link_bandwidth"];
+    if (sys_config.contains("kv_link_latency"))
+        Config::global_config.kv_link_latency = sys_config["kv_link_latency"];
+    // requests in the prefill pool are not part of a checkpoint
+    if (Config::global_config.prefill_devices > 0 &&
+        (!Config::global_config.checkpoint_stage.empty() ||
+         !Config::global_config.restore_checkpoint.empty()))
+        throw std::runtime_error("checkpoints are not supported with prefill_devices");
+    // activations stay at precision, weights and KV cache may be narrower
+    if (sys_config.contains("weight_dtype"))
+        Config::global_config.weight_dtype = sys_config["weight_dtype"];
+    if (sys_config.contains("kv_dtype")) Config::global_config.kv_dtype = sys_config["kv_dtype"];
+    uint32_t precision_bits = 8 * Config::global_config.precision;
+    Config::global_config.weight_bits =
+        dtype_bits(Config::global_config.weight_dtype, Config::global_config.precision);
+    Config::global_config.kv_bits =
+        dtype_bits(Config::global_config.kv_dtype, Config::global_config.precision);
+    if (Config::global_config.weight_bits > precision_bits ||
+        Config::global_config.kv_bits > precision_bits)
+        throw std::runtime_error(fmt::format("weight_dtype and kv_dtype cannot be wider than "
+                                             "precision ({} bits)",
+                                             precision_bits));
+    if (sys_config.contains("moe_routing"))
+        Config::global_config.moe_routing = sys_config["moe_routing"];
+    std::string moe_routing = Config::global_config.moe_routing;
+    if (moe_routing != "uniform" && moe_routing != "zipf" && moe_routing != "trace")
+        throw std::runtime_error(fmt::format("Not implemented moe_routing {} ", moe_routing));
+    if (sys_config.contains("moe_zipf_s"))
+        Config::global_config.moe_zipf_s = sys_config["moe_zipf_s"];
+    if (sys_config.contains("moe_routing_seed"))
+        Config::global_config.moe_routing_seed = sys_config["moe_routing_seed"];
+    if (moe_routing == "trace") {
+        // tokens routed to each expert, e.g. the router histogram of a real run
+        if (!sys_config.contains("moe_routing_trace"))
+            throw std::runtime_error("moe_routing trace needs moe_routing_trace");
+        std::string path = sys_config["moe_routing_trace"];
+        std::ifstream file(path);
+        if (!file.is_open())
+            throw std::runtime_error(fmt::format("Failed to open moe_routing_trace {}", path));
+        std::stringstream content;
+        content << file.rdbuf();
+        std::string counts = content.str();
+        std::replace(counts.begin(), counts.end(), ',', ' ');
+        std::istringstream stream(counts);
+        double count;
+        while (stream >> count) Config::global_config.moe_expert_load.push_back(count);
+        for (auto &model : Config::global_config.models)
+            if (model.value("model_n_experts", 0u) > 0 &&
+                model.value("model_n_experts", 0u) != Config::global_config.moe_expert_load.size())
+                throw std::runtime_error(fmt::format("moe_routing_trace {} has {} experts", path,
+                                                     Config::global_config.moe_expert_load.size()));
+    }
+    if (sys_config.contains("moe_expert_channels"))
+        Config::global_config.moe_expert_channels = sys_config["moe_expert_channels"];
+    uint32_t expert_channels = Config::global_config.moe_expert_channels;
+    if (expert_channels > 0 &&
+        (expert_channels > Config::global_config.dram_channels ||
+         Config::global_config.dram_channels % expert_channels != 0 ||
+         (expert_channels & (expert_channels - 1)) != 0))
+        throw std::runtime_error(
+            fmt::format("moe_expert_channels {} has to be a power of two dividing dram_channels",
+                        expert_channels));
+    // only striped weights are loaded from their own addresses
+    if (expert_channels > 0 && !Config::global_config.weight_striping)
+        throw std::runtime_error("moe_expert_channels needs weight_striping");
+    if (sys_config.contains("prefix_caching"))
+        Config::global_config.prefix_caching = sys_config["prefix_caching"];
+    // cached prefixes are not part of a checkpoint
+    if (Config::global_config.prefix_caching &&
+        (!Config::global_config.checkpoint_stage.empty() ||
+         !Config::global_config.restore_checkpoint.empty()))
+        throw std::runtime_error("checkpoints are not supported with prefix_caching");
 }
 
 json load_config(std::string config_path) {
@@ -329,40 +638,59 @@ std::string opcodeTypeString(Opcode opcode) {
     }
 }
 
-std::string Instruction::repr() {
-    std::string ret;
+std::string opcodeToString(Opcode opcode) {
     switch (opcode) {
-        case (Opcode::MOVIN):
-            ret += "MOVIN";
-            break;
-        case (Opcode::MOVOUT):
-            ret += "MOVOUT";
-            break;
-        case (Opcode::GEMM_PRELOAD):
-            ret += "GEMM_PRELOAD";
-            break;
-        case (Opcode::GEMM):
-            ret += "GEMM";
-            break;
-        case (Opcode::BAR):
-            ret += "BAR";
-            break;
-        case (Opcode::LAYERNORM):
-            ret += "LAYERNORM";
-            break;
-        case (Opcode::GELU):
-            ret += "GELU";
-            break;
-        case (Opcode::SOFTMAX):
-            ret += "SOFTMAX";
-            break;
-        case (Opcode::ADD):
-            ret += "ADD";
-            break;
-        case (Opcode::DUMMY):
-            ret += "DUMMY";
-            break;
+        case Opcode::MOVIN:
+            return "MOVIN";
+        case Opcode::MOVOUT:
+            return "MOVOUT";
+        case Opcode::MOVOUT_POOL:
+            return "MOVOUT_POOL";
+        case Opcode::GEMM_PRELOAD:
+            return "GEMM_PRELOAD";
+        case Opcode::GEMM:
+            return "GEMM";
+        case Opcode::GEMM_WRITE:
+            return "GEMM_WRITE";
+        case Opcode::COMP:
+            return "COMP";
+        case Opcode::IM2COL:
+            return "IM2COL";
+        case Opcode::LAYERNORM:
+            return "LAYERNORM";
+        case Opcode::GELU:
+            return "GELU";
+        case Opcode::SOFTMAX:
+            return "SOFTMAX";
+        case Opcode::ADD:
+            return "ADD";
+        case Opcode::BAR:
+            return "BAR";
+        case Opcode::PIM_HEADER:
+            return "PIM_HEADER";
+        case Opcode::PIM_GWRITE:
+            return "PIM_GWRITE";
+        case Opcode::PIM_COMP:
+            return "PIM_COMP";
+        case Opcode::PIM_READRES:
+            return "PIM_READRES";
+        case Opcode::PIM_COMPS_READRES:
+            return "PIM_COMPS_READRES";
+        case Opcode::DUMMY:
+            return "DUMMY";
+        case Opcode::SAMPLE:
+            return "SAMPLE";
+        case Opcode::DEQUANT_WGT:
+            return "DEQUANT_WGT";
+        case Opcode::DEQUANT_KV:
+            return "DEQUANT_KV";
+        default:
+            return "UNKNOWN";
     }
+}
+
+std::string Instruction::repr() {
+    std::string ret = opcodeToString(opcode);
     ret += " / src_addrs.size() : ";
     ret += std::to_string(src_addrs.size());
     ret += " / dest_addrs : ";
@@ -486,47 +814,14 @@ int LogBase2(int power_of_two) {
 
 uint64_t AddressConfig::make_address(int channel, int rank, int bankgroup, int bank, int row,
                                      int col) {
-    // rorabgbachco
-    // HBM2_8Gb_s128_pim.ini
-    uint64_t addr = 0;
-
-    int row_bits = 15;
-    int rank_bits = 1;
-    int bankgroup_bits = 2;
-    int bank_bits = 2;
-    int channel_bits = LogBase2(Config::global_config.dram_channels);
-    int col_bits = 4;
-    int offset = 6;
-
-    addr |= row;
-
-    addr <<= rank_bits;
-    addr |= rank;
-
-    addr <<= bankgroup_bits;
-    addr |= bankgroup;
-
-    addr <<= bank_bits;
-    addr |= bank;
-
-    addr <<= channel_bits;
-    addr |= channel;
-
-    addr <<= col_bits;
-    addr |= (col & 15);
-
-    addr <<= offset;
-
-    // spdlog::info("(make_address) hexaddr: {}, ch:{}, ra:{}, bg:{}, ba:{}, ro:{}, co:{}",
-    //              fmt::format("{:#X}", addr), channel, rank, bankgroup, bank, row, col);
-    // uint64_t address =
-    //     memory_system_.config_->MakeAddress(channel, rank, bankgroup, bank, row, col);
-    // if (address == addr)
-    //     PrintError("SUCCESS");
-    // else
-    //     PrintError("FAIL");
-
-    return addr;
+    addr_type fields[NUM_FIELDS];
+    fields[CH] = channel;
+    fields[RA] = rank;
+    fields[BG] = bankgroup;
+    fields[BA] = bank;
+    fields[RO] = row;
+    fields[CO] = col;
+    return dram_layout.encode(fields);
 }
 
 uint64_t AddressConfig::encode_pim_header(int channel, int row, bool for_gwrite, int num_comps,
@@ -573,6 +868,9 @@ std::string stageToString(Stage stage) {
     return (it != stageMap.end()) ? it->second : "unknown";
 }
 
+// SA and PIM alternate, so a sub-batch is never on both in the same stage
+uint32_t stagePeriod() { return 2; }
+
 std::string stagePlatformToString(StagePlatform sp) {
     static const std::map<StagePlatform, std::string> spMap = {
         {StagePlatform::SA, "SA"},
@@ -31,6 +31,7 @@
 #include <csignal>
 #include <fstream>
 
+#include "EventTrace.h"
 #include "SimulationConfig.h"
 #include "Stat.h"
 #include "helper/HelperFunctions.h"
@@ -53,9 +54,27 @@ typedef uint64_t addr_type;
 typedef uint64_t cycle_type;
 
 namespace AddressConfig {
-extern addr_type alignment;
-extern addr_type channel_mask;
-extern addr_type channel_offset;
+enum Field { CH, RA, BG, BA, RO, CO, NUM_FIELDS };
+
+// Bit order of an address above the request offset, MSB first, in the address_mapping format of
+// NewtonSim (e.g. "rorabgbachco")
+struct Layout {
+    std::string order;
+    int pos[NUM_FIELDS];
+    addr_type mask[NUM_FIELDS];
+
+    void init(std::string order);
+    addr_type encode(const addr_type fields[NUM_FIELDS]) const;
+    void decode(addr_type addr, addr_type fields[NUM_FIELDS]) const;
+};
+
+extern thread_local addr_type alignment;
+extern thread_local Layout dram_layout;    // physical layout, has to match pim_config_path
+extern thread_local Layout linear_layout;  // how linear tensor addresses are interleaved
+extern thread_local bool bank_xor_hash;
+
+void init(SimulationConfig config);
+int field_bits(Field field);
 
 uint32_t mask_channel(addr_type address);
 addr_type allocate_address(uint32_t size);
@@ -65,7 +84,7 @@ uint64_t make_address(int channel, int rank, int bankgroup, int bank, int row, i
 uint64_t encode_pim_header(int channel, int row, bool for_gwrite, int num_comps, int num_readres);
 uint64_t encode_pim_comps_readres(int ch, int row, int num_comps, bool last_cmd);
 
-addr_type switch_co_ch(addr_type addr);
+addr_type linear_to_dram(addr_type addr);
 }  // namespace AddressConfig
 
 enum class Color { RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, DEFAULT };
@@ -90,9 +109,14 @@ enum class Opcode {
     PIM_READRES,
     PIM_COMPS_READRES,
     DUMMY,
+    SAMPLE,
+    DEQUANT_WGT,  // tile_k x tile_n elements of weight_dtype to precision
+    DEQUANT_KV,   // tile_k x tile_n PIM results over a kv_dtype KV cache to precision
     SIZE
 };
 
+std::string opcodeToString(Opcode opcode);
+
 struct Tile;
 
 struct Instruction {
@@ -122,6 +146,8 @@ struct Instruction {
     bool valid = true;
 
     bool is_pim_inst = false;
+    // src_addrs are burst-aligned DRAM addresses used as-is (no address spreading)
+    bool direct_dram_addr = false;
 
     std::weak_ptr<Tile> parent_tile;
 
@@ -183,8 +209,8 @@ std::string memAccessTypeString(MemoryAccessType type);
 std::string opcodeTypeString(Opcode opcode);
 
 typedef struct MemoryAccess {
-    static int req_count;
-    static int pre_req_count;
+    static thread_local int req_count;
+    static thread_local int pre_req_count;
 
     uint32_t id;
     addr_type dram_address;
@@ -219,9 +245,19 @@ uint32_t generate_mem_access_id();
 json load_config(std::string config_path);
 SimulationConfig initialize_config(json config);  // npu config
 void initialize_memory_config(std::string mem_config_path);
+void initialize_memory_config(json mem_config);
 void initialize_client_config(std::string cli_config_path);
 void initialize_model_config(std::string model_config_path);
+void initialize_model_config(json model_config);
+json load_models_list(std::string models_list_path);
+void initialize_models_config(json models);  // co-located models, see load_models_list
+SimulationConfig model_config_of(const SimulationConfig &config, uint32_t model);
+// KV cache elements (kv_bits each) in a DRAM page and per PIM_COMP command; pim_comp_coverage
+// is given at precision, packed elements are covered in the same command
+uint32_t kv_page_elements(const SimulationConfig &config);
+uint32_t kv_comp_coverage(const SimulationConfig &config);
 void initialize_system_config(std::string sys_config_path);
+void initialize_system_config(json sys_config);
 
 std::string to_hex(uint32_t input);
 template <typename... Args>
@@ -240,8 +276,8 @@ class BTensor;
 typedef struct {
     // client to scheduler.
     uint32_t id;
-    uint32_t arrival_cycle;    // time spend on client == arrival time to scheduler
-    uint32_t completed_cycle;  // return time to client
+    cycle_type arrival_cycle;    // time spend on client == arrival time to scheduler
+    cycle_type completed_cycle;  // return time to client
 
     // request demand
     uint32_t input_size;   // input sequence length
@@ -251,7 +287,20 @@ typedef struct {
     bool is_initiated;   // whether initialization phase is done
     uint32_t generated;  // # tokens generated
     // mapped channel
-    int channel;
+    int channel;  // -1 until the scheduler assigns one
+
+    uint64_t prefix_id;   // shared prompt prefix or session, 0 if none
+    uint32_t prefix_len;  // prompt tokens of the prefix, 0 = the whole prompt
+    uint32_t priority;    // higher is more urgent
+    uint32_t model;       // index in SimulationConfig::models
+
+    uint64_t tenant;      // user or application, for fair-share admission
+    cycle_type ttft_slo;  // arrival to first token
+    cycle_type tpot_slo;  // per output token after the first
+
+    cycle_type admitted_cycle;     // last time the scheduler allocated its KV cache
+    cycle_type first_token_cycle;  // 0 until the first token is generated
+    bool kv_remote;                // prompt KV cache from a prefill device, not yet in PIM rows
 
     std::vector<Ptr<BTensor>> K_cache;
     std::vector<Ptr<BTensor>> V_cache;
@@ -266,10 +315,11 @@ std::vector<T> slice(std::vector<T> &inp, int start, int end) {
     return std::vector<T>(inp.begin() + start, inp.begin() + end);
 }
 
+// one instance per thread, like Config::global_config
 template <typename T>
 class Singleton {
    protected:
-    static T *instance;
+    static thread_local T *instance;
 
    public:
     static T *GetInstance() {
@@ -277,10 +327,13 @@ class Singleton {
 
         return instance;
     }
-    static void Delete() { delete instance; }
+    static void Delete() {
+        delete instance;
+        instance = nullptr;
+    }
 };
 template <typename T>
-T *Singleton<T>::instance = nullptr;
+thread_local T *Singleton<T>::instance = nullptr;
 
 MemoryAccess *TransToMemoryAccess(Instruction &inst, uint32_t size, uint32_t core_id,
                                   cycle_type start_cycle, int buffer_id,
@@ -289,8 +342,10 @@ MemoryAccess *TransToMemoryAccess(Instruction &inst, uint32_t size, uint32_t cor
 int LogBase2(int power_of_two);
 
 // for Sub-batch interleaving
+// Stages A..F (A..E for a single sub-batch), see Scheduler.h.
 enum class Stage { A, B, C, D, E, F, Finish };
 enum class StagePlatform { SA, PIM, SIZE };
 std::string stageToString(Stage stage);
+uint32_t stagePeriod();  // # of stages until a sub-batch is back on the same platform
 std::string stagePlatformToString(StagePlatform sp);
 //
\ No newline at end of file
@@ -83,7 +83,9 @@ bool Core::can_issue(Tile &next_tile) {
 // switch tiles to shared ptr
 // todo: check tile start cycle
 void Core::issue(Tile &in_tile) {
-    spdlog::info("tile issued {}", in_tile.repr());
+    SPDLOG_DEBUG("tile issued {}", in_tile.repr());
+    EventTrace::record(EventTrace::Type::TileIssue, _core_cycle, _id, in_tile.operation_id,
+                       in_tile.batch, static_cast<uint64_t>(in_tile.stage_platform));
     auto tile = std::make_shared<Tile>(in_tile);
     tile->stat = TileStat(_core_cycle);
     if (tile->skip) {
@@ -216,12 +218,18 @@ bool Core::running() {
 // push into target channel memory request queue
 void Core::push_memory_request(MemoryAccess *request) {
     int channel = AddressConfig::mask_channel(request->dram_address);
+    EventTrace::record(EventTrace::Type::MemIssue, _core_cycle, _id,
+                       static_cast<uint32_t>(request->req_type),
+                       reinterpret_cast<uint64_t>(request), channel);
 
     _memory_request_queues[channel].push(request);
 }
 
 void Core::push_memory_response(MemoryAccess *response) {
     assert(!response->request);  // can only push response
+    EventTrace::record(EventTrace::Type::MemResponse, _core_cycle, _id,
+                       static_cast<uint32_t>(response->req_type),
+                       reinterpret_cast<uint64_t>(response));
 
     bool is_write = response->req_type == MemoryAccessType::WRITE;
     bool is_read = response->req_type == MemoryAccessType::READ;
@@ -1,5 +1,7 @@
 #include "Dram.h"
 
+#include <climits>
+
 #include "helper/HelperFunctions.h"
 
 // >>> gsheo
@@ -15,9 +17,10 @@ PIM::PIM(SimulationConfig config)
     }
 
     _stat_interval = 1000;
-    _stats.resize(config.dram_channels);
+    _stat_sinks.resize(config.dram_channels);
     for (size_t i = 0; i < config.dram_channels; ++i) {
-        _stats[i].push_back(MemoryIOStat(0, i, _stat_interval));
+        _stats.push_back(MemoryIOStat(0, i, _stat_interval));
+        _stat_sinks[i].open(config.log_dir + "/mem_io_ch_" + std::to_string(i));
     }
 
     _config = config;
@@ -26,18 +29,34 @@ PIM::PIM(SimulationConfig config)
     _total_done_requests = 0;
     _stage_cycles = 0;
 
-    // >>> Address mapping test
-    int ch = 1;
-    int rank = 0;
-    int bg = 2;
-    int ba = 1;
-    int row = 231;
-    int col = 10;
-    uint64_t dram_addr = AddressConfig::make_address(ch, rank, bg, ba, row, col);
-    uint64_t newtonsim_addr = MakeAddress(ch, rank, bg, ba, row, col);
-    assert(dram_addr == newtonsim_addr);
+    // the simulator has to lay out addresses like NewtonSim does: the lowest bit of a field
+    // checks its position, all ones its width (both sides mask a field to its width)
+    const std::string names[AddressConfig::NUM_FIELDS] = {"ch", "ra", "bg", "ba", "ro", "co"};
+    for (int field = 0; field < AddressConfig::NUM_FIELDS; field++) {
+        for (int value : {1, INT_MAX}) {
+            int f[AddressConfig::NUM_FIELDS] = {0};
+            f[field] = value;
+            uint64_t dram_addr = AddressConfig::make_address(
+                f[AddressConfig::CH], f[AddressConfig::RA], f[AddressConfig::BG],
+                f[AddressConfig::BA], f[AddressConfig::RO], f[AddressConfig::CO]);
+            uint64_t newtonsim_addr =
+                MakeAddress(f[AddressConfig::CH], f[AddressConfig::RA], f[AddressConfig::BG],
+                            f[AddressConfig::BA], f[AddressConfig::RO], f[AddressConfig::CO]);
+            if (dram_addr != newtonsim_addr) {
+                spdlog::error("{} field of dram_address_mapping {} ({} bits) does not match "
+                              "{}: {:#x} vs {:#x}",
+                              names[field], AddressConfig::dram_layout.order,
+                              AddressConfig::field_bits(static_cast<AddressConfig::Field>(field)),
+                              config.pim_config_path, dram_addr, newtonsim_addr);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
     spdlog::info("Newton init");
-    // <<< Address mapping test
+}
+
+PIM::~PIM() {
+    for (size_t ch = 0; ch < _stats.size(); ++ch) _stat_sinks[ch].push(_stats[ch]);
 }
 
 bool PIM::running() { return false; }
@@ -48,10 +67,10 @@ void PIM::cycle() {
     _stage_cycles++;
     int interval = 10000;
     if (_cycles % interval == 0) {
-        spdlog::debug("-------------DRAM BW Check--------------");
+        SPDLOG_DEBUG("-------------DRAM BW Check--------------");
         for (int ch = 0; ch < _config.dram_channels; ch++) {
-            float util = ((float)_processed_requests[ch] * _burst_cycle) / interval * 100;
-            spdlog::debug("DRAM CH[{}]: BW Util {:.2f}%", ch, util);
+            SPDLOG_DEBUG("DRAM CH[{}]: BW Util {:.2f}%", ch,
+                         ((float)_processed_requests[ch] * _burst_cycle) / interval * 100);
             _total_processed_requests[ch] += _processed_requests[ch];
             _processed_requests[ch] = 0;
         }
@@ -60,8 +79,8 @@ void PIM::cycle() {
     // update stats
     if (_cycles % _stat_interval == 0) {
         for (auto ch = 0; ch < _config.dram_channels; ++ch) {
-            auto stat = MemoryIOStat(_cycles, ch, _stat_interval);
-            _stats[ch].push_back(stat);
+            _stat_sinks[ch].push(_stats[ch]);
+            _stats[ch] = MemoryIOStat(_cycles, ch, _stat_interval);
         }
     }
 }
@@ -109,6 +128,9 @@ void PIM::push(uint32_t cid, MemoryAccess *request) {
     request->request = false;
 
     _mem_req_cnt++;
+    EventTrace::record(EventTrace::Type::DramIssue, _cycles, cid,
+                       static_cast<uint32_t>(request->req_type), target_addr,
+                       reinterpret_cast<uint64_t>(request));
     _mem->AddTransaction(target_addr, int(request->req_type), request);
 }
 
@@ -129,16 +151,16 @@ void PIM::update_stat(uint32_t cid) {
     bool response = false;
     switch (memory_response->req_type) {
         case MemoryAccessType::READ:
-            _stats[cid].back().memory_reads += memory_response->size;
+            _stats[cid].memory_reads += memory_response->size;
             response = true;
             break;
         case MemoryAccessType::WRITE:
-            _stats[cid].back().memory_writes += memory_response->size;
+            _stats[cid].memory_writes += memory_response->size;
             response = true;
             break;
         case MemoryAccessType::READRES:
         case MemoryAccessType::COMPS_READRES:
-            _stats[cid].back().pim_reads += memory_response->size;
+            _stats[cid].pim_reads += memory_response->size;
             response = true;
             break;
             // default:
@@ -156,6 +178,10 @@ void PIM::pop(uint32_t cid) {
     update_stat(cid);
 
     assert(!is_empty(cid));
+    MemoryAccess *response = top(cid);
+    EventTrace::record(EventTrace::Type::DramResponse, _cycles, cid,
+                       static_cast<uint32_t>(response->req_type), response->dram_address,
+                       reinterpret_cast<uint64_t>(response));
     _mem->Pop(cid);
 }
 
@@ -176,19 +202,34 @@ void PIM::print_stat() {
     spdlog::info("DRAM: AVG BW Util {:.2f}%", util);
     spdlog::info("DRAM total cycles: {}", _cycles);
     spdlog::info("DRAM total processed memory requests: {}", _mem_req_cnt);
+    for (int ch = 0; ch < _config.dram_channels; ch++) {
+        spdlog::info("DRAM CH[{}]: PIM refresh stall cycles {}", ch,
+                     _mem->GetRefreshStallCycles(ch));
+    }
     _mem->PrintStats();
 }
 
 void PIM::log(Stage stage) {
     std::string fname = Config::global_config.log_dir + "/mem_io_" + stageToString(stage) + "_ch_";
-    for (size_t i = 0; i < _stats.size(); ++i) {
-        Logger::log(_stats[i], fname + std::to_string(i));
-        auto last_stat = _stats[i].back();
-        _stats[i].clear();
-        _stats[i].push_back(last_stat);
+    for (size_t i = 0; i < _stat_sinks.size(); ++i) {
+        _stat_sinks[i].rotate(fname + std::to_string(i));
     }
 }
 
+void PIM::save_state(std::ostream &os) {
+    os << _cycles << ' ';
+    for (auto requests : _total_processed_requests) os << requests << ' ';
+    _mem->SaveState(os);
+}
+
+void PIM::load_state(std::istream &is) {
+    is >> _cycles;
+    for (auto &requests : _total_processed_requests) is >> requests;
+    _mem->LoadState(is);
+    for (size_t ch = 0; ch < _stats.size(); ++ch)
+        _stats[ch] = MemoryIOStat(_cycles - _cycles % _stat_interval, ch, _stat_interval);
+}
+
 double PIM::get_avg_bw_util() {
     double avg_bw_util =
         ((double)_total_done_requests * _burst_cycle / _config.dram_channels) / _stage_cycles * 100;
@@ -11,6 +11,7 @@
 
 class Dram {
    public:
+    virtual ~Dram() = default;
     virtual bool running() = 0;
     virtual void cycle() = 0;
     virtual bool is_full(uint32_t cid, MemoryAccess *request) = 0;
@@ -26,6 +27,9 @@ class Dram {
     virtual uint64_t get_avg_pim_cycle() = 0;
     virtual void reset_pim_cycle() = 0;
     virtual void log(Stage stage) = 0;
+    // only between stages, when no request is in flight
+    virtual void save_state(std::ostream &os) = 0;
+    virtual void load_state(std::istream &is) = 0;
 
    protected:
     SimulationConfig _config;
@@ -37,6 +41,7 @@ class Dram {
 class PIM : public Dram {
    public:
     PIM(SimulationConfig config);
+    ~PIM() override;  // writes the interval still open
 
     virtual bool running() override;
     virtual void cycle() override;
@@ -52,13 +57,16 @@ class PIM : public Dram {
     uint64_t EncodePIMHeader(int channel, int row, bool for_gwrite, int num_comps, int num_readres);
     void update_stat(uint32_t cid);
     void log(Stage stage);
+    void save_state(std::ostream &os) override;
+    void load_state(std::istream &is) override;
 
     std::unique_ptr<dramsim3::NewtonSim> _mem;
     std::vector<uint64_t> _total_processed_requests;
     std::vector<uint64_t> _processed_requests;
     int _mem_req_cnt = 0;
     int _burst_cycle;
-    std::vector<std::vector<MemoryIOStat>> _stats;
+    std::vector<MemoryIOStat> _stats;  // current interval of each channel
+    std::vector<Logger::StatSink<MemoryIOStat>> _stat_sinks;
     uint64_t _stat_interval;
 
     // stats
@@ -0,0 +1,98 @@
+#include "EventTrace.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EventTrace {
+thread_local bool enabled = false;
+
+namespace {
+constexpr uint64_t capacity = 1 << 16;  // events, power of two
+
+// one per simulation thread, shared with its writer thread
+struct Trace {
+    std::vector<Event> ring;
+    // the simulator thread only moves head, the writer thread only moves tail
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<bool> running{false};
+    std::thread writer;
+    FILE *file = nullptr;
+};
+thread_local Trace *trace = nullptr;
+
+// write ring[from, to) to file, splitting at the wrap-around point
+void write_range(Trace *t, uint64_t from, uint64_t to) {
+    while (from < to) {
+        uint64_t idx = from & (capacity - 1);
+        uint64_t count = std::min(to - from, capacity - idx);
+        fwrite(&t->ring[idx], sizeof(Event), count, t->file);
+        from += count;
+    }
+}
+
+void drain(Trace *t) {
+    while (true) {
+        // read `running` first so events pushed before close() are never missed
+        bool last = !t->running.load(std::memory_order_acquire);
+        uint64_t tail = t->tail.load(std::memory_order_relaxed);
+        uint64_t head = t->head.load(std::memory_order_acquire);
+        if (head != tail) {
+            write_range(t, tail, head);
+            t->tail.store(head, std::memory_order_release);
+        } else if (last) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+}  // namespace
+
+void open(std::string path) {
+    assert(!enabled);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        spdlog::error("Failed to open event trace {}", path);
+        return;
+    }
+    trace = new Trace();
+    trace->file = file;
+    trace->ring.resize(capacity);
+    trace->running = true;
+    trace->writer = std::thread(drain, trace);
+    enabled = true;
+
+    // the simulation can end with exit() (e.g. on errors), flush what is buffered in that case too
+    static std::once_flag registered;
+    std::call_once(registered, [] { std::atexit(close); });
+    spdlog::info("Event trace: {}", path);
+}
+
+void close() {
+    if (!enabled) return;
+    enabled = false;
+    trace->running.store(false, std::memory_order_release);
+    trace->writer.join();
+    fclose(trace->file);
+    delete trace;
+    trace = nullptr;
+}
+
+// called only from the simulator thread. waits for the writer rather than drop events.
+void push(const Event &event) {
+    uint64_t h = trace->head.load(std::memory_order_relaxed);
+    while (h - trace->tail.load(std::memory_order_acquire) == capacity) std::this_thread::yield();
+    trace->ring[h & (capacity - 1)] = event;
+    trace->head.store(h + 1, std::memory_order_release);
+}
+}  // namespace EventTrace
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Binary event trace for hot paths that used to log at info level.
+ * Events are fixed 32-byte records pushed into a single-producer ring and written to
+ * {log_dir}/events.bin by a background thread, so recording costs a few stores.
+ * Each simulation thread has its own trace.
+ * Records are stored in host byte order:
+ *   uint64 cycle | uint16 type | uint16 unit | uint32 id | uint64 arg0 | uint64 arg1
+ *
+ *   type          unit     id            arg0            arg1
+ *   TileIssue     core     operation_id  batch           stage_platform
+ *   TileFinish    core     operation_id  batch           stage_platform
+ *   StageBegin    -        stage         SA sub-batch    PIM sub-batch   (int64, -1 if none)
+ *   StageEnd      -        stage         -               -
+ *   DramIssue     channel  req_type      dram_address    MemoryAccess*
+ *   DramResponse  channel  req_type      dram_address    MemoryAccess*
+ *   MemIssue      core     req_type      MemoryAccess*   channel
+ *   MemResponse   core     req_type      MemoryAccess*   -
+ *   SAInst        core     opcode        finish_cycle    -
+ *   VectorInst    core     opcode        finish_cycle    vector pipeline
+ * DramIssue/DramResponse are in DRAM cycles, everything else in core cycles.
+ * The MemoryAccess pointer only identifies a request while it is in flight.
+ */
+namespace EventTrace {
+enum class Type : uint16_t {
+    TileIssue,
+    TileFinish,
+    StageBegin,
+    StageEnd,
+    DramIssue,
+    DramResponse,
+    MemIssue,
+    MemResponse,
+    SAInst,
+    VectorInst,
+};
+
+struct Event {
+    uint64_t cycle;
+    Type type;
+    uint16_t unit;
+    uint32_t id;
+    uint64_t arg0;
+    uint64_t arg1;
+};
+static_assert(sizeof(Event) == 32, "EventTrace::Event must stay a 32-byte record");
+
+extern thread_local bool enabled;  // per simulation thread
+
+void open(std::string path);
+void close();
+void push(const Event &event);
+
+inline void record(Type type, uint64_t cycle, uint16_t unit, uint32_t id, uint64_t arg0 = 0,
+                   uint64_t arg1 = 0) {
+    if (!enabled) return;
+    push(Event{cycle, type, unit, id, arg0, arg1});
+}
+}  // namespace EventTrace
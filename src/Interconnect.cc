@@ -7,14 +7,15 @@
 
 namespace fs = std::filesystem;
 
+Interconnect::~Interconnect() {
+    for (size_t i = 0; i < _stats.size(); ++i) _stat_sinks[i].push(_stats[i]);
+}
+
 void Interconnect::log(Stage stage) {
     std::string fname =
         Config::global_config.log_dir + "/memio_stage_" + stageToString(stage) + "_ch_";
-    for (size_t i = 0; i < _stats.size(); ++i) {
-        Logger::log(_stats[i], fname + std::to_string(i));
-        auto last_stat = _stats[i].back();
-        _stats[i].clear();
-        _stats[i].push_back(last_stat);
+    for (size_t i = 0; i < _stat_sinks.size(); ++i) {
+        _stat_sinks[i].rotate(fname + std::to_string(i));
     }
 }
 
@@ -27,14 +28,14 @@ void Interconnect::update_stat(MemoryAccess memory_access, uint64_t ch_idx) {
     // READ, WRITE, GWRITE, COMP, READRES, P_HEADER, COMPS_READRES, SIZE
     switch (memory_access.req_type) {
         case MemoryAccessType::READ:
-            _stats[ch_idx].back().memory_reads += memory_access.size;
+            _stats[ch_idx].memory_reads += memory_access.size;
             break;
         case MemoryAccessType::WRITE:
-            _stats[ch_idx].back().memory_writes += memory_access.size;
+            _stats[ch_idx].memory_writes += memory_access.size;
             break;
         case MemoryAccessType::READRES:
         case MemoryAccessType::COMPS_READRES:
-            _stats[ch_idx].back().pim_reads += memory_access.size;
+            _stats[ch_idx].pim_reads += memory_access.size;
             break;
             // default:
             //     ast(0);
@@ -60,9 +61,10 @@ SimpleInterconnect::SimpleInterconnect(SimulationConfig config) : _latency(confi
     }
     // TODO: make it configurable
     _mem_cycle_interval = 250;
-    _stats.resize(config.dram_channels);
+    _stat_sinks.resize(config.dram_channels);
     for (size_t i = 0; i < config.dram_channels; ++i) {
-        _stats[i].push_back(MemoryIOStat(0, i, _mem_cycle_interval));
+        _stats.push_back(MemoryIOStat(0, i, _mem_cycle_interval));
+        _stat_sinks[i].open(config.log_dir + "/memio_ch_" + std::to_string(i));
     }
 }
 
@@ -108,10 +110,11 @@ void SimpleInterconnect::cycle() {
     }
 
     for (auto ch_idx = 0; ch_idx < _config.dram_channels; ++ch_idx) {
-        if (_stats[ch_idx].back().start_cycle + _mem_cycle_interval < get_core_cycle()) {
-            auto stat = MemoryIOStat((get_core_cycle() / _mem_cycle_interval) * _mem_cycle_interval,
-                                     ch_idx, _mem_cycle_interval);
-            _stats[ch_idx].push_back(stat);
+        if (_stats[ch_idx].start_cycle + _mem_cycle_interval < get_core_cycle()) {
+            _stat_sinks[ch_idx].push(_stats[ch_idx]);
+            _stats[ch_idx] =
+                MemoryIOStat((get_core_cycle() / _mem_cycle_interval) * _mem_cycle_interval,
+                             ch_idx, _mem_cycle_interval);
         }
     }
 
@@ -10,6 +10,7 @@
 
 class Interconnect {
    public:
+    virtual ~Interconnect();  // writes the interval still open
     virtual bool running() = 0;
     virtual void cycle() = 0;
     virtual void push(uint32_t src, uint32_t dest, MemoryAccess *request) = 0;
@@ -35,7 +36,8 @@ class Interconnect {
     uint32_t _n_nodes;
     uint32_t _dram_offset;
     uint64_t _cycles;
-    std::vector<std::vector<MemoryIOStat>> _stats;
+    std::vector<MemoryIOStat> _stats;  // current interval of each channel
+    std::vector<Logger::StatSink<MemoryIOStat>> _stat_sinks;
     MemoryIOStat _stat;
     // this variable is the unit of memory io request counts in core cycles
     // if it is 50, the number of memory io requests are merged in 50 core cycles granularity
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <filesystem>
+
 #include "Common.h"
 
 /**
@@ -24,4 +26,92 @@ void log(std::vector<StatClass> stats, std::string fname) {
     }
     ofile.close();
 }
-};  // namespace Logger
\ No newline at end of file
+
+/**
+ * StatSink streams interval stats to {fname}.tsv (or {fname}.bin) while the simulation runs.
+ * At most stats_buffer_rows rows are kept in memory, and intervals without any activity are
+ * dropped when stats_skip_zero is set (rows keep their StartCycle, so gaps stay visible).
+ * Besides get_columns() and repr(), StatClass needs
+ *   bool is_zero(): no activity in the interval
+ *   static std::vector<std::string> get_fields(): names of the raw counters
+ *   std::vector<uint64_t> get_field_values(): raw counters, in get_fields() order
+ *
+ * stats_format "binary" writes the raw counters column by column:
+ *   char[8] "NPSTAT1" | uint32 num_fields | num_fields '\0'-terminated names
+ *   then per flushed block: uint32 num_rows | num_fields x num_rows uint64 (one column each)
+ */
+template <typename StatClass>
+class StatSink {
+   public:
+    StatSink() = default;
+    StatSink(const StatSink &) = delete;
+    StatSink(StatSink &&) = default;
+    ~StatSink() { close(); }
+
+    void open(std::string fname) {
+        _binary = Config::global_config.stats_format == "binary";
+        _path = fname + (_binary ? ".bin" : ".tsv");
+        _file.open(_path, _binary ? std::ios::binary : std::ios::out);
+        if (!_file.is_open()) {
+            spdlog::error("Failed to open {}", _path);
+            return;
+        }
+        if (_binary) {
+            auto fields = StatClass::get_fields();
+            uint32_t num_fields = fields.size();
+            _file.write("NPSTAT1", 8);
+            _file.write(reinterpret_cast<const char *>(&num_fields), sizeof(num_fields));
+            for (auto &field : fields) _file.write(field.c_str(), field.size() + 1);
+        } else {
+            _file << StatClass::get_columns();
+        }
+    }
+
+    void push(StatClass stat) {
+        if (!_file.is_open()) return;
+        if (Config::global_config.stats_skip_zero && stat.is_zero()) return;
+        _buffer.push_back(stat);
+        if (_buffer.size() >= Config::global_config.stats_buffer_rows) flush();
+    }
+
+    void flush() {
+        if (!_file.is_open() || _buffer.empty()) return;
+        if (_binary) {
+            uint32_t num_rows = _buffer.size();
+            std::vector<std::vector<uint64_t>> rows;
+            for (auto &stat : _buffer) rows.push_back(stat.get_field_values());
+            _file.write(reinterpret_cast<const char *>(&num_rows), sizeof(num_rows));
+            std::vector<uint64_t> column(num_rows);
+            for (size_t field = 0; field < rows[0].size(); field++) {
+                for (size_t row = 0; row < num_rows; row++) column[row] = rows[row][field];
+                _file.write(reinterpret_cast<const char *>(column.data()),
+                            num_rows * sizeof(uint64_t));
+            }
+        } else {
+            for (auto &stat : _buffer) _file << stat.repr();
+        }
+        _file.flush();
+        _buffer.clear();
+    }
+
+    void close() {
+        flush();
+        if (_file.is_open()) _file.close();
+    }
+
+    // Closes the current file as {fname} and continues in a fresh file under the old name
+    void rotate(std::string fname) {
+        if (!_file.is_open()) return;
+        std::string path = _path;
+        close();
+        std::filesystem::rename(path, fname + (_binary ? ".bin" : ".tsv"));
+        open(path.substr(0, path.size() - 4));
+    }
+
+   private:
+    std::ofstream _file;
+    std::string _path;
+    bool _binary = false;
+    std::vector<StatClass> _buffer;
+};
+};  // namespace Logger
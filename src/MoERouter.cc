@@ -0,0 +1,42 @@
+#include "MoERouter.h"
+
+#include <random>
+
+namespace MoERouter {
+std::vector<double> expert_load(const SimulationConfig &config) {
+    uint32_t experts = config.model_n_experts;
+    ast(experts > 0);
+    std::vector<double> load(experts, 1);
+    if (config.moe_routing == "zipf") {
+        for (uint32_t e = 0; e < experts; e++) load[e] = 1 / pow(e + 1, config.moe_zipf_s);
+    } else if (config.moe_routing == "trace") {
+        ast(config.moe_expert_load.size() == experts);
+        load = config.moe_expert_load;
+    }
+    double total = std::accumulate(load.begin(), load.end(), 0.0);
+    ast(total > 0);
+    for (auto &share : load) share /= total;
+    return load;
+}
+
+// weighted sampling without replacement: the experts with the largest u^(1 / share)
+std::vector<uint32_t> route(const SimulationConfig &config, const std::vector<double> &load,
+                            uint64_t request_id, uint64_t position) {
+    uint64_t key = (request_id << 32) | position;
+    std::mt19937_64 gen(config.moe_routing_seed ^ (key * 0x9E3779B97F4A7C15ull));
+    std::uniform_real_distribution<double> u(0, 1);
+
+    std::vector<std::pair<double, uint32_t>> keys;
+    for (uint32_t e = 0; e < load.size(); e++) {
+        double draw = u(gen);
+        if (load[e] > 0) keys.push_back({log(draw) / load[e], e});
+    }
+    uint32_t k = MIN(config.model_n_experts_per_token, (uint32_t)keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + k, keys.end(),
+                      [](auto &a, auto &b) { return a.first > b.first; });
+
+    std::vector<uint32_t> experts;
+    for (uint32_t i = 0; i < k; i++) experts.push_back(keys[i].second);
+    return experts;
+}
+}  // namespace MoERouter
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Common.h"
+
+// Token-to-expert routing of MoE FFN layers (model_n_experts > 0). The simulator carries no
+// activations, so the router's choice is drawn: every expert has a share of the tokens by
+// moe_routing, and a token picks model_n_experts_per_token distinct experts by those shares.
+// The draw is seeded per (request, position), like the stand-in token ids of the embedding,
+// so a token is routed the same way in every run with the same moe_routing_seed.
+namespace MoERouter {
+// share of the tokens of each expert of the model of config, sums to 1
+std::vector<double> expert_load(const SimulationConfig &config);
+// experts of a token, in decreasing gate order
+std::vector<uint32_t> route(const SimulationConfig &config, const std::vector<double> &load,
+                            uint64_t request_id, uint64_t position);
+}  // namespace MoERouter
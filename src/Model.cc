@@ -1,5 +1,7 @@
 #include "Model.h"
 
+#include "allocator/AddressAllocator.h"
+
 namespace BlockType {
 std::string Attention = "attn";
 std::string FeedForward = "ffn";
@@ -11,7 +13,13 @@ std::string QKVGen = "QKVgen";
 std::string Projection = "proj";
 std::string FullyConnected1 = "fc1";
 std::string FullyConnected2 = "fc2";
+std::string Embedding = "wte";
+std::string FinalLayerNorm = "ln_f";
 std::string LmHead = "lmhead";
+std::string Sampling = "sample";
+std::string Router = "router";
+std::string MoEDispatch = "moe_dispatch";
+std::string MoECombine = "moe_combine";
 
 std::string QKVSplit = "QKVsplit";
 std::string QKMatMul = "QKmm";
@@ -33,6 +41,7 @@ std::string Microbench = "Microbench";
 std::string NeuPIMSAttend = "NeuPIMSAttend";
 std::string FusedMHA = "FusedMHA";
 std::string PIMGEMV = "PIMGEMV";
+std::string KVCacheMigrate = "KVmigrate";
 }  // namespace OperationType
 
 namespace ParameterType {
@@ -87,6 +96,24 @@ void Model::init_params() {
                       {_config.model_n_embd});
         create_weight(name_gen(ffn, OperationType::LayerNorm, ParameterType::Bias),
                       {_config.model_n_embd});
+        if (_config.model_n_experts > 0) {
+            // MoE: the router is on every chip, each expert is split like the dense FFN
+            uint32_t ffn_dim = _config.model_expert_ffn_dim / _config.n_tp;
+            create_weight(name_gen(ffn, OperationType::Router, ParameterType::Weight),
+                          {_config.model_n_embd, _config.model_n_experts});
+            create_expert_weights(ffn, OperationType::FullyConnected1,
+                                  {_config.model_n_embd, ffn_dim});
+            create_expert_weights(ffn, OperationType::FullyConnected2,
+                                  {ffn_dim, _config.model_n_embd});
+            for (uint32_t e = 0; e < _config.model_n_experts; e++) {
+                auto expert = name_gen(ffn, EXPERT(e));
+                create_weight(name_gen(expert, OperationType::FullyConnected1, ParameterType::Bias),
+                              {ffn_dim});
+                create_weight(name_gen(expert, OperationType::FullyConnected2, ParameterType::Bias),
+                              {_config.model_n_embd});
+            }
+            continue;
+        }
         create_weight(name_gen(ffn, OperationType::FullyConnected1, ParameterType::Weight),
                       {_config.model_n_embd, 4 * _config.model_n_embd / _config.n_tp});
         create_weight(name_gen(ffn, OperationType::FullyConnected1, ParameterType::Bias),
@@ -96,9 +123,16 @@ void Model::init_params() {
         create_weight(name_gen(ffn, OperationType::FullyConnected2, ParameterType::Bias),
                       {_config.model_n_embd});
     }
+    // embedding table and LM head are split by vocabulary, like QKVgen and fc1 by column
+    create_weight(name_gen(OperationType::Embedding, ParameterType::Weight),
+                  {_config.model_vocab_size / _config.n_tp, _config.model_n_embd});
+    create_weight(name_gen(OperationType::FinalLayerNorm, ParameterType::Weight),
+                  {_config.model_n_embd});
+    create_weight(name_gen(OperationType::FinalLayerNorm, ParameterType::Bias),
+                  {_config.model_n_embd});
     // LM head: both encoder, decoder are GEMV
     create_weight(name_gen(OperationType::LmHead, ParameterType::Weight),
-                  {_config.model_n_embd, _config.model_vocab_size});
+                  {_config.model_n_embd, _config.model_vocab_size / _config.n_tp});
 
     // in advance, caculate weight size to decide base addr of buffer
     _wgt_size = 0;
@@ -119,6 +153,14 @@ std::vector<Ptr<NPUTensor>> Model::get_params(int layer_idx, std::string block_t
     return {wgt, bias};
 }
 
+// weight and, if there is one, bias of an operation outside the layers (e.g. lmhead)
+std::vector<Ptr<NPUTensor>> Model::get_params(std::string operation_type) {
+    Ptr<NPUTensor> wgt = find_tensor(name_gen(operation_type, ParameterType::Weight));
+    auto bias = _wgt_map.find(name_gen(operation_type, ParameterType::Bias));
+    if (bias == _wgt_map.end()) return {wgt};
+    return {wgt, bias->second};
+}
+
 // todo: load from real address (requests)
 std::shared_ptr<Tensor> Model::load_cache(uint32_t layer, std::string type) {
     std::vector<uint32_t> shape;
@@ -153,6 +195,7 @@ void Model::find_executable_node(std::shared_ptr<Tensor> tensor) {
 
 Model::Model(const Model &model) {
     _name = model._name;
+    _config = model._config;
     _root_node_id = _root_node_id;
     _input_tensor = _input_tensor;
 
@@ -168,7 +211,7 @@ Model::Model(const Model &model) {
     }
     for (auto operation : model._executable_operations) {
         _executable_operations.push_back(_operation_map[operation->get_id()]);
-        spdlog::trace("add op {0:x}", fmt::ptr(_executable_operations.front()));
+        SPDLOG_TRACE("add op {0:x}", fmt::ptr(_executable_operations.front()));
     }
 }
 
@@ -204,6 +247,32 @@ std::shared_ptr<NPUTensor> Model::create_weight(std::string name, std::vector<ui
     return tensor;
 }
 
+// The weights of one operation of every expert of a layer. With moe_expert_channels each expert
+// lives on that many channels (see WgtAlloc::allocate_experts), else it is allocated like any
+// weight.
+void Model::create_expert_weights(std::string prefix, std::string operation_type,
+                                  std::vector<uint32_t> dims) {
+    uint32_t experts = _config.model_n_experts;
+    auto name = [&](uint32_t e) {
+        return name_gen(prefix, EXPERT(e), operation_type, ParameterType::Weight);
+    };
+    if (_config.moe_expert_channels == 0) {
+        for (uint32_t e = 0; e < experts; e++) create_weight(name(e), dims);
+        return;
+    }
+
+    std::vector<Ptr<NPUTensor2D>> tensors;
+    for (uint32_t e = 0; e < experts; e++)
+        tensors.push_back(std::make_shared<NPUTensor2D>(dims, NPUTensorBufType::WGT, false));
+    auto placements =
+        WgtAlloc::GetInstance()->allocate_experts(dims[0] * tensors[0]->_row_pitch, experts);
+    for (uint32_t e = 0; e < experts; e++) {
+        tensors[e]->place(placements[e].first, placements[e].second,
+                          _config.moe_expert_channels);
+        _wgt_map[name(e)] = std::make_shared<NPUTensor>(name(e), tensors[e], true);
+    }
+}
+
 // input: operation id
 // erase target operation and insert readied operation.
 void Model::finish_operation(uint32_t id) {
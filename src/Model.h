@@ -8,11 +8,15 @@
 #include "operations/Add.h"
 #include "operations/Attention.h"
 #include "operations/Concat.h"
+#include "operations/Embedding.h"
 #include "operations/FusedMHA.h"
+#include "operations/KVCacheMigrate.h"
 #include "operations/Gelu.h"
 #include "operations/LayerNorm.h"
 #include "operations/MatMul.h"
 #include "operations/Microbench.h"
+#include "operations/MoECombine.h"
+#include "operations/MoEDispatch.h"
 #include "operations/NeuPIMSAttend.h"
 #include "operations/NeuPIMSLogitSoftmax.h"
 #include "operations/Operation.h"
@@ -20,6 +24,7 @@
 #include "operations/PIMGEMVAdd.h"
 #include "operations/PIMGEMVSoftmax.h"
 #include "operations/Reshape.h"
+#include "operations/Sampling.h"
 #include "operations/Softmax.h"
 #include "operations/Split.h"
 #include "operations/SplitDecoding.h"
@@ -28,6 +33,7 @@
 #include "tensor/NPUTensor.h"
 
 #define LAYER(i) ("layer" + std::to_string(i))
+#define EXPERT(i) ("expert" + std::to_string(i))
 
 namespace BlockType {
 extern std::string Attention;
@@ -40,6 +46,13 @@ extern std::string QKVGen;
 extern std::string Projection;
 extern std::string FullyConnected1;
 extern std::string FullyConnected2;
+extern std::string Embedding;
+extern std::string FinalLayerNorm;
+extern std::string LmHead;
+extern std::string Sampling;
+extern std::string Router;
+extern std::string MoEDispatch;
+extern std::string MoECombine;
 extern std::string QKVSplit;
 extern std::string QKMatMul;
 extern std::string SoftMax;
@@ -62,6 +75,7 @@ extern std::string Attention;
 extern std::string NeuPIMSAttend;
 extern std::string FusedMHA;
 extern std::string PIMGEMV;
+extern std::string KVCacheMigrate;
 }  // namespace OperationType
 
 namespace ParameterType {
@@ -78,6 +92,7 @@ class Model {
     Ptr<NPUTensor> find_tensor(std::string name);
     std::vector<Ptr<NPUTensor>> get_params(int layer_idx, std::string block_type,
                                            std::string operation_type);
+    std::vector<Ptr<NPUTensor>> get_params(std::string operation_type);  // outside the layers
 
     std::shared_ptr<Tensor> get_tensor(uint32_t id);
     void add_tensor(std::shared_ptr<Tensor> tensor);
@@ -94,6 +109,8 @@ class Model {
 
     std::shared_ptr<Tensor> create_tensor(std::string name, std::vector<uint32_t> dims);
     std::shared_ptr<NPUTensor> create_weight(std::string name, std::vector<uint32_t> dims);
+    void create_expert_weights(std::string prefix, std::string operation_type,
+                               std::vector<uint32_t> dims);
 
     std::shared_ptr<Operation> create_and_add_gpt_operation(Ops op_type, std::string name);
     std::shared_ptr<Operation> create_and_add_gpt_operation(Ops op_type, std::string name,
@@ -107,6 +124,7 @@ class Model {
     void find_executable_node(std::shared_ptr<Tensor> tensor);
 
     std::string get_name() { return _name; }
+    const SimulationConfig &get_config() { return _config; }
     uint32_t get_id() { return _root_node_id; }
     std::shared_ptr<Tensor> get_input_tensor() { return _input_tensor; }
     std::vector<std::shared_ptr<Operation>> get_executable_operations();
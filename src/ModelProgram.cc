@@ -166,9 +166,9 @@ bool ModelProgram::check_exist_in_executable(uint32_t op_id) {
 void ModelProgram::finish_operation(uint32_t id) {
     _op_map[id]->set_finish();
     for (auto iter = _executable_operations.begin(); iter != _executable_operations.end(); iter++) {
-        spdlog::info("iterating operation: {}", (*iter)->get_name());
+        SPDLOG_TRACE("iterating operation: {}", (*iter)->get_name());
         if (id == (*iter)->get_id()) {
-            spdlog::info("erasing operation: {}", (*iter)->get_name());
+            SPDLOG_DEBUG("erasing operation: {}", (*iter)->get_name());
             _executable_operations.erase(iter);
             break;
         }
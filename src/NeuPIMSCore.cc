@@ -30,6 +30,7 @@ NeuPIMSCore::NeuPIMSCore(uint32_t id, SimulationConfig config)
       _stat_add_cycle(0),
       _stat_gelu_cycle(0),
       _stat_softmax_cycle(0),
+      _vector_unit(config),
       _spad(Sram(config, _core_cycle, false)),
       _acc_spad(Sram(config, _core_cycle, true)),
       _pim_spad(Sram(config, _core_cycle, false)),
@@ -86,7 +87,9 @@ bool NeuPIMSCore::can_issue(Tile &next_tile) {
 // switch tiles to shared ptr
 // todo: check tile start cycle
 void NeuPIMSCore::issue(Tile &in_tile) {
-    spdlog::info("tile issued {}", in_tile.repr());
+    SPDLOG_DEBUG("tile issued {}", in_tile.repr());
+    EventTrace::record(EventTrace::Type::TileIssue, _core_cycle, _id, in_tile.operation_id,
+                       in_tile.batch, static_cast<uint64_t>(in_tile.stage_platform));
     auto tile = std::make_shared<Tile>(in_tile);
     tile->stat = TileStat(_core_cycle);
     if (tile->skip) {
@@ -168,7 +171,9 @@ void NeuPIMSCore::issue(Tile &in_tile) {
 }
 
 void NeuPIMSCore::issue_pim(Tile &in_tile) {
-    spdlog::info("pim tile issued {}", in_tile.repr());
+    SPDLOG_DEBUG("pim tile issued {}", in_tile.repr());
+    EventTrace::record(EventTrace::Type::TileIssue, _core_cycle, _id, in_tile.operation_id,
+                       in_tile.batch, static_cast<uint64_t>(in_tile.stage_platform));
     auto tile = std::make_shared<Tile>(in_tile);
     tile->stat = TileStat(_core_cycle);
     if (tile->skip) {
@@ -324,16 +329,25 @@ bool NeuPIMSCore::running() {
 // push into target channel memory request queue
 void NeuPIMSCore::push_memory_request1(MemoryAccess *request) {
     int channel = AddressConfig::mask_channel(request->dram_address);
+    EventTrace::record(EventTrace::Type::MemIssue, _core_cycle, _id,
+                       static_cast<uint32_t>(request->req_type),
+                       reinterpret_cast<uint64_t>(request), channel);
     _memory_request_queues1[channel].push(request);
 }
 
 void NeuPIMSCore::push_memory_request2(MemoryAccess *request) {
     int channel = AddressConfig::mask_channel(request->dram_address);
+    EventTrace::record(EventTrace::Type::MemIssue, _core_cycle, _id,
+                       static_cast<uint32_t>(request->req_type),
+                       reinterpret_cast<uint64_t>(request), channel);
     _memory_request_queues2[channel].push(request);
 }
 
 void NeuPIMSCore::push_memory_response(MemoryAccess *response) {
     assert(!response->request);  // can only push response
+    EventTrace::record(EventTrace::Type::MemResponse, _core_cycle, _id,
+                       static_cast<uint32_t>(response->req_type),
+                       reinterpret_cast<uint64_t>(response));
 
     Sram *acc_spad = &_acc_spad;
     Sram *spad = &_spad;
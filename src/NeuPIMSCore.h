@@ -8,6 +8,7 @@
 #include "SimulationConfig.h"
 #include "Sram.h"
 #include "Stat.h"
+#include "VectorUnit.h"
 
 class NeuPIMSCore {
    public:
@@ -53,6 +54,8 @@ class NeuPIMSCore {
     virtual void pim_push_memory_response(MemoryAccess *response);
     virtual void print_stats();
     virtual cycle_type get_compute_cycles() { return _stat_compute_cycle; }
+    cycle_type get_cycle() { return _core_cycle; }
+    void set_cycle(cycle_type cycle) { _core_cycle = cycle; }  // restoring a checkpoint
 
    protected:
     virtual bool can_issue_compute(Instruction &inst);
@@ -97,7 +100,8 @@ class NeuPIMSCore {
     std::queue<std::shared_ptr<Tile>> _finished_tiles;
 
     std::queue<Instruction> _compute_pipeline;
-    std::vector<std::queue<Instruction>> _vector_pipelines;
+    VectorUnit _vector_unit;
+    std::vector<std::deque<Instruction>> _vector_pipelines;  // per vector core
 
     // SA Sub-batch queue
     std::queue<Instruction> _ld_inst_queue_for_sa;
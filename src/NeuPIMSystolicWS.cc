@@ -1,19 +1,19 @@
 #include "NeuPIMSystolicWS.h"
 
 NeuPIMSystolicWS::NeuPIMSystolicWS(uint32_t id, SimulationConfig config) : NeuPIMSCore(id, config) {
-    auto stat = NPUStat(_core_cycle);
-    _stat.push_back(stat);
+    _stat = NPUStat(_core_cycle);
+    _stat_sink.open(config.log_dir + "/npu_utilization_core_" + std::to_string(id));
 }
 
 void NeuPIMSystolicWS::log() {
-    std::string fname = Config::global_config.log_dir + "/npu_utilization";
-    Logger::log(_stat, fname);
+    _stat_sink.push(_stat);
+    _stat_sink.close();
 }
 
 void NeuPIMSystolicWS::cycle() {
-    if (_stat.back().start_cycle + 1000 < _core_cycle) {
-        auto stat = NPUStat(_core_cycle);
-        _stat.push_back(stat);
+    if (_stat.start_cycle + 1000 < _core_cycle) {
+        _stat_sink.push(_stat);
+        _stat = NPUStat(_core_cycle);
     }
     // compute in SA, VU
     systolic_cycle();
@@ -67,9 +67,14 @@ void NeuPIMSystolicWS::vector_unit_cycle() {
     */
     // vector pipeline needs iterating vectors
     // todo: vector_unit.cycle();
+    // instructions on different lanes of a vector core may finish out of order
     for (auto &vector_pipeline : _vector_pipelines) {
-        if (!vector_pipeline.empty() && vector_pipeline.front().finish_cycle <= _core_cycle) {
-            Instruction &inst = vector_pipeline.front();
+        for (auto it = vector_pipeline.begin(); it != vector_pipeline.end();) {
+            if (it->finish_cycle > _core_cycle) {
+                it++;
+                continue;
+            }
+            Instruction &inst = *it;
             Sram *buffer = inst.is_pim_inst ? &_pim_acc_spad : &_acc_spad;
             if (inst.dest_addr >= ACCUM_SPAD_BASE) {
                 buffer->fill(inst.dest_addr, inst.accum_spad_id);
@@ -82,7 +87,7 @@ void NeuPIMSystolicWS::vector_unit_cycle() {
             } else {
                 assert(0);
             }
-            vector_pipeline.pop();
+            it = vector_pipeline.erase(it);
         }
     }
 }
@@ -303,7 +308,7 @@ void NeuPIMSystolicWS::update_stats() {
             assert(0);
         }
         parent_tile->stat.compute_cycles++;
-        _stat.back().num_calculations += 128 * 8 * 2;  // apply systolic array count
+        _stat.num_calculations += 128 * 8 * 2;  // apply systolic array count
     }
     for (auto &vector_pipeline : _vector_pipelines) {
         if (!vector_pipeline.empty()) {
@@ -312,7 +317,7 @@ void NeuPIMSystolicWS::update_stats() {
                 assert(0);
             }
             parent_tile->stat.compute_cycles++;
-            _stat.back().num_calculations += 16;  // apply systolic array count
+            _stat.num_calculations += 16;  // apply systolic array count
         }
     }
 
@@ -353,6 +358,7 @@ void NeuPIMSystolicWS::update_stats() {
         // } else if (!_vector_pipeline.empty()) {
         // when element in vector pipeline
         for (auto &vector_pipeline : _vector_pipelines) {
+            if (vector_pipeline.empty()) continue;
             switch (vector_pipeline.front().opcode) {
                 case Opcode::LAYERNORM:
                     _stat_layernorm_cycle++;
@@ -379,46 +385,11 @@ cycle_type NeuPIMSystolicWS::get_inst_compute_cycles(Instruction &inst) {
     return _config.core_height + _config.core_width - 2 + MAX(inst.size, 4);
 }
 
-cycle_type NeuPIMSystolicWS::get_vector_compute_cycles(Instruction &inst) {
-    cycle_type vec_op_iter = calculate_vector_op_iterations(inst.size);
-    cycle_type add_tree_iter = calculate_add_tree_iterations(inst.size);
-    cycle_type add_tree, scalar_ops, vector_ops;
-    switch (inst.opcode) {
-        case Opcode::LAYERNORM:
-            add_tree = 2 * add_tree_iter * _config.add_tree_latency;
-            scalar_ops = 2 * _config.scalar_mul_latency + _config.scalar_sqrt_latency;
-            // 1 addition, 1 subtraction, 1 division, 2 multiplication.
-            vector_ops = vec_op_iter * (2 * _config.add_latency + 3 * _config.mul_latency);
-            return add_tree + scalar_ops + vector_ops;
-        case Opcode::SOFTMAX:
-            // 1 add tree, 1 compare tree
-            add_tree = 2 * add_tree_iter * _config.add_tree_latency;
-            vector_ops =
-                vec_op_iter * (_config.add_latency + _config.exp_latency + _config.mul_latency);
-            return add_tree + vector_ops;
-        case Opcode::ADD:
-            return vec_op_iter * _config.add_latency;
-        case Opcode::GELU:
-            return vec_op_iter * _config.gelu_latency;
-        case Opcode::DUMMY:
-            return 1;
-    }
-    spdlog::info("not configured operation. {}", inst.id);
-    // assert(0);
-    return 0;
-}
-
-cycle_type NeuPIMSystolicWS::calculate_add_tree_iterations(uint32_t vector_size) {
-    uint32_t calculation_unit = _config.vector_core_width;
-    if (vector_size <= calculation_unit) {
-        return 1;
-    }
-
-    uint32_t ret = vector_size / calculation_unit;
-    if (vector_size % calculation_unit != 0) {
-        ret++;
-    }
-    return ret + calculate_add_tree_iterations(ret);
+void NeuPIMSystolicWS::issue_vector_inst(Instruction &inst) {
+    uint32_t unit = _vector_unit.issue(inst, _core_cycle);
+    _vector_pipelines[unit].push_back(inst);
+    EventTrace::record(EventTrace::Type::VectorInst, inst.start_cycle, _id,
+                       static_cast<uint32_t>(inst.opcode), inst.finish_cycle, unit);
 }
 
 void NeuPIMSystolicWS::issue_ex_inst(Instruction inst) {
@@ -457,41 +428,18 @@ void NeuPIMSystolicWS::issue_ex_inst(Instruction inst) {
         }
 
         inst.finish_cycle = inst.start_cycle + get_inst_compute_cycles(inst);
+        EventTrace::record(EventTrace::Type::SAInst, inst.start_cycle, _id,
+                           static_cast<uint32_t>(inst.opcode), inst.finish_cycle);
         // spdlog::info("finish_cycle: {}", inst.finish_cycle);
         _compute_pipeline.push(inst);
         _stat_systolic_inst_issue_count++;
     } else if (inst.opcode == Opcode::COMP || inst.opcode == Opcode::IM2COL ||
                inst.opcode == Opcode::LAYERNORM || inst.opcode == Opcode::SOFTMAX ||
                inst.opcode == Opcode::ADD || inst.opcode == Opcode::GELU ||
-               inst.opcode == Opcode::DUMMY) {  // vector unit compute
-        // spdlog::info("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
-        std::queue<Instruction> *least_filled_vpu;
-        cycle_type finish_cycle = std::numeric_limits<uint64_t>::max();
-        for (auto &vector_pipeline : _vector_pipelines) {
-            if (vector_pipeline.empty()) {
-                least_filled_vpu = &vector_pipeline;
-                finish_cycle = _core_cycle;
-                break;
-            }
-            if (vector_pipeline.back().finish_cycle < finish_cycle) {
-                least_filled_vpu = &vector_pipeline;
-                finish_cycle = _core_cycle;
-            }
-        }
-        inst.start_cycle = finish_cycle;
-        inst.finish_cycle = inst.start_cycle + get_vector_compute_cycles(inst);
-        least_filled_vpu->push(inst);
-
-        {
-            // if (!_vector_pipeline.empty()) {
-            //     // loading latency
-            //     inst.start_cycle = _vector_pipeline.back().finish_cycle + 1;
-            // } else {
-            //     inst.start_cycle = _core_cycle;
-            // }
-            // inst.finish_cycle = inst.start_cycle + get_vector_compute_cycles(inst);
-            // _vector_pipeline.push(inst);
-        }
+               inst.opcode == Opcode::DUMMY || inst.opcode == Opcode::SAMPLE ||
+               inst.opcode == Opcode::DEQUANT_WGT ||
+               inst.opcode == Opcode::DEQUANT_KV) {  // vector unit compute
+        issue_vector_inst(inst);
     }
 
     // if dest_addr is on sram, count up. -> wait for _compute_pipeline to
@@ -510,21 +458,13 @@ void NeuPIMSystolicWS::issue_ex_inst(Instruction inst) {
     }
 }
 
-cycle_type NeuPIMSystolicWS::calculate_vector_op_iterations(uint32_t vector_size) {
-    uint32_t calculation_unit = _config.vector_core_width;
-    uint32_t ret = vector_size / calculation_unit;
-    if (vector_size % calculation_unit != 0) {
-        ret++;
-    }
-    return ret;
-}
-
 void NeuPIMSystolicWS::print_stats() {
     NeuPIMSCore::print_stats();
     spdlog::info("NeuPIMSCore [{}] : Systolic Inst Issue Count : {}", _id,
                  _stat_systolic_inst_issue_count);
     spdlog::info("NeuPIMSCore [{}] : Systolic PRELOAD Issue Count : {}", _id,
                  _stat_systolic_preload_issue_count);
+    _vector_unit.print_stats(_id, _core_cycle);
 }
 
 void NeuPIMSystolicWS::pim_issue_ex_inst(Instruction inst) {
@@ -565,41 +505,18 @@ void NeuPIMSystolicWS::pim_issue_ex_inst(Instruction inst) {
         }
 
         inst.finish_cycle = inst.start_cycle + get_inst_compute_cycles(inst);
+        EventTrace::record(EventTrace::Type::SAInst, inst.start_cycle, _id,
+                           static_cast<uint32_t>(inst.opcode), inst.finish_cycle);
         // spdlog::info("finish_cycle: {}", inst.finish_cycle);
         _compute_pipeline.push(inst);
         _stat_systolic_inst_issue_count++;
     } else if (inst.opcode == Opcode::COMP || inst.opcode == Opcode::IM2COL ||
                inst.opcode == Opcode::LAYERNORM || inst.opcode == Opcode::SOFTMAX ||
                inst.opcode == Opcode::ADD || inst.opcode == Opcode::GELU ||
-               inst.opcode == Opcode::DUMMY) {  // vector unit compute
-        // spdlog::info("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
-        std::queue<Instruction> *least_filled_vpu;
-        cycle_type finish_cycle = std::numeric_limits<uint64_t>::max();
-        for (auto &vector_pipeline : _vector_pipelines) {
-            if (vector_pipeline.empty()) {
-                least_filled_vpu = &vector_pipeline;
-                finish_cycle = _core_cycle;
-                break;
-            }
-            if (vector_pipeline.back().finish_cycle < finish_cycle) {
-                least_filled_vpu = &vector_pipeline;
-                finish_cycle = _core_cycle;
-            }
-        }
-        inst.start_cycle = finish_cycle;
-        inst.finish_cycle = inst.start_cycle + get_vector_compute_cycles(inst);
-        least_filled_vpu->push(inst);
-
-        {
-            // if (!_vector_pipeline.empty()) {
-            //     // loading latency
-            //     inst.start_cycle = _vector_pipeline.back().finish_cycle + 1;
-            // } else {
-            //     inst.start_cycle = _core_cycle;
-            // }
-            // inst.finish_cycle = inst.start_cycle + get_vector_compute_cycles(inst);
-            // _vector_pipeline.push(inst);
-        }
+               inst.opcode == Opcode::DUMMY || inst.opcode == Opcode::SAMPLE ||
+               inst.opcode == Opcode::DEQUANT_WGT ||
+               inst.opcode == Opcode::DEQUANT_KV) {  // vector unit compute
+        issue_vector_inst(inst);
     }
 
     // if dest_addr is on sram, count up. -> wait for _compute_pipeline to
@@ -0,0 +1,164 @@
+#include "PrefillPool.h"
+
+#include "scheduler/PrefixCache.h"
+#include "tensor/PIMTensor.h"
+
+PrefillPool::PrefillPool(SimulationConfig config) : _config(config) {
+    ast(config.prefill_devices > 0);
+
+    // the prefill devices share the memory and models of the decode device, not its NPU
+    SimulationConfig device = config;
+    if (!config.prefill_config.empty()) {
+        SimulationConfig npu = initialize_config(load_config(config.prefill_config));
+        device.num_cores = npu.num_cores;
+        device.core_freq = npu.core_freq;
+        device.core_width = npu.core_width;
+        device.core_height = npu.core_height;
+        device.spad_size = npu.spad_size;
+    }
+    for (uint32_t m = 0; m < config.models.size(); m++)
+        _cost_models.push_back(std::make_unique<AnalyticalModel>(model_config_of(device, m)));
+    _to_core = (double)config.core_freq / device.core_freq;
+
+    // GB/s over MHz, us times MHz
+    _link_bytes_per_cycle = config.kv_link_bandwidth * 1e9 / (config.core_freq * 1e6);
+    _link_latency = config.kv_link_latency * config.core_freq;
+
+    _device_free_cycles.resize(config.prefill_devices, 0);
+    _device_busy_cycles.resize(config.prefill_devices, 0);
+    _device_prefixes.resize(config.prefill_devices);
+    _next_device = 0;
+    _link_free_cycle = 0;
+    _prefilled_requests = 0;
+    _finished_requests = 0;
+    _queue_cycles = 0;
+    _prefill_cycles = 0;
+    _cached_tokens = 0;
+    _transfer_cycles = 0;
+    _link_busy_cycles = 0;
+    _link_bytes = 0;
+
+    spdlog::info("Prefill pool: {} devices of {} {}x{} cores at {} MHz, {} router",
+                 config.prefill_devices, device.num_cores, device.core_height, device.core_width,
+                 device.core_freq, config.prefill_router);
+}
+
+uint32_t PrefillPool::route(Ptr<InferRequest> request) {
+    if (_config.prefix_caching && PrefixCache::prefix_tokens(request) > 0) {
+        int best = -1;
+        uint32_t best_tokens = 0;
+        for (uint32_t device = 0; device < _device_prefixes.size(); device++) {
+            auto &prefixes = _device_prefixes[device];
+            auto it = prefixes.find({request->model, request->prefix_id});
+            if (it != prefixes.end() && it->second > best_tokens) {
+                best = device;
+                best_tokens = it->second;
+            }
+        }
+        if (best >= 0) return best;
+    }
+    // the device that is free the earliest, the lower index on ties
+    if (_config.prefill_router == "least_loaded")
+        return std::min_element(_device_free_cycles.begin(), _device_free_cycles.end()) -
+               _device_free_cycles.begin();
+    uint32_t device = _next_device;
+    _next_device = (_next_device + 1) % _device_free_cycles.size();
+    return device;
+}
+
+void PrefillPool::add_request(Ptr<InferRequest> request, cycle_type cycle) {
+    assert(request->generated == 0);
+    ast(request->model < _cost_models.size());
+    uint32_t device = route(request);
+    cycle_type start = MAX(cycle, _device_free_cycles[device]);
+    uint32_t cached = 0;
+    if (_config.prefix_caching) {
+        uint32_t tokens = PrefixCache::prefix_tokens(request);
+        uint32_t &prefilled = _device_prefixes[device][{request->model, request->prefix_id}];
+        cached = MIN(tokens, prefilled);
+        prefilled = MAX(tokens, prefilled);
+    }
+    cycle_type cycles =
+        _cost_models[request->model]->prefill_cycles(request->input_size - cached) * _to_core;
+    cycles = MAX(cycles, 1);
+    _device_free_cycles[device] = start + cycles;
+    _device_busy_cycles[device] += cycles;
+
+    _prefilled_requests++;
+    _queue_cycles += start - cycle;
+    _prefill_cycles += cycles;
+    _cached_tokens += cached;
+
+    request->generated = 1;
+    request->first_token_cycle = start + cycles;
+    _prefilled.insert({start + cycles, request});
+}
+
+// Requests that are added later start at their arrival, so every prefill that completes by
+// `cycle` is known and the link can take them in completion order.
+void PrefillPool::transfer(cycle_type cycle) {
+    while (!_prefilled.empty() && _prefilled.begin()->first <= cycle) {
+        auto [done, request] = *_prefilled.begin();
+        _prefilled.erase(_prefilled.begin());
+        if (request->generated == request->output_size) {
+            _finished_requests++;
+            _arrived.insert({done, request});
+            continue;
+        }
+
+        uint64_t bytes = kv_bytes(request);
+        cycle_type start = MAX(done, _link_free_cycle);
+        cycle_type busy = ceil(bytes / _link_bytes_per_cycle);
+        _link_free_cycle = start + busy;
+        cycle_type arrival = _link_free_cycle + _link_latency;
+
+        _link_busy_cycles += busy;
+        _link_bytes += bytes;
+        _transfer_cycles += arrival - done;
+        request->kv_remote = true;
+        _arrived.insert({arrival, request});
+    }
+}
+
+bool PrefillPool::has_request(cycle_type cycle) {
+    transfer(cycle);
+    return !_arrived.empty() && _arrived.begin()->first <= cycle;
+}
+
+Ptr<InferRequest> PrefillPool::pop_request() {
+    assert(!_arrived.empty());
+    auto request = _arrived.begin()->second;
+    _arrived.erase(_arrived.begin());
+    return request;
+}
+
+// the K and V rows of the request on the decode device (a PIM row spans all banks of the
+// channel), for every layer
+uint64_t PrefillPool::kv_bytes(Ptr<InferRequest> request) {
+    auto &model = _config.models[request->model];
+    uint32_t E = model["model_n_embd"];
+    uint32_t n_layer = model["model_n_layer"];
+    uint32_t seq_len = request->input_size + request->generated;
+    uint64_t rows = PIMTensor::get_num_rows(PIMTensorKVType::KEY, seq_len, E) +
+                    PIMTensor::get_num_rows(PIMTensorKVType::VALUE, seq_len, E);
+    return rows * _config.dram_banks_per_ch * _config.dram_page_size * n_layer;
+}
+
+void PrefillPool::print_stat(cycle_type cycles) {
+    uint32_t transferred = _prefilled_requests - _finished_requests;
+    spdlog::info("Prefill pool : {} requests ({} finished on the prefill device), mean queueing "
+                 "{} cycles, mean prefill {} cycles",
+                 _prefilled_requests, _finished_requests,
+                 _prefilled_requests > 0 ? _queue_cycles / _prefilled_requests : 0,
+                 _prefilled_requests > 0 ? _prefill_cycles / _prefilled_requests : 0);
+    if (_config.prefix_caching)
+        spdlog::info("Prefill pool : {} prompt tokens skipped by cached prefixes", _cached_tokens);
+    spdlog::info("KV link : {} requests, {} bytes, mean transfer {} cycles, utilization {:.2f}%",
+                 transferred, _link_bytes, transferred > 0 ? _transfer_cycles / transferred : 0,
+                 cycles > 0 ? 100.0 * _link_busy_cycles / cycles : 0);
+    for (uint32_t device = 0; device < _device_busy_cycles.size(); device++) {
+        spdlog::info("Prefill device [{}] : busy {} cycles, utilization {:.2f}%", device,
+                     _device_busy_cycles[device],
+                     cycles > 0 ? 100.0 * _device_busy_cycles[device] / cycles : 0);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "AnalyticalModel.h"
+#include "Common.h"
+
+/**
+ * PrefillPool models the prefill devices of a disaggregated deployment (prefill_devices), in
+ * front of the simulated decode device.
+ *   route:    a new request goes to a prefill device by prefill_router
+ *   prefill:  each device prefills one prompt at a time, timed by AnalyticalModel with the
+ *             prefill_config NPU config; the prefill produces the first token
+ *   prefix:   with prefix_caching, a device keeps the KV cache of the prefixes it prefilled
+ *             (in its own HBM, not bounded) and skips their tokens; a request goes to the
+ *             device with the longest prefix of its prefix_id before prefill_router is asked
+ *   transfer: the KV cache of the prompt, sized as the PIMTensor rows it takes on the decode
+ *             device, crosses the KV link (kv_link_bandwidth, kv_link_latency) one request at
+ *             a time in prefill completion order
+ * All cycles are decode core cycles. A request leaves the pool with generated = 1 and
+ * kv_remote set once its KV cache has arrived; Scheduler writes it into the PIM rows it
+ * allocates at admission.
+ */
+class PrefillPool {
+   public:
+    PrefillPool(SimulationConfig config);
+
+    void add_request(Ptr<InferRequest> request, cycle_type cycle);
+    bool has_request(cycle_type cycle);  // a request has arrived at the decode device by cycle
+    Ptr<InferRequest> pop_request();
+    void print_stat(cycle_type cycles);
+
+   private:
+    SimulationConfig _config;  // decode device
+    std::vector<std::unique_ptr<AnalyticalModel>> _cost_models;  // per model, prefill device
+    double _to_core;              // decode core cycles per prefill device cycle
+    double _link_bytes_per_cycle;
+    cycle_type _link_latency;
+
+    std::vector<cycle_type> _device_free_cycles;
+    uint32_t _next_device;  // round_robin
+    cycle_type _link_free_cycle;
+    std::multimap<cycle_type, Ptr<InferRequest>> _prefilled;  // by prefill completion
+    std::multimap<cycle_type, Ptr<InferRequest>> _arrived;    // by arrival at the decode device
+    // per device, (model, prefix_id) -> prefix tokens prefilled
+    std::vector<std::map<std::pair<uint32_t, uint64_t>, uint32_t>> _device_prefixes;
+
+    uint32_t _prefilled_requests;
+    uint32_t _finished_requests;  // one output token, nothing to transfer
+    cycle_type _queue_cycles;
+    cycle_type _prefill_cycles;
+    uint64_t _cached_tokens;  // prompt tokens of cached prefixes, not prefilled
+    cycle_type _transfer_cycles;  // prefill completion to arrival, link queueing included
+    cycle_type _link_busy_cycles;
+    uint64_t _link_bytes;
+    std::vector<cycle_type> _device_busy_cycles;
+
+    uint32_t route(Ptr<InferRequest> request);
+    void transfer(cycle_type cycle);
+    uint64_t kv_bytes(Ptr<InferRequest> request);
+};
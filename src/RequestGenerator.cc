@@ -1,55 +1,330 @@
 #include "RequestGenerator.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string_view>
+
 namespace RequestGenerator {
-uint32_t answer_index;
-uint32_t row_index;
-std::vector<std::string> columns;
-std::vector<std::vector<uint32_t>> table;
+namespace {
+enum class Field {
+    ARRIVAL,
+    INPUT,
+    OUTPUT,
+    CHANNEL,
+    PREFIX,
+    PREFIX_LEN,
+    PRIORITY,
+    TENANT,
+    TTFT_SLO,
+    TPOT_SLO,
+    MODEL,
+    SIZE
+};
 
-void init(std::string path, uint32_t _answer_index) {
-    row_index = 0;
+// column names (or JSONL keys) of each field, in Field order
+const std::vector<std::vector<std::string>> aliases = {
+    {"arrival", "timestamp"},
+    {"input_len", "seq_len", "input_toks", "input_tokens"},
+    {"output_len", "output_toks", "output_tokens"},
+    {"channel", "ch_idx"},
+    {"prefix_id", "session_id"},
+    {"prefix_len", "prefix_tokens"},
+    {"priority"},
+    {"tenant", "tenant_id", "user"},
+    {"ttft_slo"},
+    {"tpot_slo"},
+    {"model", "model_id"},
+};
 
-    // todo
-    // initialize answer_index depending on the file type
-    answer_index = _answer_index;
+struct MappedFile {
+    const char *data = nullptr;
+    size_t size = 0;
+    ~MappedFile() {
+        if (data != nullptr) munmap(const_cast<char *>(data), size);
+    }
+};
 
-    parse(path);
-    spdlog::info("parsed {} lines from file {}", table.size(), path);
+std::shared_ptr<const MappedFile> map_file(std::string path) {
+    auto file = std::make_shared<MappedFile>();
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        spdlog::error("Failed to open request trace {}", path);
+        exit(EXIT_FAILURE);
+    }
+    file->size = st.st_size;
+    if (file->size > 0) {
+        void *data = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            spdlog::error("Failed to map request trace {}", path);
+            exit(EXIT_FAILURE);
+        }
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        file->data = static_cast<const char *>(data);
+    }
+    close(fd);
+    return file;
 }
-int get_total_req_cnt() { return table.size(); }
 
-bool has_data() { return row_index < table.size(); }
-
-std::pair<uint32_t, uint32_t> get_qa_length() {
-    ast(has_data());
-    auto row = table[row_index++];
-    return std::make_pair(row[0], row[answer_index]);
+// numeric ids are kept, other ids (e.g. session strings) are hashed
+uint64_t parse_id(std::string_view cell) {
+    if (cell.empty()) return 0;
+    bool numeric = std::all_of(cell.begin(), cell.end(), [](char c) { return isdigit(c); });
+    return numeric ? std::stoull(std::string(cell)) : std::hash<std::string_view>()(cell);
 }
 
-void parse(std::string path) {
-    std::ifstream input_file(path);
-    if (!input_file.is_open()) {
-        std::cout << path << std::endl;
-        assert(0);
+class Source {
+   public:
+    virtual ~Source() = default;
+    virtual bool has_data() = 0;
+    virtual TraceRequest next() = 0;
+    virtual uint64_t size() = 0;
+};
+
+// streams the rows of a mapped .csv/.tsv/.jsonl file
+class TraceFile : public Source {
+   public:
+    TraceFile(std::string path, std::shared_ptr<const MappedFile> file)
+        : _path(path), _file(file), _pos(file->data), _end(file->data + file->size) {
+        _columns.fill(-1);
+        _rows = 0;
+        for (const char *p = _pos; p < _end;) {
+            const char *eol = static_cast<const char *>(memchr(p, '\n', _end - p));
+            if (eol == nullptr) eol = _end;
+            if (eol > p && !(eol == p + 1 && *p == '\r')) _rows++;
+            p = eol + 1;
+        }
+
+        skip_blank_lines();
+        if (_pos == _end) {
+            spdlog::error("Request trace {} is empty", _path);
+            exit(EXIT_FAILURE);
+        }
+        _jsonl = *_pos == '{';
+        if (_jsonl) return;
+
+        // header
+        std::string_view header = next_line();
+        _rows--;
+        _delimiter = header.find('\t') != std::string_view::npos ? '\t' : ',';
+        auto names = split(header);
+        for (int field = 0; field < static_cast<int>(Field::SIZE); field++) {
+            for (size_t col = 0; col < names.size(); col++) {
+                auto &candidates = aliases[field];
+                if (std::find(candidates.begin(), candidates.end(), names[col]) !=
+                    candidates.end()) {
+                    _columns[field] = static_cast<int>(col);
+                    break;
+                }
+            }
+        }
+        if (_columns[static_cast<int>(Field::INPUT)] < 0) {
+            spdlog::error("Request trace {} has no input length column ({})", _path,
+                          fmt::join(aliases[static_cast<int>(Field::INPUT)], ", "));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bool has_data() override {
+        skip_blank_lines();
+        return _pos < _end;
     }
 
-    std::string line;
-    if (std::getline(input_file, line)) {
-        std::istringstream iss(line);
-        std::string column_name;
-        while (std::getline(iss, column_name, ',')) {
-            columns.push_back(column_name);
+    TraceRequest next() override {
+        ast(has_data());
+        std::string_view line = next_line();
+        TraceRequest request{.arrival = 0,
+                             .input_size = 0,
+                             .output_size = 1,
+                             .channel = -1,
+                             .prefix_id = 0,
+                             .prefix_len = 0,
+                             .priority = 0,
+                             .tenant = 0,
+                             .ttft_slo = 0,
+                             .tpot_slo = 0,
+                             .model = 0};
+        if (_jsonl) {
+            json row = json::parse(line);
+            auto find = [&](Field field) -> json * {
+                for (auto &key : aliases[static_cast<int>(field)])
+                    if (row.contains(key)) return &row[key];
+                return nullptr;
+            };
+            if (auto value = find(Field::ARRIVAL)) request.arrival = *value;
+            if (auto value = find(Field::INPUT)) request.input_size = *value;
+            if (auto value = find(Field::OUTPUT)) request.output_size = *value;
+            if (auto value = find(Field::CHANNEL)) request.channel = *value;
+            if (auto value = find(Field::PREFIX))
+                request.prefix_id = value->is_string() ? parse_id(value->get<std::string>())
+                                                       : value->get<uint64_t>();
+            if (auto value = find(Field::PREFIX_LEN)) request.prefix_len = *value;
+            if (auto value = find(Field::PRIORITY)) request.priority = *value;
+            if (auto value = find(Field::TENANT))
+                request.tenant = value->is_string() ? parse_id(value->get<std::string>())
+                                                    : value->get<uint64_t>();
+            if (auto value = find(Field::TTFT_SLO)) request.ttft_slo = *value;
+            if (auto value = find(Field::TPOT_SLO)) request.tpot_slo = *value;
+            if (auto value = find(Field::MODEL)) request.model = *value;
+        } else {
+            auto cells = split(line);
+            auto cell = [&](Field field) -> std::string_view {
+                int col = _columns[static_cast<int>(field)];
+                return col >= 0 && col < (int)cells.size() ? cells[col] : std::string_view();
+            };
+            auto number = [](std::string_view cell) { return std::stoull(std::string(cell)); };
+            if (!cell(Field::ARRIVAL).empty())
+                request.arrival = std::stod(std::string(cell(Field::ARRIVAL)));
+            request.input_size = number(cell(Field::INPUT));
+            if (!cell(Field::OUTPUT).empty()) request.output_size = number(cell(Field::OUTPUT));
+            if (!cell(Field::CHANNEL).empty()) request.channel = number(cell(Field::CHANNEL));
+            request.prefix_id = parse_id(cell(Field::PREFIX));
+            if (!cell(Field::PREFIX_LEN).empty())
+                request.prefix_len = number(cell(Field::PREFIX_LEN));
+            if (!cell(Field::PRIORITY).empty()) request.priority = number(cell(Field::PRIORITY));
+            request.tenant = parse_id(cell(Field::TENANT));
+            if (!cell(Field::TTFT_SLO).empty())
+                request.ttft_slo = std::stod(std::string(cell(Field::TTFT_SLO)));
+            if (!cell(Field::TPOT_SLO).empty())
+                request.tpot_slo = std::stod(std::string(cell(Field::TPOT_SLO)));
+            if (!cell(Field::MODEL).empty()) request.model = number(cell(Field::MODEL));
         }
+        return request;
     }
 
-    while (std::getline(input_file, line)) {
-        std::vector<uint32_t> buffer;
-        std::istringstream iss(line);
-        std::string cell;
-        while (std::getline(iss, cell, ',')) {
-            buffer.push_back(std::stoul(cell));
+    uint64_t size() override { return _rows; }
+
+   private:
+    std::string _path;
+    std::shared_ptr<const MappedFile> _file;
+    const char *_pos;
+    const char *_end;
+    uint64_t _rows;  // requests, i.e. non-empty lines without the header
+    bool _jsonl;
+    char _delimiter;
+    std::array<int, static_cast<int>(Field::SIZE)> _columns;  // -1 if the trace lacks it
+
+    void skip_blank_lines() {
+        while (_pos < _end && (*_pos == '\n' || *_pos == '\r')) _pos++;
+    }
+
+    std::string_view next_line() {
+        const char *eol = static_cast<const char *>(memchr(_pos, '\n', _end - _pos));
+        if (eol == nullptr) eol = _end;
+        std::string_view line(_pos, eol - _pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        _pos = eol < _end ? eol + 1 : _end;
+        return line;
+    }
+
+    std::vector<std::string_view> split(std::string_view line) {
+        std::vector<std::string_view> cells;
+        size_t start = 0;
+        while (true) {
+            size_t pos = line.find(_delimiter, start);
+            cells.push_back(line.substr(start, pos - start));
+            if (pos == std::string_view::npos) break;
+            start = pos + 1;
+        }
+        return cells;
+    }
+};
+
+// trace_sampler_requests requests drawn uniformly from the rows of a stats table with
+// trace_sampler_seed, with Poisson arrivals at trace_sampler_rate
+class SampledTrace : public Source {
+   public:
+    SampledTrace(const std::vector<std::pair<uint32_t, uint32_t>> &table,
+                 const SimulationConfig &config) {
+        ast(!table.empty());
+        std::mt19937_64 gen(config.trace_sampler_seed);
+        std::uniform_int_distribution<size_t> row(0, table.size() - 1);
+        std::exponential_distribution<double> gap(config.trace_sampler_rate > 0
+                                                      ? config.trace_sampler_rate
+                                                      : 1);
+        double arrival = 0;
+        for (uint32_t i = 0; i < config.trace_sampler_requests; i++) {
+            auto [input_size, output_size] = table[row(gen)];
+            if (config.trace_sampler_rate > 0 && i > 0) arrival += gap(gen);
+            _requests.push_back(TraceRequest{.arrival = arrival,
+                                             .input_size = input_size,
+                                             .output_size = output_size,
+                                             .channel = -1,
+                                             .prefix_id = 0,
+                                             .prefix_len = 0,
+                                             .priority = 0,
+                                             .tenant = 0,
+                                             .ttft_slo = 0,
+                                             .tpot_slo = 0,
+                                             .model = 0});
+        }
+        _next = 0;
+    }
+
+    bool has_data() override { return _next < _requests.size(); }
+    TraceRequest next() override {
+        ast(has_data());
+        return _requests[_next++];
+    }
+    uint64_t size() override { return _requests.size(); }
+
+   private:
+    std::vector<TraceRequest> _requests;
+    size_t _next;
+};
+
+using StatsTable = std::vector<std::pair<uint32_t, uint32_t>>;  // (input, output) tokens
+std::mutex cache_mutex;
+std::map<std::string, std::shared_ptr<const MappedFile>> files;    // path -> mapping
+std::map<std::string, std::shared_ptr<const StatsTable>> tables;  // path -> stats table
+
+std::shared_ptr<const MappedFile> get_file(std::string path) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (files.find(path) == files.end()) files[path] = map_file(path);
+    return files[path];
+}
+
+// rows without output tokens are left out, like trace-generator/get_distributions.py
+std::shared_ptr<const StatsTable> get_table(std::string path) {
+    auto file = get_file(path);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (tables.find(path) == tables.end()) {
+        auto table = std::make_shared<StatsTable>();
+        TraceFile rows(path, file);
+        while (rows.has_data()) {
+            auto row = rows.next();
+            if (row.output_size > 0) table->push_back({row.input_size, row.output_size});
         }
-        table.push_back(buffer);
+        tables[path] = table;
+    }
+    return tables[path];
+}
+
+thread_local std::unique_ptr<Source> source;
+}  // namespace
+
+void init(std::string path) {
+    auto &config = Config::global_config;
+    if (!config.trace_sampler_stats.empty()) {
+        auto table = get_table(config.trace_sampler_stats);
+        source = std::make_unique<SampledTrace>(*table, config);
+        spdlog::info("sampled {} requests from {} (seed {})", source->size(),
+                     config.trace_sampler_stats, config.trace_sampler_seed);
+    } else {
+        source = std::make_unique<TraceFile>(path, get_file(path));
+        spdlog::info("{} requests in trace {}", source->size(), path);
     }
 }
-}  // namespace RequestGenerator
\ No newline at end of file
+
+bool has_data() { return source->has_data(); }
+
+TraceRequest next() { return source->next(); }
+
+uint64_t get_total_req_cnt() { return source->size(); }
+}  // namespace RequestGenerator
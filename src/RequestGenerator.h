@@ -1,14 +1,29 @@
 #include "Common.h"
 
+// Reads the requests of a trace in arrival order, one request per row.
+//   .csv / .tsv: a header names the columns, see the aliases in RequestGenerator.cc
+//   .jsonl:      one object per line with the same keys
+// Trace files are memory-mapped and parsed as requests are taken. With trace_sampler_stats set,
+// requests are drawn from an input_toks/output_toks table (trace-generator/*/stats.tsv)
+// instead. The cursor is per thread (see Sweep.h); mapped files and tables are shared by all
+// threads of the process.
 namespace RequestGenerator {
-extern uint32_t answer_index;
-extern uint32_t row_index;
-extern std::vector<std::string> columns;
-extern std::vector<std::vector<uint32_t>> table;
+typedef struct {
+    double arrival;        // seconds from the start of the trace
+    uint32_t input_size;   // prompt tokens
+    uint32_t output_size;  // tokens to generate
+    int channel;           // PIM channel, -1 if the scheduler picks one
+    uint64_t prefix_id;    // prefix or session the prompt shares, 0 if none
+    uint32_t prefix_len;   // prompt tokens of the prefix, 0 = the whole prompt
+    uint32_t priority;     // higher is more urgent
+    uint64_t tenant;       // user or application the request is billed to, 0 if none
+    double ttft_slo;       // seconds to the first token, 0 = slo_ttft
+    double tpot_slo;       // seconds per output token after the first, 0 = slo_tpot
+    uint32_t model;        // index in the models list
+} TraceRequest;
 
-void init(std::string path, uint32_t _answer_index);
+void init(std::string path);
 bool has_data();
-std::pair<uint32_t, uint32_t> get_qa_length();
-int get_total_req_cnt();
-void parse(std::string path);
+TraceRequest next();
+uint64_t get_total_req_cnt();
 }  // namespace RequestGenerator
@@ -24,11 +24,59 @@ struct SimulationConfig {
     uint32_t model_n_layer;
     uint32_t model_n_head;
     uint32_t model_n_embd;
+    uint32_t model_n_experts = 0;        // MoE FFN experts, 0 = dense FFN
+    uint32_t model_n_experts_per_token;  // top-k
+    uint32_t model_expert_ffn_dim;       // hidden size of an expert
+    json models;  // configs of the co-located models, models[0] is the model above
 
     /* Custom Config */
     RunMode run_mode;  // NPU
     bool sub_batch_mode;
+    uint32_t num_sub_batches = 2;  // 2 if sub_batch_mode is on, 1 (newton) if off
     bool ch_load_balancing;
+    bool kv_migration = false;            // migrate KV cache between PIM channels on load skew
+    double kv_migration_threshold = 0.1;  // (max - min) / max channel load to trigger migration
+    bool event_trace = false;             // write {log_dir}/events.bin (see EventTrace.h)
+    bool chrome_trace = false;            // also convert it to {log_dir}/trace.json
+    std::string stats_format = "tsv";     // interval stats: tsv or binary (see Logger.h)
+    bool stats_skip_zero = true;          // drop intervals without any activity
+    uint32_t stats_buffer_rows = 4096;    // rows buffered per stats file before a write
+    std::string checkpoint_stage = "";    // save the state before this stage starts
+    uint32_t checkpoint_iteration = 0;    // in this scheduler iteration
+    std::string restore_checkpoint = "";  // resume from this checkpoint file
+    uint32_t sampling_detailed_iters = 0;  // detailed iterations per cluster, 0: no sampling
+    uint32_t sampling_seq_bin = 1024;      // KV tokens per channel histogram bin
+    uint32_t sampling_batch_bin = 16;      // batch size bin
+    std::string analytical_model = "off";  // off, only or validate (see AnalyticalModel.h)
+    std::string trace_sampler_stats;       // stats table to sample requests from, "" = trace
+    uint32_t trace_sampler_requests = 1000;
+    uint64_t trace_sampler_seed = 0;
+    double trace_sampler_rate = 0;         // requests per second, 0 = all arrive at once
+    uint32_t decode_top_k = 50;            // 0 = whole vocabulary, 1 = greedy
+    double decode_top_p = 1;               // nucleus mass kept, 1 = off
+    std::string preemption = "recompute";  // recompute or swap (see Scheduler::preempt_request)
+    std::string preemption_victim = "lru";  // lru or priority
+    double swap_bandwidth = 32;            // host link GB/s
+    double swap_space = 64;                // host memory for swapped KV caches in GB
+    double slo_ttft = 1;                   // seconds, for requests without ttft_slo
+    double slo_tpot = 0.1;                 // seconds, for requests without tpot_slo
+    double sjf_prediction_error = 0;       // sigma of the log output length prediction error
+    std::string kv_partition = "shared";   // KV rows of a channel between models: shared or static
+    uint32_t prefill_devices = 0;          // disaggregated prefill devices, 0 = none
+    std::string prefill_config = "";       // NPU config of the prefill devices, "" = this one's
+    std::string prefill_router = "round_robin";  // round_robin or least_loaded
+    double kv_link_bandwidth = 50;         // prefill to decode KV cache link GB/s
+    double kv_link_latency = 5;            // us
+    std::string weight_dtype = "";         // fp16, fp8, int8 or int4, "" = precision
+    std::string kv_dtype = "";             // of the PIM KV cache, like weight_dtype
+    uint32_t weight_bits;                  // per element, from weight_dtype
+    uint32_t kv_bits;
+    std::string moe_routing = "uniform";   // token-to-expert distribution: uniform, zipf or trace
+    double moe_zipf_s = 1;                 // expert i is picked in proportion to 1 / (i + 1)^s
+    std::vector<double> moe_expert_load;   // tokens per expert, from moe_routing_trace
+    uint64_t moe_routing_seed = 0;
+    uint32_t moe_expert_channels = 0;      // channels an expert's weights live on, 0 = all
+    bool prefix_caching = false;           // share the KV rows of prompt prefixes (PrefixCache.h)
     bool kernel_fusion;
     uint32_t max_batch_size;
     uint32_t max_active_reqs;  // max size of (ready_queue + running_queue) in scheduler
@@ -47,6 +95,7 @@ struct SimulationConfig {
 
     uint32_t vector_core_count;
     uint32_t vector_core_width;
+    cycle_type vector_initiation_interval = 1;  // cycles between issues to a vector lane
 
     /* Vector config*/
     uint32_t process_bit;
@@ -73,12 +122,17 @@ struct SimulationConfig {
     uint32_t dram_freq;
     uint32_t dram_channels;
     uint32_t dram_req_size;
+    std::string dram_address_mapping = "rorabgbachco";  // MSB first, as in pim_config_path
+    std::string dram_interleave = "cacheline";          // cacheline, row or a bit order
+    bool dram_bank_xor_hash = false;
+    bool weight_striping = false;  // rotate weight rows over the channels
 
     /* PIM config */
     std::string pim_config_path;
     uint32_t dram_page_size;  // DRAM row buffer size (in bytes)
     uint32_t dram_banks_per_ch;
     uint32_t pim_comp_coverage;  // # params per PIM_COMP command
+    bool pim_calibration = false;  // fit scheduler PIM latencies on NewtonSim at startup
 
     /* Log config */
     std::string operation_log_output_path;
@@ -107,5 +161,6 @@ struct SimulationConfig {
 };
 
 namespace Config {
-extern SimulationConfig global_config;
+// per thread, so that simulations can run side by side in one process (see Sweep.h)
+extern thread_local SimulationConfig global_config;
 }
\ No newline at end of file
@@ -1,11 +1,16 @@
 #include "Simulator.h"
 
 #include <filesystem>
+#include <sstream>
 #include <string>
 
+#include "AnalyticalModel.h"
+#include "ChromeTrace.h"
 #include "NeuPIMSystolicWS.h"
 #include "SystolicOS.h"
 #include "SystolicWS.h"
+#include "allocator/AddressAllocator.h"
+#include "operations/Operation.h"
 #include "scheduler/NeuPIMScheduler.h"
 #include "scheduler/OrcaScheduler.h"
 
@@ -44,10 +49,11 @@ Simulator::Simulator(SimulationConfig config) : _config(config), _core_cycles(0)
         _cores[core_index] = std::make_unique<NeuPIMSystolicWS>(core_index, _config);
     }
 
-    if (config.scheduler_type == "simple") {
-        _scheduler = std::make_unique<OrcaScheduler>(_config, &_core_cycles);
-    } else if (config.scheduler_type == "neupims") {
+    // fcfs, sjf, edf and fair are admission policies of the simple scheduler (AdmissionPolicy.h)
+    if (config.scheduler_type == "neupims") {
         _scheduler = std::make_unique<NeuPIMScheduler>(_config, &_core_cycles);
+    } else {
+        _scheduler = std::make_unique<OrcaScheduler>(_config, &_core_cycles);
     }
 
     // } else if (config.scheduler_type == "time_multiplex") {
@@ -57,12 +63,16 @@ Simulator::Simulator(SimulationConfig config) : _config(config), _core_cycles(0)
     // }
 
     _client = std::make_unique<Client>(_config);
+    if (config.prefill_devices > 0) _prefill_pool = std::make_unique<PrefillPool>(config);
 }
 
 void Simulator::run(std::string model_name) {
     spdlog::info("======Start Simulation=====");
-    _scheduler->launch(_model);
+    if (_config.event_trace || _config.chrome_trace)
+        EventTrace::open(_config.log_dir + "/events.bin");
+    for (auto &model : _models) _scheduler->launch(model);
     spdlog::info("assign model {}", model_name);
+    if (!_config.restore_checkpoint.empty()) restore_checkpoint();
     cycle();
 }
 
@@ -73,10 +83,82 @@ void Simulator::update_stage_stat() {
     _stage_stats.push_back(StageStat{.stage = done_stage,
                                      .done_cycle = _core_cycles,
                                      .pim_cycles = _dram->get_avg_pim_cycle(),
+                                     .estimated_pim_cycles =
+                                         _scheduler->get_prev_stage_estimated_pim_cycles(),
                                      .npu_cycles = 0,
                                      .mem_bw_util = _dram->get_avg_bw_util()});
 }
 
+bool Simulator::drained() {
+    for (auto &core : _cores)
+        if (core->running()) return false;
+    return !_icnt->running() && !_dram->running();
+}
+
+// Scheduler, request and KV cache state plus clocks and DRAM state. Cores, interconnect and
+// DRAM hold no request at this point, so nothing in flight has to be saved.
+void Simulator::save_checkpoint() {
+    json state;
+    state["core_cycles"] = _core_cycles;
+    state["core_time"] = _core_time;
+    state["dram_time"] = _dram_time;
+    state["icnt_time"] = _icnt_time;
+    for (auto &core : _cores) state["core_cycle"].push_back(core->get_cycle());
+    for (auto &stat : _stage_stats) {
+        state["stage_stats"].push_back({{"stage", static_cast<int>(stat.stage)},
+                                        {"done_cycle", stat.done_cycle},
+                                        {"pim_cycles", stat.pim_cycles},
+                                        {"estimated_pim_cycles", stat.estimated_pim_cycles},
+                                        {"npu_cycles", stat.npu_cycles},
+                                        {"mem_bw_util", stat.mem_bw_util}});
+    }
+    state["scheduler"] = _scheduler->checkpoint();
+    state["client"] = _client->checkpoint();
+    std::stringstream dram;
+    _dram->save_state(dram);
+    state["dram"] = dram.str();
+
+    std::string fname = fmt::format("{}/checkpoint_{}_{}.json", _config.log_dir,
+                                    _config.checkpoint_stage, _config.checkpoint_iteration);
+    std::ofstream ofile(fname);
+    if (!ofile.is_open()) {
+        spdlog::error("Failed to open {}", fname);
+        exit(EXIT_FAILURE);
+    }
+    ofile << state;
+    spdlog::info("Checkpoint: {} (cycle {})", fname, _core_cycles);
+}
+
+void Simulator::restore_checkpoint() {
+    std::ifstream ifile(_config.restore_checkpoint);
+    if (!ifile.is_open()) {
+        spdlog::error("Failed to open checkpoint {}", _config.restore_checkpoint);
+        exit(EXIT_FAILURE);
+    }
+    json state = json::parse(ifile);
+
+    _core_cycles = state["core_cycles"];
+    _core_time = state["core_time"];
+    _dram_time = state["dram_time"];
+    _icnt_time = state["icnt_time"];
+    for (int core_id = 0; core_id < _n_cores; core_id++)
+        _cores[core_id]->set_cycle(state["core_cycle"][core_id]);
+    _stage_stats.clear();
+    for (auto &stat : state["stage_stats"]) {
+        _stage_stats.push_back(StageStat{.stage = static_cast<Stage>(stat["stage"].get<int>()),
+                                         .done_cycle = stat["done_cycle"],
+                                         .pim_cycles = stat["pim_cycles"],
+                                         .estimated_pim_cycles = stat["estimated_pim_cycles"],
+                                         .npu_cycles = stat["npu_cycles"],
+                                         .mem_bw_util = stat["mem_bw_util"]});
+    }
+    _scheduler->restore(state["scheduler"]);
+    _client->restore(state["client"]);
+    std::stringstream dram(state["dram"].get<std::string>());
+    _dram->load_state(dram);
+    spdlog::info("Restored {} (cycle {})", _config.restore_checkpoint, _core_cycles);
+}
+
 void Simulator::log_stage_stat() {
     std::string fname = Config::global_config.log_dir + "/_summary.tsv";
     std::ofstream ofile(fname);
@@ -88,20 +170,29 @@ void Simulator::log_stage_stat() {
     header += "Stage\t";
     header += "total_cycles\t";
     header += "pim_cycles\t";
+    header += "est_pim_cycles\t";
+    header += "est_pim_error\t";
     header += "mem_bw_util\t";
     ofile << header + "\n";
 
-    int prev_cycle = 0;
+    uint64_t prev_cycle = 0;
 
     for (int i = 0; i < _stage_stats.size(); i++) {
         StageStat stage_stat = _stage_stats[i];
         std::string stage_row = "";
 
-        int total_cycle = stage_stat.done_cycle - prev_cycle;
+        uint64_t total_cycle = stage_stat.done_cycle - prev_cycle;
         prev_cycle = stage_stat.done_cycle;
         stage_row += stageToString(stage_stat.stage) + "\t";
         stage_row += std::to_string(total_cycle) + "\t";
         stage_row += std::to_string(stage_stat.pim_cycles) + "\t";
+        stage_row += std::to_string(stage_stat.estimated_pim_cycles) + "\t";
+        // relative error of the estimator against NewtonSim
+        double est_error = 0;
+        if (stage_stat.pim_cycles > 0)
+            est_error = ((double)stage_stat.estimated_pim_cycles - stage_stat.pim_cycles) /
+                        stage_stat.pim_cycles;
+        stage_row += std::to_string(est_error) + "\t";
         stage_row += std::to_string(stage_stat.mem_bw_util) + "\t";
 
         ofile << stage_row + "\n";
@@ -122,7 +213,18 @@ void Simulator::cycle() {
         if (_cycle_mask & CORE_MASK) {
             while (_client->has_request()) {  // FIXME: change while to if
                 std::shared_ptr<InferRequest> infer_request = _client->pop_request();
-                _scheduler->add_request(infer_request);
+                if (_prefill_pool)
+                    _prefill_pool->add_request(infer_request, _core_cycles);
+                else
+                    _scheduler->add_request(infer_request);
+            }
+            // prefilled requests whose KV cache has arrived, single-token ones are done
+            while (_prefill_pool && _prefill_pool->has_request(_core_cycles)) {
+                std::shared_ptr<InferRequest> request = _prefill_pool->pop_request();
+                if (request->generated == request->output_size)
+                    _client->receive_response(request);
+                else
+                    _scheduler->add_request(request);
             }
             _client->cycle();
 
@@ -136,7 +238,17 @@ void Simulator::cycle() {
                 // _icnt->log(_scheduler->get_prev_stage());
                 update_stage_stat();
             }
-            _scheduler->cycle();
+            // the initial stage has no stage change: it starts once requests are queued
+            if (!_checkpoint_saved && _scheduler->stage_ready() &&
+                _scheduler->get_iterations() == _config.checkpoint_iteration &&
+                stageToString(_scheduler->get_stage()) == _config.checkpoint_stage)
+                _checkpoint_pending = true;
+            if (_checkpoint_pending && drained()) {
+                save_checkpoint();
+                _checkpoint_pending = false;
+                _checkpoint_saved = true;
+            }
+            if (!_checkpoint_pending) _scheduler->cycle();
 
             for (int core_id = 0; core_id < _n_cores; core_id++) {
                 auto finished_tile = _cores[core_id]->pop_finished_tile();
@@ -253,12 +365,29 @@ void Simulator::cycle() {
     // _icnt->log();
     _dram->print_stat();
     _scheduler->print_stat();
+    if (_prefill_pool) _prefill_pool->print_stat(_core_cycles);
     log_stage_stat();
+    EventTrace::close();
+    if (_config.chrome_trace)
+        ChromeTrace::convert(_config.log_dir + "/events.bin", _config.log_dir + "/trace.json",
+                             _config);
 }
 
-void Simulator::launch_model(Ptr<Model> model) { _model = model; }
+void Simulator::launch_model(Ptr<Model> model) { _models.push_back(model); }
+
+std::vector<cycle_type> Simulator::get_stage_cycles() {
+    std::vector<cycle_type> stage_cycles;
+    cycle_type prev_cycle = 0;
+    for (auto &stage_stat : _stage_stats) {
+        stage_cycles.push_back(stage_stat.done_cycle - prev_cycle);
+        prev_cycle = stage_stat.done_cycle;
+    }
+    return stage_cycles;
+}
 
 bool Simulator::running() {
+    // the run ends once every request came back
+    if (!_client->running()) return false;
     bool running = false;
 
     for (auto &core : _cores) {
@@ -306,4 +435,52 @@ uint32_t Simulator::get_dest_node(MemoryAccess *access) {
         // MemoryAccess after it is pushed into dram
         return access->core_id * _n_memories + _dram->get_channel_id(access);
     }
-}
\ No newline at end of file
+}
+
+void run_simulation() {
+    AddressConfig::init(Config::global_config);
+    spdlog::info("DRAM address alignment {}", AddressConfig::alignment);
+    Operation::initialize(Config::global_config);
+
+    std::string analytical_model = Config::global_config.analytical_model;
+    if (analytical_model == "only") {
+        AnalyticalModel model(Config::global_config);
+        model.log(model.run(), Config::global_config.log_dir + "/_analytical");
+        return;
+    }
+
+    {
+        auto simulator = std::make_unique<Simulator>(Config::global_config);
+
+        // the weights of all co-located models are allocated one after another
+        std::vector<Ptr<Model>> models;
+        std::vector<std::string> model_names;
+        for (uint32_t m = 0; m < Config::global_config.models.size(); m++) {
+            SimulationConfig model_config = model_config_of(Config::global_config, m);
+            spdlog::info("model name: {}", model_config.model_name);
+            models.push_back(std::make_shared<Model>(model_config, model_config.model_name));
+            model_names.push_back(model_config.model_name);
+        }
+        std::string model_name = fmt::format("{}", fmt::join(model_names, ", "));
+
+        /* Allocator initialization after weight allocating */
+        ActAlloc::GetInstance()->init(WgtAlloc::GetInstance()->get_next_aligned_addr());
+        KVCacheAlloc::GetInstance()->init(ActAlloc::GetInstance()->get_next_aligned_addr());
+
+        printf("Launching model\n");
+        for (auto &model : models) simulator->launch_model(model);
+        spdlog::info("Launch model: {}", model_name);
+        simulator->run(model_name);
+
+        if (analytical_model == "validate") {
+            AnalyticalModel analytical(Config::global_config);
+            analytical.log(analytical.run(), Config::global_config.log_dir + "/_analytical",
+                           simulator->get_stage_cycles());
+        }
+    }
+
+    MemoryAccess::log_count();
+    WgtAlloc::Delete();
+    ActAlloc::Delete();
+    KVCacheAlloc::Delete();
+}
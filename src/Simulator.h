@@ -6,6 +6,7 @@
 #include "Interconnect.h"
 #include "Model.h"
 #include "NeuPIMSCore.h"
+#include "PrefillPool.h"
 #include "client/Client.h"
 #include "scheduler/Scheduler.h"
 
@@ -16,9 +17,10 @@
 class Simulator {
    public:
     Simulator(SimulationConfig config);
-    void launch_model(Ptr<Model> model);
+    void launch_model(Ptr<Model> model);  // once per co-located model, in models order
     void run(std::string model_name);
     addr_type get_addr_align() { return _dram->get_addr_align(); }
+    std::vector<cycle_type> get_stage_cycles();  // cycles of each finished stage, in order
     // void run_offline(std::string model_name, uint32_t sample_count);
     // void run_multistream(std::string model_name, uint32_t sample_count,
     // uint32_t ); void run_server(std::string trace_path);
@@ -29,6 +31,9 @@ class Simulator {
     uint32_t get_dest_node(MemoryAccess *access);
     void update_stage_stat();
     void log_stage_stat();
+    bool drained();  // no tile or memory request anywhere
+    void save_checkpoint();
+    void restore_checkpoint();
     SimulationConfig _config;
     uint32_t _n_cores;
     uint32_t _n_memories;
@@ -39,6 +44,7 @@ class Simulator {
     std::unique_ptr<Dram> _dram;
     std::unique_ptr<Scheduler> _scheduler;
     std::unique_ptr<Client> _client;
+    std::unique_ptr<PrefillPool> _prefill_pool;  // prefill_devices > 0
 
     // period information (us)
     double _core_period;
@@ -55,15 +61,23 @@ class Simulator {
 
     uint32_t _cycle_mask;
     bool _single_run;
-    Ptr<Model> _model;
+    std::vector<Ptr<Model>> _models;
 
     struct StageStat {
         Stage stage;
-        uint32_t done_cycle;
-        uint32_t pim_cycles;
-        uint32_t npu_cycles;
+        uint64_t done_cycle;
+        uint64_t pim_cycles;
+        uint64_t estimated_pim_cycles;  // from the scheduler's MHA latency estimator
+        cycle_type npu_cycles;
         double mem_bw_util;
     };
 
     std::vector<StageStat> _stage_stats;
-};
\ No newline at end of file
+
+    // checkpoint_stage is about to start; the scheduler waits until drained()
+    bool _checkpoint_pending = false;
+    bool _checkpoint_saved = false;  // only the first match of the stage and iteration is saved
+};
+
+// Builds and runs one simulation from Config::global_config of the calling thread
+void run_simulation();
@@ -80,7 +80,7 @@ void Sram::fill(addr_type address, int buffer_id) {
     //              _cache_table[buffer_id][address].remain_req_count);
     if (_cache_table[buffer_id][address].remain_req_count == 0) {
         _cache_table[buffer_id][address].valid = true;
-        spdlog::trace("MAKE valid {} {}F", buffer_id, address);
+        SPDLOG_TRACE("MAKE valid {} {}F", buffer_id, address);
     }
 }
 
@@ -91,7 +91,7 @@ void Sram::count_up(addr_type address, int buffer_id) {
     // _cache_table[buffer_id][address].remain_req_count);
     if (_cache_table[buffer_id][address].valid) {
         _cache_table[buffer_id][address].valid = false;
-        spdlog::trace("MAKE valid {} {}F", buffer_id, address);
+        SPDLOG_TRACE("MAKE valid {} {}F", buffer_id, address);
     }
 }
 
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "Common.h"
+#include "MoERouter.h"
 #include "Model.h"
 #include "SimulationConfig.h"
 #include "Stat.h"
@@ -15,12 +16,14 @@
 #include "tensor/PIMTensor.h"
 
 StageProgram::StageProgram(Ptr<Model> model, Ptr<BatchedRequest> batched_request,
-                           StagePlatform stage_platform, Stage stage)
-    : _model(model),
+                           StagePlatform stage_platform, Stage stage,
+                           std::vector<KVMigration> kv_migrations)
+    : _name(stagePlatformToString(stage_platform) + "_stage_" + stageToString(stage)),
+      _model(model),
       _breq(batched_request),
       _stage_platform(stage_platform),
       _stage(stage),
-      _name(stagePlatformToString(stage_platform) + "_stage_" + stageToString(stage)) {
+      _kv_migrations(kv_migrations) {
     this->init_program();
 }
 
@@ -29,6 +32,8 @@ StageProgram::StageProgram(Ptr<Model> model, Ptr<BatchedRequest> batched_request
 // |  SA | QKVgen#1 | QKVgen#2 | Pj/FFNs/QKVgen#1 | Pj/FFNs/QKVgen#2 | Pj/FFNs#1 | Pj/FFNs#2 |
 // | PIM |     -    |  MHA#1   | MHA#2            | MHA#1            |   MHA#2   |     -     |
 //
+// A sub-batch starts with the embedding gather in its first SA stage (A, B) and ends with
+// LayerNorm, LM head and sampling in its last one (E, F).
 void StageProgram::init_program() {
     assert(_stage != Stage::Finish);
 
@@ -51,31 +56,57 @@ void StageProgram::init_program() {
         init_SA_program();
 }
 
-bool StageProgram::skip_pim_stage() { return _stage == Stage::A || _stage == Stage::F; }
-
-bool StageProgram::enable_proj_ffns() {
-    return _stage == Stage::C || _stage == Stage::D || _stage == Stage::E || _stage == Stage::F;
+bool StageProgram::skip_pim_stage() {
+    uint32_t stage_idx = static_cast<int>(_stage);
+    return stage_idx == 0 || stage_idx > 2 * stagePeriod();
 }
 
+bool StageProgram::enable_proj_ffns() { return static_cast<uint32_t>(_stage) >= stagePeriod(); }
+
 bool StageProgram::enable_qkv_gen() {
-    return _stage == Stage::A || _stage == Stage::B || _stage == Stage::C || _stage == Stage::D;
+    return static_cast<uint32_t>(_stage) < 2 * stagePeriod();
+}
+
+bool StageProgram::enable_embedding() { return static_cast<uint32_t>(_stage) < stagePeriod(); }
+
+bool StageProgram::enable_lm_head() {
+    return static_cast<uint32_t>(_stage) >= 2 * stagePeriod();
 }
 
 void StageProgram::init_SA_program() {
     spdlog::info(">>> Initialize SystolicArray Stage Model Program <<<");
     auto N = _breq->get_num_rows();
-    auto E = Config::global_config.model_n_embd;
+    auto E = _model->get_config().model_n_embd;
 
     bool lets_proj_ffns = enable_proj_ffns();
     bool lets_qkvgen = enable_qkv_gen();
+    bool lets_embedding = enable_embedding();
+    bool lets_lm_head = enable_lm_head();
 
     std::vector<uint32_t> input_dim{N, E};
     if (lets_proj_ffns) {
-        input_dim[1] /= Config::global_config.n_tp;
+        input_dim[1] /= _model->get_config().n_tp;
+    }
+    if (lets_embedding) {
+        input_dim[1] = 1;  // token ids
     }
     auto input = std::make_shared<NPUTensor>("input", input_dim, NPUTensorBufType::ACT, true);
     std::vector<Ptr<BTensor>> inputs{input};
 
+    if (!_kv_migrations.empty()) {
+        // issued before the SA blocks below, so the copy is charged to this stage's SA time
+        kv_migration_block(inputs);
+    }
+
+    if (lets_embedding) {
+        // >>> Stage: A/B : token embedding
+        inputs = embedding_block(inputs);
+        std::string yellow = "\033[1;33m";
+        std::string reset = "\033[0m";
+        spdlog::info("{}SA : Embedding{}", yellow, reset);
+        // <<< Stage: A/B
+    }
+
     if (lets_proj_ffns) {
         // >>> Stage: C/D/E/F : Projection + FFN1 + FFN2
         inputs = projection_block(inputs);
@@ -86,6 +117,15 @@ void StageProgram::init_SA_program() {
         // <<< Stage: C/D/E/F
     }
 
+    if (lets_lm_head) {
+        // >>> Stage: E/F : LayerNorm + LM head + sampling
+        inputs = lm_head_block(inputs);
+        std::string yellow = "\033[1;33m";
+        std::string reset = "\033[0m";
+        spdlog::info("{}SA : LM head + Sampling{}", yellow, reset);
+        // <<< Stage: E/F
+    }
+
     if (lets_qkvgen) {
         // >>> Stage: A/B/C/D : QKVGen
         inputs = qkv_gen_block(inputs);
@@ -109,8 +149,9 @@ void StageProgram::init_PIM_program() {
 
     int sub_batch_size = _breq->_reqs.size();
 
-    uint32_t num_heads = Config::global_config.model_n_head / Config::global_config.n_tp;
-    uint32_t dk = Config::global_config.model_n_embd / Config::global_config.model_n_head;  // 64;
+    auto &config = _model->get_config();
+    uint32_t num_heads = config.model_n_head / config.n_tp;
+    uint32_t dk = config.model_n_embd / config.model_n_head;  // 64;
 
     std::vector<Ptr<BTensor>> querys;
     std::vector<Ptr<BTensor>> keys;
@@ -150,6 +191,17 @@ void StageProgram::init_PIM_program() {
     find_executable_node(query);
 }
 
+void StageProgram::kv_migration_block(std::vector<Ptr<BTensor>> inputs) {
+    auto migrate = add_op(std::make_shared<KVCacheMigrate>(
+        name_gen(LAYER(0), BlockType::Attention, OperationType::KVCacheMigrate), _kv_migrations));
+    get_outputs(migrate, inputs);
+
+    std::string yellow = "\033[1;33m";
+    std::string reset = "\033[0m";
+    spdlog::info("{}SA : KV cache migration ({} requests){}", yellow, _kv_migrations.size(),
+                 reset);
+}
+
 Ptr<Operation> StageProgram::add_op(std::shared_ptr<Operation> op) {
     // spdlog::info("operation {} added. add_op", op->get_name());
     _op_map[op->get_id()] = op;
@@ -232,7 +284,7 @@ void StageProgram::log() {
 
 std::vector<Ptr<BTensor>> StageProgram::projection_block(std::vector<Ptr<BTensor>> inputs) {
     auto N = _breq->get_num_rows();
-    auto E = Config::global_config.model_n_embd;
+    auto E = _model->get_config().model_n_embd;
 
     std::vector<uint32_t> input_dim{N, E};
     auto res_buf =
@@ -262,6 +314,12 @@ std::vector<Ptr<BTensor>> StageProgram::ffn1_block(std::vector<Ptr<BTensor>> inp
         name_gen(prefix, OperationType::LayerNorm),
         _model->get_params(layer, BlockType::FeedForward, OperationType::LayerNorm)));
     inputs = get_outputs(ln, inputs);
+    if (_model->get_config().model_n_experts > 0) {
+        inputs = moe_block(inputs);
+        auto residual = add_op(std::make_shared<Add>(name_gen(prefix, OperationType::Residual)));
+        inputs.push_back(res_buf);
+        return get_outputs(residual, inputs);
+    }
 
     auto fc1 = add_op(std::make_shared<MatMul>(
         name_gen(prefix, OperationType::FullyConnected1),
@@ -286,6 +344,72 @@ std::vector<Ptr<BTensor>> StageProgram::ffn2_block(std::vector<Ptr<BTensor>> inp
     return inputs;
 }
 
+// (N,E) -> router -> dispatch -> FC1/GELU/FC2 of each expert over its rows -> combine -> (N,E)
+// Only the experts that get a row run, so at small batches few expert weights are read.
+std::vector<Ptr<BTensor>> StageProgram::moe_block(std::vector<Ptr<BTensor>> inputs) {
+    int layer = 0;
+    auto &config = _model->get_config();
+    std::string prefix = name_gen(LAYER(layer), BlockType::FeedForward);
+
+    // rows in the order of the batch, like the embedding
+    auto load = MoERouter::expert_load(config);
+    std::vector<std::vector<uint32_t>> expert_rows(config.model_n_experts);
+    uint32_t row = 0;
+    for (auto &req : _breq->_reqs) {
+        uint32_t rows = req->is_initiated ? 1 : req->input_size;
+        uint64_t pos = req->is_initiated ? req->input_size + req->generated : 0;
+        for (uint32_t i = 0; i < rows; i++, row++)
+            for (auto expert : MoERouter::route(config, load, req->id, pos + i))
+                expert_rows[expert].push_back(row);
+    }
+    std::vector<uint32_t> expert_tokens;
+    for (auto &rows : expert_rows) expert_tokens.push_back(rows.size());
+    double mean = (double)std::accumulate(expert_tokens.begin(), expert_tokens.end(), 0) /
+                  expert_tokens.size();
+    spdlog::info("MoE tokens per expert: {}, max / mean {:.2f}", expert_tokens,
+                 *std::max_element(expert_tokens.begin(), expert_tokens.end()) / mean);
+
+    // (N,E) x (E,X)
+    auto router = add_op(std::make_shared<MatMul>(
+        name_gen(prefix, OperationType::Router),
+        std::vector<Ptr<NPUTensor>>{_model->find_tensor(
+            name_gen(prefix, OperationType::Router, ParameterType::Weight))}));
+    auto logits = get_outputs(router, inputs);
+
+    auto dispatch = add_op(std::make_shared<MoEDispatch>(
+        name_gen(prefix, OperationType::MoEDispatch), expert_rows));
+    auto expert_inputs = get_outputs(dispatch, {inputs[0], logits[0]});
+
+    std::vector<Ptr<BTensor>> expert_outputs;
+    uint32_t active = 0;
+    for (uint32_t e = 0; e < config.model_n_experts; e++) {
+        if (expert_rows[e].empty()) continue;
+        std::string expert = EXPERT(e);
+        std::vector<Ptr<BTensor>> x{expert_inputs[active++]};
+
+        auto fc1 = add_op(std::make_shared<MatMul>(
+            name_gen(prefix, expert, OperationType::FullyConnected1),
+            _model->get_params(layer, BlockType::FeedForward,
+                               name_gen(expert, OperationType::FullyConnected1))));
+        x = get_outputs(fc1, x);
+
+        auto gelu = add_op(std::make_shared<Gelu>(name_gen(prefix, expert, OperationType::Gelu)));
+        x = get_outputs(gelu, x);
+
+        auto fc2 = add_op(std::make_shared<MatMul>(
+            name_gen(prefix, expert, OperationType::FullyConnected2),
+            _model->get_params(layer, BlockType::FeedForward,
+                               name_gen(expert, OperationType::FullyConnected2))));
+        x = get_outputs(fc2, x);
+        expert_outputs.push_back(x[0]);
+    }
+    expert_outputs.push_back(expert_inputs.back());  // gates
+
+    auto combine = add_op(std::make_shared<MoECombine>(
+        name_gen(prefix, OperationType::MoECombine), expert_rows));
+    return get_outputs(combine, expert_outputs);
+}
+
 std::vector<Ptr<BTensor>> StageProgram::qkv_gen_block(std::vector<Ptr<BTensor>> inputs) {
     int layer = 0;
     auto prefix = name_gen(LAYER(0), BlockType::Attention);
@@ -303,4 +427,41 @@ std::vector<Ptr<BTensor>> StageProgram::qkv_gen_block(std::vector<Ptr<BTensor>>
     inputs = get_outputs(qkv_gen, inputs);
 
     return inputs;
-}
\ No newline at end of file
+}
+
+// (N,1) token ids -> (N,E)
+std::vector<Ptr<BTensor>> StageProgram::embedding_block(std::vector<Ptr<BTensor>> inputs) {
+    auto table = _model->get_params(OperationType::Embedding)[0];
+    uint32_t vocab_shard = table->get_dims()[0];
+
+    // the simulator carries no token values: a stand-in id per (request, position) spreads the
+    // gathers over the table like real tokens would
+    std::vector<uint32_t> token_ids;
+    for (auto &req : _breq->_reqs) {
+        uint32_t rows = req->is_initiated ? 1 : req->input_size;
+        uint64_t pos = req->is_initiated ? req->input_size + req->generated : 0;
+        for (uint32_t i = 0; i < rows; i++) {
+            uint64_t key = ((uint64_t)req->id << 32) | (pos + i);
+            token_ids.push_back((key * 0x9E3779B97F4A7C15ull >> 32) % vocab_shard);
+        }
+    }
+
+    auto embedding = add_op(std::make_shared<Embedding>(
+        name_gen(OperationType::Embedding), table, token_ids));
+    return get_outputs(embedding, inputs);
+}
+
+// (N,E) -> (N,V/tp) logits -> (N,1) next tokens
+std::vector<Ptr<BTensor>> StageProgram::lm_head_block(std::vector<Ptr<BTensor>> inputs) {
+    auto ln = add_op(std::make_shared<LayerNorm>(
+        name_gen(OperationType::FinalLayerNorm), _model->get_params(OperationType::FinalLayerNorm)));
+    inputs = get_outputs(ln, inputs);
+
+    // (N,E) x (E,V/tp)
+    auto lm_head = add_op(std::make_shared<MatMul>(name_gen(OperationType::LmHead),
+                                                   _model->get_params(OperationType::LmHead)));
+    inputs = get_outputs(lm_head, inputs);
+
+    auto sampling = add_op(std::make_shared<Sampling>(name_gen(OperationType::Sampling)));
+    return get_outputs(sampling, inputs);
+}
@@ -13,7 +13,8 @@
 class StageProgram {
    public:
     StageProgram(std::shared_ptr<Model> model, Ptr<BatchedRequest> batched_request,
-                 StagePlatform stage_type, Stage stage);
+                 StagePlatform stage_type, Stage stage,
+                 std::vector<KVMigration> kv_migrations = {});
     void init_program();
     Ptr<Operation> add_op(Ptr<Operation> op);
     std::vector<Ptr<BTensor>> get_outputs(Ptr<Operation> op, std::vector<Ptr<BTensor>> inputs);
@@ -45,16 +46,25 @@ class StageProgram {
     StagePlatform _stage_platform;
     Stage _stage;
 
+    // KV cache copies between PIM channels, issued on the SA timeline of this stage
+    std::vector<KVMigration> _kv_migrations;
+
     void init_SA_program();
     void init_PIM_program();
 
     bool enable_proj_ffns();
     bool enable_qkv_gen();
+    bool enable_embedding();
+    bool enable_lm_head();
     bool skip_pim_stage();
 
     // Layer Block
     std::vector<Ptr<BTensor>> projection_block(std::vector<Ptr<BTensor>> inputs);
     std::vector<Ptr<BTensor>> ffn1_block(std::vector<Ptr<BTensor>> inputs);
     std::vector<Ptr<BTensor>> ffn2_block(std::vector<Ptr<BTensor>> inputs);
+    std::vector<Ptr<BTensor>> moe_block(std::vector<Ptr<BTensor>> inputs);
     std::vector<Ptr<BTensor>> qkv_gen_block(std::vector<Ptr<BTensor>> inputs);
+    void kv_migration_block(std::vector<Ptr<BTensor>> inputs);
+    std::vector<Ptr<BTensor>> embedding_block(std::vector<Ptr<BTensor>> inputs);
+    std::vector<Ptr<BTensor>> lm_head_block(std::vector<Ptr<BTensor>> inputs);
 };
\ No newline at end of file
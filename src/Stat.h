@@ -71,6 +71,10 @@ typedef struct NPUStat {
         }
         return ret + "\n";
     }
+
+    bool is_zero() { return num_calculations == 0; }
+    static std::vector<std::string> get_fields() { return {"StartCycle", "NumCalculations"}; }
+    std::vector<uint64_t> get_field_values() { return {start_cycle, num_calculations}; }
 } NPUStat;
 
 // TODO: num_cycles is a magic number. it counts memory load store for 50 core-cycles
@@ -176,6 +180,15 @@ typedef struct MemoryIOStat {
         }
         return ret + "\n";
     }
+
+    bool is_zero() { return memory_reads == 0 && memory_writes == 0 && pim_reads == 0; }
+    static std::vector<std::string> get_fields() {
+        return {"StartCycle",  "ChannelID",    "NumCycles",
+                "MemoryReads", "MemoryWrites", "PIMReads"};
+    }
+    std::vector<uint64_t> get_field_values() {
+        return {start_cycle, channel_id, num_cycles, memory_reads, memory_writes, pim_reads};
+    }
 } MemoryIOStat;
 
 typedef struct TileStat {
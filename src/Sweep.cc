@@ -0,0 +1,114 @@
+#include "Sweep.h"
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+#include "Simulator.h"
+
+namespace fs = std::filesystem;
+
+namespace Sweep {
+namespace {
+using Point = std::vector<std::pair<std::string, json>>;
+
+// every combination of the grid values, the last key varies fastest
+std::vector<Point> expand(json grid) {
+    std::vector<Point> points = {{}};
+    for (auto &item : grid.items()) {
+        json values = item.value().is_array() ? item.value() : json::array({item.value()});
+        std::vector<Point> expanded;
+        for (auto &point : points) {
+            for (auto &value : values) {
+                expanded.push_back(point);
+                expanded.back().push_back({item.key(), value});
+            }
+        }
+        points = expanded;
+    }
+    return points;
+}
+
+void set(Configs &configs, std::string key, json value) {
+    if (key == "cli_config") {
+        configs.cli_config = value;
+        return;
+    }
+    std::vector<std::pair<std::string, json *>> files = {{"config", &configs.config},
+                                                         {"mem_config", &configs.mem_config},
+                                                         {"model_config", &configs.model_config},
+                                                         {"sys_config", &configs.sys_config}};
+    auto dot = key.find('.');
+    for (auto &[name, file] : files) {
+        if (dot != std::string::npos && key.substr(0, dot) == name) {
+            (*file)[key.substr(dot + 1)] = value;
+            return;
+        }
+    }
+    for (auto &[name, file] : files) {
+        if (file->contains(key)) {
+            (*file)[key] = value;
+            return;
+        }
+    }
+    spdlog::error("Sweep key {} is not in any config file", key);
+    exit(EXIT_FAILURE);
+}
+}  // namespace
+
+void apply(const Configs &configs, std::string log_dir) {
+    Config::global_config = initialize_config(configs.config);
+    initialize_memory_config(configs.mem_config);
+    initialize_client_config(configs.cli_config);
+    if (configs.models.is_null())
+        initialize_model_config(configs.model_config);
+    else
+        initialize_models_config(configs.models);
+    initialize_system_config(configs.sys_config);
+    Config::global_config.log_dir = log_dir;
+}
+
+void run(Configs base, json sweep_config, std::string log_dir) {
+    uint32_t num_threads = std::thread::hardware_concurrency();
+    if (sweep_config.contains("num_threads")) num_threads = sweep_config["num_threads"];
+    ast(num_threads >= 1);
+    std::vector<Point> points = expand(sweep_config["grid"]);
+
+    std::vector<Configs> configs;
+    std::vector<std::string> point_dirs;
+    if (!log_dir.empty()) fs::create_directories(log_dir);
+    std::ofstream index(fs::path(log_dir) / "sweep.tsv");
+    index << "Point";
+    for (auto &[key, value] : points[0]) index << "\t" << key;
+    index << "\n";
+    for (size_t i = 0; i < points.size(); i++) {
+        configs.push_back(base);
+        index << "point_" << i;
+        for (auto &[key, value] : points[i]) {
+            set(configs.back(), key, value);
+            index << "\t" << value.dump();
+        }
+        index << "\n";
+        point_dirs.push_back((fs::path(log_dir) / fmt::format("point_{}", i)).string());
+        fs::create_directories(point_dirs.back());
+    }
+    index.close();
+    spdlog::info("Sweep: {} points on {} threads", points.size(), num_threads);
+
+    std::atomic<size_t> next_point{0};
+    auto worker = [&] {
+        for (size_t i = next_point++; i < configs.size(); i = next_point++) {
+            // thread_local state (ids, allocators, traces) starts fresh on a new thread
+            std::thread([&] {
+                Sweep::apply(configs[i], point_dirs[i]);
+                run_simulation();
+            }).join();
+            spdlog::info("Sweep: {} done", point_dirs[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < std::min<size_t>(num_threads, configs.size()); t++)
+        workers.emplace_back(worker);
+    for (auto &thread : workers) thread.join();
+}
+}  // namespace Sweep
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Sweep {
+// parsed --config, --mem_config, --model_config, --sys_config files and the --cli_config trace
+struct Configs {
+    json config;
+    json mem_config;
+    json model_config;
+    json sys_config;
+    std::string cli_config;
+    json models;  // --models_list (see load_models_list), replaces model_config if set
+};
+
+// Sets Config::global_config of the calling thread
+void apply(const Configs &configs, std::string log_dir);
+
+/**
+ * Runs every point of a parameter grid in this process. sweep_config:
+ *   {"num_threads": 8,
+ *    "grid": {"max_batch_size": [256, 512], "dram_channels": [16, 32],
+ *             "sub_batch_mode": [true, false], "cli_config": ["a.csv", "b.csv"]}}
+ * A grid key is a key of the first config file that has it, or "<file>.<key>"
+ * (e.g. "sys_config.kv_migration") for a key the file does not set. "cli_config" is the
+ * request trace.
+ * Each point runs on a fresh thread, so it gets its own Config::global_config, allocators
+ * and id counters, and logs to {log_dir}/point_{i}. {log_dir}/sweep.tsv lists the points.
+ * Traces are parsed once per process. An error that exits still ends the whole sweep.
+ */
+void run(Configs base, json sweep_config, std::string log_dir);
+}  // namespace Sweep
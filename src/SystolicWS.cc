@@ -333,7 +333,7 @@ void SystolicWS::issue_ex_inst(Instruction inst) {
         if (parent_tile == nullptr) {
             assert(0);
         }
-        spdlog::info("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
+        SPDLOG_TRACE("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
         parent_tile->stat.num_calculation += inst.tile_m * inst.tile_n * inst.tile_k;
 
         if (inst.opcode == Opcode::GEMM_PRELOAD) {
@@ -362,6 +362,8 @@ void SystolicWS::issue_ex_inst(Instruction inst) {
         }
 
         inst.finish_cycle = inst.start_cycle + get_inst_compute_cycles(inst);
+        EventTrace::record(EventTrace::Type::SAInst, inst.start_cycle, _id,
+                           static_cast<uint32_t>(inst.opcode), inst.finish_cycle);
         // spdlog::info("finish_cycle: {}", inst.finish_cycle);
         _compute_pipeline.push(inst);
         _stat_systolic_inst_issue_count++;
@@ -369,7 +371,7 @@ void SystolicWS::issue_ex_inst(Instruction inst) {
                inst.opcode == Opcode::LAYERNORM || inst.opcode == Opcode::SOFTMAX ||
                inst.opcode == Opcode::ADD || inst.opcode == Opcode::GELU ||
                inst.opcode == Opcode::DUMMY) {  // vector unit compute
-        spdlog::info("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
+        SPDLOG_TRACE("COMPUTE Start cycle: {} inst:{}", _core_cycle, inst.repr());
         std::queue<Instruction> *least_filled_vpu;
         cycle_type finish_cycle = std::numeric_limits<uint64_t>::max();
         for (auto &vector_pipeline : _vector_pipelines) {
@@ -386,6 +388,9 @@ void SystolicWS::issue_ex_inst(Instruction inst) {
         inst.start_cycle = finish_cycle;
         inst.finish_cycle = inst.start_cycle + get_vector_compute_cycles(inst);
         least_filled_vpu->push(inst);
+        EventTrace::record(EventTrace::Type::VectorInst, inst.start_cycle, _id,
+                           static_cast<uint32_t>(inst.opcode), inst.finish_cycle,
+                           least_filled_vpu - _vector_pipelines.data());
 
         {
             // if (!_vector_pipeline.empty()) {
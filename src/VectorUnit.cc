@@ -0,0 +1,173 @@
+#include "VectorUnit.h"
+
+VectorUnit::VectorUnit(SimulationConfig config)
+    : _config(config), _initiation_interval(config.vector_initiation_interval) {
+    ast(_initiation_interval > 0);
+    _lane_free_cycles.resize(_config.vector_core_count);
+}
+
+std::vector<VectorUnit::Phase> VectorUnit::get_phases(Instruction &inst) {
+    cycle_type vec_op_iter = calculate_vector_op_iterations(inst.size);
+    cycle_type add_tree_iter = calculate_add_tree_iterations(inst.size);
+    switch (inst.opcode) {
+        case Opcode::LAYERNORM:
+            // mean and variance trees, 2 scalar mul + sqrt, 1 add, 1 sub, 1 div, 2 mul
+            return {{Lane::REDUCE, 2 * add_tree_iter, _config.add_tree_latency},
+                    {Lane::MAC, 1, 2 * _config.scalar_mul_latency + _config.scalar_sqrt_latency},
+                    {Lane::MAC, 2 * vec_op_iter, _config.add_latency},
+                    {Lane::MAC, 3 * vec_op_iter, _config.mul_latency}};
+        case Opcode::SOFTMAX:
+            // max tree, subtract max, exp, sum tree, scale
+            return {{Lane::REDUCE, add_tree_iter, _config.add_tree_latency},
+                    {Lane::MAC, vec_op_iter, _config.add_latency},
+                    {Lane::EXP, vec_op_iter, _config.exp_latency},
+                    {Lane::REDUCE, add_tree_iter, _config.add_tree_latency},
+                    {Lane::MAC, vec_op_iter, _config.mul_latency}};
+        case Opcode::ADD:
+            return {{Lane::MAC, vec_op_iter, _config.add_latency}};
+        case Opcode::GELU:
+            return {{Lane::EXP, vec_op_iter, _config.gelu_latency}};
+        case Opcode::DUMMY:
+            return {{Lane::MAC, 1, 1}};
+        case Opcode::SAMPLE:
+            return get_sample_phases(inst.size);
+        case Opcode::DEQUANT_WGT:
+            return get_dequant_phases(inst.tile_k * inst.tile_n, _config.weight_dtype);
+        case Opcode::DEQUANT_KV:
+            return get_dequant_phases(inst.tile_k * inst.tile_n, _config.kv_dtype);
+        case Opcode::COMP:
+        case Opcode::IM2COL:
+            return {};
+        default:
+            // GEMMs, moves and PIM commands never reach the vector unit
+            spdlog::error("not a vector operation: {} ({})", inst.id,
+                          static_cast<int>(inst.opcode));
+            exit(EXIT_FAILURE);
+    }
+}
+
+// one token from vocab_size logits with decode_top_k / decode_top_p
+std::vector<VectorUnit::Phase> VectorUnit::get_sample_phases(uint32_t vocab_size) {
+    cycle_type vec_op_iter = calculate_vector_op_iterations(vocab_size);
+    cycle_type add_tree_iter = calculate_add_tree_iterations(vocab_size);
+    // greedy: argmax tree
+    if (_config.decode_top_k == 1)
+        return {{Lane::REDUCE, add_tree_iter, _config.add_tree_latency}};
+
+    // max tree, subtract max, exp, sum tree
+    std::vector<Phase> phases = {{Lane::REDUCE, add_tree_iter, _config.add_tree_latency},
+                                 {Lane::MAC, vec_op_iter, _config.add_latency},
+                                 {Lane::EXP, vec_op_iter, _config.exp_latency},
+                                 {Lane::REDUCE, add_tree_iter, _config.add_tree_latency}};
+    uint32_t candidates = vocab_size;
+    if (_config.decode_top_k > 1 && _config.decode_top_k < vocab_size) {
+        // k-th largest by bisection on the value bits: compare, then count the survivors
+        for (uint32_t bit = 0; bit < _config.precision * 8; bit++) {
+            phases.push_back({Lane::MAC, vec_op_iter, _config.add_latency});
+            phases.push_back({Lane::REDUCE, add_tree_iter, _config.add_tree_latency});
+        }
+        candidates = _config.decode_top_k;
+    }
+    if (_config.decode_top_p < 1) {
+        // normalize the candidates and prefix-sum them up to top_p
+        phases.push_back({Lane::MAC, calculate_vector_op_iterations(candidates),
+                          _config.mul_latency});
+        phases.push_back({Lane::REDUCE, calculate_add_tree_iterations(candidates),
+                          _config.add_tree_latency});
+    }
+    // draw: scale the random number by the kept mass
+    phases.push_back({Lane::MAC, 1, _config.scalar_mul_latency});
+    return phases;
+}
+
+// to precision: int4 is unpacked (shift and mask) first, int formats are scaled, fp8 is
+// converted (exponent rebias)
+std::vector<VectorUnit::Phase> VectorUnit::get_dequant_phases(uint32_t elements,
+                                                              std::string dtype) {
+    cycle_type vec_op_iter = calculate_vector_op_iterations(elements);
+    if (dtype == "fp8") return {{Lane::MAC, vec_op_iter, _config.add_latency}};
+    std::vector<Phase> phases;
+    if (dtype == "int4") phases.push_back({Lane::MAC, vec_op_iter, _config.add_latency});
+    phases.push_back({Lane::MAC, vec_op_iter, _config.mul_latency});
+    return phases;
+}
+
+uint32_t VectorUnit::issue(Instruction &inst, cycle_type cycle) {
+    std::vector<Phase> phases = get_phases(inst);
+    phases.erase(std::remove_if(phases.begin(), phases.end(),
+                                [](const Phase &phase) { return phase.iterations == 0; }),
+                 phases.end());
+
+    // the vector core that finishes inst first; ties go to the lower index
+    uint32_t unit = 0;
+    cycle_type start_cycle = cycle;
+    cycle_type finish_cycle = std::numeric_limits<cycle_type>::max();
+    for (uint32_t i = 0; i < _lane_free_cycles.size(); i++) {
+        cycle_type ready = cycle;
+        cycle_type first_start = cycle;
+        for (size_t p = 0; p < phases.size(); p++) {
+            auto &phase = phases[p];
+            cycle_type start = MAX(ready, _lane_free_cycles[i][static_cast<size_t>(phase.lane)]);
+            if (p == 0) first_start = start;
+            ready = start + (phase.iterations - 1) * _initiation_interval + phase.latency;
+        }
+        if (ready < finish_cycle) {
+            unit = i;
+            start_cycle = first_start;
+            finish_cycle = ready;
+        }
+    }
+
+    cycle_type ready = cycle;
+    for (auto &phase : phases) {
+        auto &lane_free = _lane_free_cycles[unit][static_cast<size_t>(phase.lane)];
+        cycle_type start = MAX(ready, lane_free);
+        cycle_type busy = phase.iterations * _initiation_interval;
+        lane_free = start + busy;
+        ready = start + (phase.iterations - 1) * _initiation_interval + phase.latency;
+        _stat_lane_busy_cycles[static_cast<size_t>(phase.lane)] += busy;
+    }
+    assert(ready == finish_cycle);
+
+    inst.start_cycle = start_cycle;
+    inst.finish_cycle = finish_cycle;
+    _stat_ops[inst.opcode].count++;
+    _stat_ops[inst.opcode].cycles += finish_cycle - cycle;
+    return unit;
+}
+
+void VectorUnit::print_stats(uint32_t core_id, cycle_type core_cycle) {
+    const char *lane_names[] = {"EXP", "REDUCE", "MAC"};
+    cycle_type lane_cycles = core_cycle * _lane_free_cycles.size();
+    for (size_t lane = 0; lane < static_cast<size_t>(Lane::SIZE); lane++) {
+        spdlog::info("NeuPIMSCore [{}] : Vector {} lane busy cycle {} utilization {:.2f}%",
+                     core_id, lane_names[lane], _stat_lane_busy_cycles[lane],
+                     lane_cycles > 0 ? 100.0 * _stat_lane_busy_cycles[lane] / lane_cycles : 0);
+    }
+    for (auto &[opcode, stat] : _stat_ops) {
+        spdlog::info("NeuPIMSCore [{}] : Vector {} count {} cycle {}", core_id,
+                     opcodeToString(opcode), stat.count, stat.cycles);
+    }
+}
+
+cycle_type VectorUnit::calculate_add_tree_iterations(uint32_t vector_size) {
+    uint32_t calculation_unit = _config.vector_core_width;
+    if (vector_size <= calculation_unit) {
+        return 1;
+    }
+
+    uint32_t ret = vector_size / calculation_unit;
+    if (vector_size % calculation_unit != 0) {
+        ret++;
+    }
+    return ret + calculate_add_tree_iterations(ret);
+}
+
+cycle_type VectorUnit::calculate_vector_op_iterations(uint32_t vector_size) {
+    uint32_t calculation_unit = _config.vector_core_width;
+    uint32_t ret = vector_size / calculation_unit;
+    if (vector_size % calculation_unit != 0) {
+        ret++;
+    }
+    return ret;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+
+#include "Common.h"
+
+/**
+ * VectorUnit times vector instructions on vector_core_count vector cores. Each core has one lane
+ * per functional unit kind:
+ *   EXP:    exp, gelu
+ *   REDUCE: add / compare trees
+ *   MAC:    element-wise add and mul, scalar ops
+ * An instruction is a sequence of phases on these lanes. A phase of n iterations holds its lane
+ * for n * vector_initiation_interval cycles and finishes latency cycles after its last issue; it
+ * starts once the previous phase has finished and its lane is free, so instructions on
+ * different lanes of a core overlap.
+ */
+class VectorUnit {
+   public:
+    VectorUnit(SimulationConfig config);
+
+    enum class Lane { EXP, REDUCE, MAC, SIZE };
+
+    // sets start_cycle and finish_cycle of inst, returns the vector core it runs on
+    uint32_t issue(Instruction &inst, cycle_type cycle);
+    void print_stats(uint32_t core_id, cycle_type core_cycle);
+
+   private:
+    typedef struct {
+        Lane lane;
+        cycle_type iterations;
+        cycle_type latency;
+    } Phase;
+
+    typedef struct {
+        uint64_t count;
+        cycle_type cycles;  // issue to finish
+    } OpStat;
+
+    SimulationConfig _config;
+    cycle_type _initiation_interval;
+    std::vector<std::array<cycle_type, static_cast<size_t>(Lane::SIZE)>> _lane_free_cycles;
+
+    std::array<cycle_type, static_cast<size_t>(Lane::SIZE)> _stat_lane_busy_cycles{};
+    std::map<Opcode, OpStat> _stat_ops;
+
+    std::vector<Phase> get_phases(Instruction &inst);
+    std::vector<Phase> get_sample_phases(uint32_t vocab_size);
+    std::vector<Phase> get_dequant_phases(uint32_t elements, std::string dtype);
+    cycle_type calculate_add_tree_iterations(uint32_t vector_size);
+    cycle_type calculate_vector_op_iterations(uint32_t vector_size);
+};
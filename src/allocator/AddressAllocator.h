@@ -13,6 +13,8 @@ class WgtAlloc : public Singleton<WgtAlloc> {
     uint64_t _top_addr;
 
     addr_type allocate(uint64_t size);
+    uint64_t row_pitch(uint64_t row_bytes);
+    std::vector<std::pair<addr_type, uint32_t>> allocate_experts(uint64_t size, uint32_t experts);
     addr_type get_next_aligned_addr();
 };
 
@@ -54,7 +54,7 @@ void KVCacheAlloc::init_pim_layout(addr_type base_addr) {
     constexpr uint32_t row_offset = 20;
     constexpr uint64_t mask = ~((1 << row_offset) - 1);     // 0x1111(64-21)0000(21)
     _dram_row_size = Config::global_config.dram_page_size;  // 1024
-    _num_ele_per_row = _dram_row_size / Config::global_config.precision;  // 512
+    _num_ele_per_row = kv_page_elements(Config::global_config);  // 512 at 16 bits
     _bank_per_ch = Config::global_config.dram_banks_per_ch;
     _dram_channels = Config::global_config.dram_channels;
 
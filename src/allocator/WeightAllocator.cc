@@ -5,6 +5,14 @@ WgtAlloc::WgtAlloc() : _base_addr(0), _top_addr(0) {}
 addr_type WgtAlloc::allocate(uint64_t size) {
     addr_type unit = Config::global_config.dram_req_size * Config::global_config.dram_channels;
     addr_type result = _top_addr;
+    if (Config::global_config.weight_striping) {
+        // whole stripes over the channels, so every weight starts on channel 0
+        unit = AddressConfig::alignment << (AddressConfig::linear_layout.pos[AddressConfig::CH] +
+                                            AddressConfig::field_bits(AddressConfig::CH));
+        _top_addr += (size + unit - 1) / unit * unit;
+        ast(_top_addr < Config::global_config.HBM_size);
+        return result;
+    }
     _top_addr += (size + unit - 1) / unit;
     // if (_top_addr & (AddressConfig::alignment - 1)) {
     //     _top_addr += AddressConfig::alignment - (_top_addr & (AddressConfig::alignment - 1));
@@ -13,6 +21,36 @@ addr_type WgtAlloc::allocate(uint64_t size) {
     return result;
 }
 
+// Pads a weight row to an odd number of interleave units, so consecutive rows start on different
+// channels and the rows of a weight tile are spread over all of them
+uint64_t WgtAlloc::row_pitch(uint64_t row_bytes) {
+    if (!Config::global_config.weight_striping) return row_bytes;
+    uint64_t unit = AddressConfig::alignment << AddressConfig::linear_layout.pos[AddressConfig::CH];
+    uint64_t units = (row_bytes + unit - 1) / unit;
+    if (units % 2 == 0) units++;
+    return units * unit;
+}
+
+// Places `experts` weights of `size` bytes on moe_expert_channels channels each: the experts
+// of a set share its stripes, each on its own channels. Returns (base address, first channel)
+// per expert, see NPUTensor2D::place.
+std::vector<std::pair<addr_type, uint32_t>> WgtAlloc::allocate_experts(uint64_t size,
+                                                                       uint32_t experts) {
+    uint32_t channels = Config::global_config.moe_expert_channels;
+    ast(Config::global_config.weight_striping && channels > 0);
+    uint32_t per_set = Config::global_config.dram_channels / channels;
+    uint64_t unit = AddressConfig::alignment << AddressConfig::linear_layout.pos[AddressConfig::CH];
+    uint64_t stripe = unit * Config::global_config.dram_channels;
+    uint64_t stripes = (size + unit * channels - 1) / (unit * channels);  // per expert
+    uint32_t sets = (experts + per_set - 1) / per_set;
+
+    addr_type base = allocate(sets * stripes * stripe);
+    std::vector<std::pair<addr_type, uint32_t>> ret;
+    for (uint32_t e = 0; e < experts; e++)
+        ret.push_back({base + e / per_set * stripes * stripe, e % per_set * channels});
+    return ret;
+}
+
 addr_type WgtAlloc::get_next_aligned_addr() {
     ast(_top_addr > 0);
     return AddressConfig::align(_top_addr) + AddressConfig::alignment;
@@ -22,8 +22,7 @@ Client::Client(SimulationConfig config)
     _omin = 2;
     _omax = 4;
 
-    uint32_t answer_index = 1;
-    RequestGenerator::init(config.request_dataset_path, answer_index);
+    RequestGenerator::init(config.request_dataset_path);
 
     // _total_cnt = _config.request_total_cnt;
     _total_cnt = RequestGenerator::get_total_req_cnt();
@@ -32,66 +31,58 @@ Client::Client(SimulationConfig config)
 
     std::poisson_distribution<> d(_request_interval);
     _distribution = d;
-    _touch = false;
 }
 
 int Client::rand_input_size() { return rand() % (_imax - _imin) + _imin; }
 int Client::rand_output_size() { return rand() % (_omax - _omin) + _omin; }
 
+// sends every request whose arrival time has come
 void Client::cycle() {
-    uint32_t idle_cycles = _cycles - _last_request_cycle;
-    // return; // FIXME: comment
-    // FIXME: change while to if
-    while (!_touch) {
-        // todo: send request to scheduler
-        uint32_t rid = generate_rid();
-
-        // TODO: from benchmark dataset
-        // uint32_t input_size = rand_input_size();  // 10;
-        // uint32_t output_size = rand_output_size();  // 2;
-        std::pair<uint32_t, uint32_t> input_output_size;
-        if (RequestGenerator::has_data()) {
-            input_output_size = RequestGenerator::get_qa_length();
-        } else {
-            spdlog::info("RequestGenerator has no data!");
-            _touch = true;
-            break;
-            // exit(-1);
+    while (true) {
+        if (_next_request == nullptr) {
+            if (!RequestGenerator::has_data()) break;
+            auto trace_request = RequestGenerator::next();
+            ast(trace_request.output_size > 0);
+            ast(trace_request.channel < (int)_config.dram_channels);
+            ast(trace_request.model < _config.models.size());
+            // core_freq is in MHz
+            cycle_type arrival_cycle = trace_request.arrival * _config.core_freq * 1e6;
+            double ttft_slo = trace_request.ttft_slo > 0 ? trace_request.ttft_slo
+                                                         : _config.slo_ttft;
+            double tpot_slo = trace_request.tpot_slo > 0 ? trace_request.tpot_slo
+                                                         : _config.slo_tpot;
+            _next_request = std::make_shared<InferRequest>(
+                InferRequest{.id = generate_rid(),
+                             .arrival_cycle = arrival_cycle,
+                             .completed_cycle = 0,
+                             .input_size = trace_request.input_size,
+                             .output_size = trace_request.output_size,
+                             .is_initiated = false,
+                             .generated = 0,
+                             .channel = trace_request.channel,
+                             .prefix_id = trace_request.prefix_id,
+                             .prefix_len = trace_request.prefix_len,
+                             .priority = trace_request.priority,
+                             .model = trace_request.model,
+                             .tenant = trace_request.tenant,
+                             .ttft_slo = (cycle_type)(ttft_slo * _config.core_freq * 1e6),
+                             .tpot_slo = (cycle_type)(tpot_slo * _config.core_freq * 1e6)});
         }
-        uint32_t input_size = input_output_size.first;
-        uint32_t output_size = 1;  // input_output_size.second;  // 1;
-        uint32_t channel = input_output_size.second;
-        std::shared_ptr<InferRequest> request =
-            std::make_shared<InferRequest>(InferRequest{.id = rid,
-                                                        .arrival_cycle = _cycles,
-                                                        .completed_cycle = 0,
-                                                        .input_size = input_size,
-                                                        .output_size = output_size,
-                                                        .is_initiated = false,
-                                                        .generated = 0,
-                                                        .channel = channel});
-        _waiting_queue.push(request);
+        if (_next_request->arrival_cycle > _cycles) break;
 
         _issued_cnt++;
-        spdlog::info("issued cnt:{} total: {}", _issued_cnt, _total_cnt);
-        spdlog::info("idle:{}, need_wait:{}", idle_cycles, _need_wait_cycles);
+        if (_completed_ids.count(_next_request->id) > 0) {  // completed before the checkpoint
+            _next_request = nullptr;
+            continue;
+        }
+        _waiting_queue.push(_next_request);
         _last_request_cycle = _cycles;
-
-        // set next request interval
-        spdlog::info("xyz");
-        _need_wait_cycles = 0;  // _distribution(_gen);
-        spdlog::info("xyz");
-
-        spdlog::info("Client Request Departure!! now:{} next wait: {}", _cycles, _need_wait_cycles);
-        spdlog::info("Request #{}, input size:{}, output size:{}", rid, input_size, output_size);
+        SPDLOG_DEBUG("Request #{}, input size:{}, output size:{}", _next_request->id,
+                     _next_request->input_size, _next_request->output_size);
+        _next_request = nullptr;
     }
 
     _cycles++;
-
-    if (_completed_cnt == _total_cnt) {
-        spdlog::info("Client completed!");
-        exit(-1);
-    }
 }
 
 bool Client::running() {
@@ -112,6 +103,8 @@ void Client::receive_response(std::shared_ptr<InferRequest> response) {
 
     response->completed_cycle = _cycles;
     _completed_cnt++;
+    _completed_ids.insert(response->id);
+    if (_completed_cnt == _total_cnt) spdlog::info("Client completed!");
 
     // spdlog::info("Receive response! spend_cycles: {}",
     //              response->completed_cycle - response->arrival_cycle);
@@ -120,7 +113,24 @@ void Client::receive_response(std::shared_ptr<InferRequest> response) {
     // delete response;
 }
 
+json Client::checkpoint() {
+    json state;
+    state["cycles"] = _cycles;
+    state["last_request_cycle"] = _last_request_cycle;
+    state["completed_cnt"] = _completed_cnt;
+    state["completed_ids"] = _completed_ids;
+    return state;
+}
+
+// the trace is read again from the start: request ids are the same as in the saved run
+void Client::restore(json state) {
+    _cycles = state["cycles"];
+    _last_request_cycle = state["last_request_cycle"];
+    _completed_cnt = state["completed_cnt"];
+    _completed_ids = state["completed_ids"].get<std::set<uint32_t>>();
+}
+
 uint32_t generate_rid() {
-    static uint32_t rid{0};
+    static thread_local uint32_t rid{0};
     return rid++;
 }
@@ -18,15 +18,20 @@ class Client {
     std::shared_ptr<InferRequest> pop_request();
     void receive_response(std::shared_ptr<InferRequest> response);
 
+    /* progress through the trace; completed requests are not sent again after restore() */
+    json checkpoint();
+    void restore(json state);
+
    private:
     SimulationConfig _config;
-    uint32_t _cycles;
-    uint32_t _last_request_cycle;
+    cycle_type _cycles;
+    cycle_type _last_request_cycle;
     uint32_t _need_wait_cycles;
 
     uint32_t _total_cnt;
     uint32_t _issued_cnt;
     uint32_t _completed_cnt;
+    std::set<uint32_t> _completed_ids;
 
     uint32_t _request_interval;  // send a request per (core_freq/qps) cycles
     std::queue<std::shared_ptr<InferRequest>> _waiting_queue;
@@ -42,5 +47,5 @@ class Client {
     int _omax;
     int rand_input_size();
     int rand_output_size();
-    bool _touch;
+    std::shared_ptr<InferRequest> _next_request;  // read from the trace, not arrived yet
 };
@@ -1,7 +1,6 @@
 #include "Simulator.h"
-#include "allocator/AddressAllocator.h"
+#include "Sweep.h"
 #include "helper/CommandLineParser.h"
-#include "operations/Operation.h"
 
 namespace po = boost::program_options;
 
@@ -21,10 +20,12 @@ int main(int argc, char **argv) {
     cmd_parser.add_command_line_option<std::string>("log_dir",
                                                     "Path for experiment result log directory");
 
-    cmd_parser.add_command_line_option<std::string>("models_list", "Path for the models list file");
+    cmd_parser.add_command_line_option<std::string>(
+        "models_list", "Path for the list of co-located models, replaces model_config");
     cmd_parser.add_command_line_option<std::string>(
         "log_level", "Set for log level [trace, debug, info], default = info");
-    cmd_parser.add_command_line_option<std::string>("mode", "choose one_model or two_model");
+    cmd_parser.add_command_line_option<std::string>(
+        "sweep_config", "Path for a parameter sweep file, runs all points in this process");
 
     try {
         cmd_parser.parse(argc, argv);
@@ -41,16 +42,12 @@ int main(int argc, char **argv) {
         spdlog::set_level(spdlog::level::debug);
     else if (level == "info")
         spdlog::set_level(spdlog::level::info);
+    if (spdlog::get_level() < SPDLOG_ACTIVE_LEVEL)
+        spdlog::warn("log_level {} is below SPDLOG_ACTIVE_LEVEL, hot-path logs are compiled out",
+                     level);
 
     std::string config_path;
     cmd_parser.set_if_defined("config", &config_path);
-
-    json config_json;
-    std::ifstream config_file(config_path);
-    config_file >> config_json;
-    config_file.close();
-    Config::global_config = initialize_config(config_json);
-
     std::string mem_config_path;
     cmd_parser.set_if_defined("mem_config", &mem_config_path);
     std::string cli_config_path;
@@ -61,43 +58,27 @@ int main(int argc, char **argv) {
     cmd_parser.set_if_defined("sys_config", &sys_config_path);
     std::string log_dir_path;
     cmd_parser.set_if_defined("log_dir", &log_dir_path);
-
-    initialize_memory_config(mem_config_path);
-    initialize_client_config(cli_config_path);
-    initialize_model_config(model_config_path);
-    initialize_system_config(sys_config_path);
-
-    Config::global_config.log_dir = log_dir_path;
-
-    Operation::initialize(Config::global_config);
-
-    auto simulator = std::make_unique<Simulator>(Config::global_config);
-    AddressConfig::alignment = Config::global_config.dram_req_size;
-    // todo: assert log2
-    AddressConfig::channel_mask = Config::global_config.dram_channels - 1;
-    // todo: magic number
-    AddressConfig::channel_offset = 10;  // 64B req_size -> 6bit + 16 groups of columns -> 4bit
-    spdlog::info("DRAM address alignment {}", AddressConfig::alignment);
-
-    std::string model_name = Config::global_config.model_name;
-    std::string input_name = "input";
-    spdlog::info("model name: {}", model_name);
-    auto model = std::make_shared<Model>(Config::global_config, model_name);
-
-    /* Allocator initialization after weight allocating */
-    // if (Config::global_config.run_mode == RunMode::NPU_PIM) {
-    //     ActAlloc::init(WgtAlloc::get_next_aligned_addr());
-    //     KVCacheAlloc::init(ActAlloc::get_next_aligned_addr());
-    // }
-    ActAlloc::GetInstance()->init(WgtAlloc::GetInstance()->get_next_aligned_addr());
-    KVCacheAlloc::GetInstance()->init(ActAlloc::GetInstance()->get_next_aligned_addr());
-
-    printf("Launching model\n");
-    simulator->launch_model(model);
-    spdlog::info("Launch model: {}", model_name);
-    simulator->run(model_name);
-
-    MemoryAccess::log_count();
+    std::string sweep_config_path;
+    cmd_parser.set_if_defined("sweep_config", &sweep_config_path);
+    std::string models_list_path;
+    cmd_parser.set_if_defined("models_list", &models_list_path);
+
+    Sweep::Configs configs{.config = load_config(config_path),
+                           .mem_config = load_config(mem_config_path),
+                           .model_config = nullptr,
+                           .sys_config = load_config(sys_config_path),
+                           .cli_config = cli_config_path,
+                           .models = nullptr};
+    if (models_list_path.empty())
+        configs.model_config = load_config(model_config_path);
+    else
+        configs.models = load_models_list(models_list_path);
+    if (!sweep_config_path.empty()) {
+        Sweep::run(configs, load_config(sweep_config_path), log_dir_path);
+        return 0;
+    }
+    Sweep::apply(configs, log_dir_path);
+    run_simulation();
 
     std::string yellow = "\033[1;33m";
     std::string red = "\033[1;31m";
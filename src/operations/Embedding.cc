@@ -0,0 +1,98 @@
+#include "Embedding.h"
+
+Embedding::Embedding(std::string name, Ptr<NPUTensor> table, std::vector<uint32_t> token_ids)
+    : Operation(name), _token_ids(token_ids) {
+    _inputs.resize(2);
+    _inputs[1] = table;
+}
+
+std::vector<Ptr<BTensor>> Embedding::get_outputs(std::vector<Ptr<BTensor>> inputs) {
+    set_as_parent_tensor(inputs);
+
+    assert(inputs.size() == 1);
+    _inputs[0] = inputs[0];
+
+    auto table_dims = _inputs[1]->get_dims();
+    assert(table_dims.size() == 2);
+    assert(inputs[0]->get_dims()[0] == _token_ids.size());
+    _embd = table_dims[1];
+
+    _outputs.resize(1);
+    _outputs[0] = std::make_shared<NPUTensor>(
+        _name + "_output", std::vector<uint32_t>{(uint32_t)_token_ids.size(), _embd},
+        NPUTensorBufType::ACT, false);
+
+    calculate_loops();
+    initialize_tiles();
+
+    return _outputs;
+}
+
+void Embedding::initialize_tiles() {
+    for (uint32_t start = 0; start < _token_ids.size(); start += _rows_per_tile) {
+        uint32_t end = MIN(start + _rows_per_tile, (uint32_t)_token_ids.size());
+        _tiles.push_back(initialize_instructions(start, end));
+    }
+}
+
+// rows [start, end) of the output
+//  MOVIN       : table row of the token -> spad
+//  DEQUANT_WGT : spad -> accumulator at precision, if the table is quantized
+//  MOVOUT      : spad (or accumulator) -> output row
+// The token ids come from the sampler of the previous iteration and are not loaded.
+Tile Embedding::initialize_instructions(uint32_t start, uint32_t end) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = start / _rows_per_tile,
+        .K = 0,
+        .accum = false,
+    };
+
+    auto table = std::static_pointer_cast<NPUTensor>(_inputs[1]);
+    auto output_tensor = std::static_pointer_cast<NPUTensor>(_outputs[0]);
+
+    for (uint32_t row = start; row < end; ++row) {
+        addr_type sram_offset = SPAD_BASE + (row - start) * _embd * _config.precision;
+        uint32_t row_size = _embd * _config.precision;
+
+        auto table_addrs = table->get_row_addrs(_token_ids[row]);
+        if (weights_quantized()) table_addrs = pack_weight_addrs(table_addrs);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVIN,
+            .dest_addr = sram_offset,
+            .size = row_size,
+            .src_addrs = std::move(table_addrs),
+            .operand_id = _INPUT_OPERAND,
+        });
+        if (weights_quantized()) {
+            addr_type accum_offset = ACCUM_SPAD_BASE + (row - start) * row_size;
+            tile.instructions.push_back(Instruction{
+                .opcode = Opcode::DEQUANT_WGT,
+                .dest_addr = accum_offset,
+                .size = row_size,
+                .src_addrs = std::vector<addr_type>{sram_offset},
+                .tile_k = 1,
+                .tile_n = _embd,
+            });
+            sram_offset = accum_offset;
+        }
+
+        auto output_addrs = output_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = sram_offset,
+            .size = (uint32_t)output_addrs.size() * _config.precision,
+            .src_addrs = std::move(output_addrs),
+            .operand_id = _OUTPUT_OPERAND,
+        });
+    }
+
+    return tile;
+}
+
+void Embedding::calculate_loops() {
+    uint32_t row_size = _embd * _config.precision;
+    _rows_per_tile = MAX((_config.spad_size KB / 2) / row_size, 1);
+}
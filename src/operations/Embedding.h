@@ -0,0 +1,21 @@
+#pragma once
+#include "../tensor/NPUTensor.h"
+#include "Operation.h"
+
+// Gathers one row of the embedding table per token: (N,1) token ids -> (N,E).
+// The table holds the vocabulary shard of this chip, token_ids are row indices into it.
+class Embedding : public Operation {
+   public:
+    Embedding(std::string name, Ptr<NPUTensor> table, std::vector<uint32_t> token_ids);
+
+    std::vector<Ptr<BTensor>> get_outputs(std::vector<Ptr<BTensor>> inputs) override;
+
+   private:
+    std::vector<uint32_t> _token_ids;
+    uint32_t _embd;
+    uint32_t _rows_per_tile;
+
+    void calculate_loops();
+    void initialize_tiles();
+    Tile initialize_instructions(uint32_t start, uint32_t end);
+};
@@ -258,9 +258,9 @@ void FusedMHA::calculate_loops() {
         uint32_t heads_per_tile = sram_capacity / total_size_per_head;
         if (heads_per_tile > _nh) heads_per_tile = _nh;
 
-        spdlog::info("({}) heads_per_tile: {}", i, heads_per_tile);
-        spdlog::info("q_len: {}, seq_len: {}, dk: {}", q_len, seq_len, _dk);
-        spdlog::info("sram capacity: {}, one head size: {}", sram_capacity, total_size_per_head);
+        SPDLOG_DEBUG("({}) heads_per_tile: {}", i, heads_per_tile);
+        SPDLOG_DEBUG("q_len: {}, seq_len: {}, dk: {}", q_len, seq_len, _dk);
+        SPDLOG_DEBUG("sram capacity: {}, one head size: {}", sram_capacity, total_size_per_head);
 
         //
         _heads_per_tile.push_back(heads_per_tile);
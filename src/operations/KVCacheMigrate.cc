@@ -0,0 +1,118 @@
+#include "KVCacheMigrate.h"
+
+KVCacheMigrate::KVCacheMigrate(std::string name, std::vector<KVMigration> migrations)
+    : Operation(name), _migrations(migrations) {
+    _inputs.resize(1);
+}
+
+// The input is only used for dependency. KVCacheMigrate produces no activation.
+std::vector<Ptr<BTensor>> KVCacheMigrate::get_outputs(std::vector<Ptr<BTensor>> inputs) {
+    set_as_parent_tensor(inputs);
+
+    _inputs[0] = inputs[0];
+    _outputs.resize(0);
+
+    calculate_loops();
+    initialize_tiles();
+
+    return _outputs;
+}
+
+void KVCacheMigrate::initialize_tiles() {
+    for (auto &migration : _migrations) {
+        assert(migration.src_rows.empty() ||
+               migration.src_rows.size() == migration.dst_rows.size());
+        uint32_t num_rows = migration.dst_rows.size();
+        for (uint32_t start = 0; start < num_rows; start += _rows_per_tile) {
+            uint32_t end = MIN(start + _rows_per_tile, num_rows);
+            _tiles.push_back(initialize_instructions(migration, start, end));
+        }
+    }
+}
+
+// copy PIM rows [start, end) of the migration
+//  MOVIN  : src channel row -> spad
+//  MOVOUT : spad -> dst channel row
+// rows from the KV transfer link land in the accumulator spad (DUMMY) instead of a MOVIN
+Tile KVCacheMigrate::initialize_instructions(KVMigration &migration, uint32_t start,
+                                             uint32_t end) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = migration.request_id,
+        .K = 0,
+        .accum = false,
+    };
+
+    uint32_t row_elements = _bursts_per_row * _config.dram_req_size / _config.precision;
+
+    bool ingest = migration.src_rows.empty();
+    for (uint32_t i = start; i < end; ++i) {
+        auto sram_entry = allocate_sram_addr(row_elements, ingest);
+
+        if (ingest) {
+            tile.instructions.push_back(Instruction{
+                .opcode = Opcode::DUMMY,
+                .dest_addr = sram_entry.first,
+                .size = sram_entry.second,
+            });
+        } else {
+            tile.instructions.push_back(Instruction{
+                .opcode = Opcode::MOVIN,
+                .dest_addr = sram_entry.first,
+                .size = sram_entry.second,
+                .src_addrs = get_row_addrs(migration.src_ch, migration.src_rows[i]),
+                .operand_id = _INPUT_OPERAND,
+                .direct_dram_addr = true,
+            });
+        }
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = sram_entry.first,
+            .size = sram_entry.second,
+            .src_addrs = get_row_addrs(migration.dst_ch, migration.dst_rows[i]),
+            .operand_id = _OUTPUT_OPERAND,
+            .direct_dram_addr = true,
+        });
+    }
+
+    return tile;
+}
+
+// addresses of every burst in PIM row `row` of channel `ch` (same row index in all banks)
+std::vector<addr_type> KVCacheMigrate::get_row_addrs(uint32_t ch, uint64_t row) {
+    std::vector<addr_type> ret;
+    uint32_t cols_per_row = _config.dram_page_size / _config.dram_req_size;
+    // bank index of a channel = rank | bankgroup | bank, widths from the DRAM address layout
+    int ba_bits = AddressConfig::field_bits(AddressConfig::BA);
+    int bg_bits = AddressConfig::field_bits(AddressConfig::BG);
+    for (uint32_t bank_idx = 0; bank_idx < _config.dram_banks_per_ch; ++bank_idx) {
+        int rank = bank_idx >> (bg_bits + ba_bits);
+        int bankgroup = (bank_idx >> ba_bits) & ((1 << bg_bits) - 1);
+        int bank = bank_idx & ((1 << ba_bits) - 1);
+        for (uint32_t col = 0; col < cols_per_row; ++col) {
+            ret.push_back(AddressConfig::make_address(ch, rank, bankgroup, bank, row, col));
+        }
+    }
+    return ret;
+}
+
+void KVCacheMigrate::calculate_loops() {
+    _bursts_per_row =
+        _config.dram_banks_per_ch * (_config.dram_page_size / _config.dram_req_size);
+    _rows_per_tile = 1;
+    while (sram_size_needed() * 2 <= _config.spad_size KB / 2) {
+        _rows_per_tile *= 2;
+    }
+}
+
+uint32_t KVCacheMigrate::sram_size_needed() {
+    return _rows_per_tile * _bursts_per_row * _config.dram_req_size;
+}
+
+uint64_t KVCacheMigrate::get_migrated_bytes() {
+    uint64_t rows = 0;
+    for (auto &migration : _migrations) rows += migration.dst_rows.size();
+    return rows * _bursts_per_row * _config.dram_req_size;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "../tensor/NPUTensor.h"
+#include "Operation.h"
+
+// PIM rows of one request's KV cache to be copied from src_ch to dst_ch.
+// src_rows[i] is copied to dst_rows[i]. Without src_rows the rows come over the KV transfer link
+// from a prefill device (prefill_devices) and are only written to dst_rows of dst_ch.
+struct KVMigration {
+    uint32_t request_id;
+    uint32_t src_ch;
+    uint32_t dst_ch;
+    std::vector<uint64_t> src_rows;
+    std::vector<uint64_t> dst_rows;
+};
+
+// Copies KV cache rows between PIM channels through the NPU (MOVIN from the source channel,
+// MOVOUT to the destination channel), so the copy shows up as DRAM traffic on both channels.
+class KVCacheMigrate : public Operation {
+   public:
+    KVCacheMigrate(std::string name, std::vector<KVMigration> migrations);
+
+    std::vector<Ptr<BTensor>> get_outputs(std::vector<Ptr<BTensor>> inputs) override;
+
+    uint64_t get_migrated_bytes();
+
+   private:
+    std::vector<KVMigration> _migrations;
+
+    uint32_t _bursts_per_row;  // # of dram_req_size bursts in a PIM row (all banks in channel)
+    uint32_t _rows_per_tile;
+
+    void calculate_loops();
+    void initialize_tiles();
+    Tile initialize_instructions(KVMigration &migration, uint32_t start, uint32_t end);
+    uint32_t sram_size_needed();
+
+    std::vector<addr_type> get_row_addrs(uint32_t ch, uint64_t row);
+};
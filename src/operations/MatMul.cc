@@ -51,7 +51,9 @@ std::vector<Ptr<BTensor>> MatMul::get_outputs(std::vector<Ptr<BTensor>> inputs)
 
     _outputs.resize(1);
 
+    // (activation, activation), (activation) with weight, or (activation) with weight and bias
     assert((inputs.size() == 2 && _inputs.size() == 2) ||
+           (inputs.size() == 1 && _inputs.size() == 2 && _inputs[1] != nullptr) ||
            (inputs.size() == 1 && _inputs.size() == 3));
 
     for (size_t i = 0; i < inputs.size(); ++i) {
@@ -130,6 +132,8 @@ Tile MatMul::initialize_instructions(uint32_t B, uint32_t M, uint32_t K, uint32_
     addr_type sram_activation_base = SPAD_BASE;
     addr_type sram_weight_base = SPAD_BASE + m_inner * k_inner * _config.precision;
     addr_type sram_accumulation_base = ACCUM_SPAD_BASE;
+    // weight tiles dequantized to precision, after the output tile
+    addr_type sram_dequant_base = ACCUM_SPAD_BASE + m_inner * n_inner * _config.precision;
 
     const uint32_t loop_size = _config.core_width;
 
@@ -142,6 +146,7 @@ Tile MatMul::initialize_instructions(uint32_t B, uint32_t M, uint32_t K, uint32_
         activation_tensor->set_transposed();
         weight_tensor->set_transposed();
     }
+    bool dequant = quantized(_is_transposed ? 0 : 1);
 
     // In MHA, calculating logit score or a uses 3D * 3D matrix multiplications.
     //  for exmaple, (n,t,dk)@(n,dk,t)
@@ -208,6 +213,9 @@ Tile MatMul::initialize_instructions(uint32_t B, uint32_t M, uint32_t K, uint32_
                 addr_type sram_accumulation_offset =
                     sram_accumulation_base +
                     (m_inner_offset * n_inner + n_inner_offset) * _config.precision;
+                addr_type sram_dequant_offset =
+                    sram_dequant_base +
+                    (k_inner_offset * n_inner + n_inner_offset) * _config.precision;
 
                 // -- activation --
                 if (n_inner_offset == 0) {
@@ -296,13 +304,29 @@ Tile MatMul::initialize_instructions(uint32_t B, uint32_t M, uint32_t K, uint32_
                                      weight_tensor->get_dims());
                         assert(0);
                     } else {
+                        // striped weights are loaded from their own addresses
+                        bool striped = _config.weight_striping &&
+                                       weight_tensor->_inners[0]->_buf_type == NPUTensorBufType::WGT;
+                        uint32_t weight_size = weight_addrs.size() * _config.precision;
+                        if (dequant && !striped) weight_addrs = pack_weight_addrs(weight_addrs);
                         tile.instructions.push_back(Instruction{
                             .opcode = Opcode::MOVIN,
                             .dest_addr = sram_weight_offset,
-                            .size = (uint32_t)weight_addrs.size() * _config.precision,
+                            .size = weight_size,
                             .src_addrs = std::move(weight_addrs),
                             .operand_id = _INPUT_OPERAND + 1,
+                            .direct_dram_addr = striped,
                         });
+                        if (dequant) {
+                            tile.instructions.push_back(Instruction{
+                                .opcode = Opcode::DEQUANT_WGT,
+                                .dest_addr = sram_dequant_offset,
+                                .size = weight_size,
+                                .src_addrs = std::vector<addr_type>{sram_weight_offset},
+                                .tile_k = tile_k,
+                                .tile_n = tile_n,
+                            });
+                        }
                     }
                 }
                 // spdlog::info("{} {} {}", activation_tensor->get_dims(),
@@ -321,11 +345,14 @@ Tile MatMul::initialize_instructions(uint32_t B, uint32_t M, uint32_t K, uint32_
                     // what does src_addrs do in computation instructions?
                     // read Core::can_issue_compute.
                     // checks if it's loaded to sram.
-                    .src_addrs = std::vector<addr_type>{sram_activation_offset, sram_weight_offset},
+                    .src_addrs = std::vector<addr_type>{sram_activation_offset,
+                                                        dequant ? sram_dequant_offset
+                                                                : sram_weight_offset},
 
                     .tile_m = tile_m,
                     .tile_k = tile_k,
                     .tile_n = tile_n,
+                    .src_from_accum = dequant,
                 });
                 // -- store --
                 // when iterating inner_loop k times,
@@ -439,5 +466,12 @@ uint32_t MatMul::sram_size_needed() {
         m += _config.core_width - m % _config.core_width;
     }
 
-    return (n * k + k * m + m * n) * _config.precision;
+    // and the dequantized copy of a weight tile next to the output tile
+    uint32_t dequant = quantized(1) ? k * m : quantized(0) ? n * k : 0;
+    return (n * k + k * m + m * n + dequant) * _config.precision;
+}
+
+bool MatMul::quantized(uint32_t input) {
+    auto tensor = std::static_pointer_cast<NPUTensor>(_inputs[input]);
+    return weights_quantized() && tensor->_inners[0]->_buf_type == NPUTensorBufType::WGT;
 }
\ No newline at end of file
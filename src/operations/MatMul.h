@@ -36,4 +36,5 @@ class MatMul : public Operation {
     void initialize_tiles();
     Tile initialize_instructions(uint32_t B, uint32_t N, uint32_t K, uint32_t M, bool should_store);
     uint32_t sram_size_needed();
+    bool quantized(uint32_t input);
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "MoECombine.h"
+
+MoECombine::MoECombine(std::string name, std::vector<std::vector<uint32_t>> expert_rows)
+    : Operation(name), _expert_rows(expert_rows) {}
+
+std::vector<Ptr<BTensor>> MoECombine::get_outputs(std::vector<Ptr<BTensor>> inputs) {
+    set_as_parent_tensor(inputs);
+
+    _inputs.assign(inputs.begin(), inputs.end());
+    auto gate_dims = _inputs.back()->get_dims();
+    assert(gate_dims.size() == 2);
+    _rows = gate_dims[0];
+    _top_k = gate_dims[1];
+    _embd = _inputs[0]->get_dims()[1];
+
+    _sources.assign(_rows, {});
+    uint32_t input = 0;
+    for (auto &rows : _expert_rows) {
+        if (rows.empty()) continue;
+        assert(input + 1 < _inputs.size() && _inputs[input]->get_dims()[0] == rows.size());
+        for (uint32_t row = 0; row < rows.size(); row++)
+            _sources[rows[row]].push_back({input, row});
+        input++;
+    }
+    assert(input + 1 == _inputs.size());
+
+    _outputs.resize(1);
+    _outputs[0] = std::make_shared<NPUTensor>(
+        _name + "_output", std::vector<uint32_t>{_rows, _embd}, NPUTensorBufType::ACT, false);
+
+    calculate_loops();
+    initialize_tiles();
+
+    return _outputs;
+}
+
+void MoECombine::initialize_tiles() {
+    for (uint32_t start = 0; start < _rows; start += _rows_per_tile)
+        _tiles.push_back(initialize_instructions(start, MIN(start + _rows_per_tile, _rows)));
+}
+
+// rows [start, end) of the output
+//  MOVIN  : gates of the row, and the row of each of its experts -> spad
+//  ADD    : gate-weighted sum, a multiply-add per expert and element
+//  MOVOUT : accumulator -> output row
+Tile MoECombine::initialize_instructions(uint32_t start, uint32_t end) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = start / _rows_per_tile,
+        .K = 0,
+        .accum = false,
+    };
+
+    auto gate_tensor = std::static_pointer_cast<NPUTensor>(_inputs.back());
+    auto output_tensor = std::static_pointer_cast<NPUTensor>(_outputs[0]);
+    uint32_t row_size = (_top_k * _embd + _top_k) * _config.precision;
+
+    for (uint32_t row = start; row < end; ++row) {
+        addr_type sram_offset = SPAD_BASE + (row - start) * row_size;
+        addr_type accum_offset = ACCUM_SPAD_BASE + (row - start) * _embd * _config.precision;
+
+        auto gate_addrs = gate_tensor->get_row_addrs(row);
+        std::vector<addr_type> sram_addrs{sram_offset};
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVIN,
+            .dest_addr = sram_offset,
+            .size = (uint32_t)gate_addrs.size() * _config.precision,
+            .src_addrs = std::move(gate_addrs),
+            .operand_id = _INPUT_OPERAND,
+        });
+        addr_type sram_expert_offset = sram_offset + _top_k * _config.precision;
+        for (auto [input, input_row] : _sources[row]) {
+            auto expert_tensor = std::static_pointer_cast<NPUTensor>(_inputs[input]);
+            auto expert_addrs = expert_tensor->get_row_addrs(input_row);
+            sram_addrs.push_back(sram_expert_offset);
+            tile.instructions.push_back(Instruction{
+                .opcode = Opcode::MOVIN,
+                .dest_addr = sram_expert_offset,
+                .size = (uint32_t)expert_addrs.size() * _config.precision,
+                .src_addrs = std::move(expert_addrs),
+                .operand_id = _INPUT_OPERAND,
+            });
+            sram_expert_offset += _embd * _config.precision;
+        }
+
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::ADD,
+            .dest_addr = accum_offset,
+            .size = (uint32_t)_sources[row].size() * _embd,
+            .src_addrs = std::move(sram_addrs),
+        });
+
+        auto output_addrs = output_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = accum_offset,
+            .size = (uint32_t)output_addrs.size() * _config.precision,
+            .src_addrs = std::move(output_addrs),
+            .operand_id = _OUTPUT_OPERAND,
+        });
+    }
+
+    return tile;
+}
+
+void MoECombine::calculate_loops() {
+    uint32_t row_size = (_top_k * _embd + _top_k) * _config.precision;
+    _rows_per_tile = MAX((_config.spad_size KB / 2) / row_size, 1);
+}
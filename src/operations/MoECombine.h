@@ -0,0 +1,26 @@
+#pragma once
+#include "../tensor/NPUTensor.h"
+#include "Operation.h"
+
+// Sums the expert outputs of each row of an MoE FFN weighted by its gates: the (rows,E) output
+// of every expert that got any row, in expert order, and the (N,k) gates of MoEDispatch ->
+// (N,E). expert_rows as in MoEDispatch.
+class MoECombine : public Operation {
+   public:
+    MoECombine(std::string name, std::vector<std::vector<uint32_t>> expert_rows);
+
+    std::vector<Ptr<BTensor>> get_outputs(std::vector<Ptr<BTensor>> inputs) override;
+
+   private:
+    std::vector<std::vector<uint32_t>> _expert_rows;
+    // per row: (index in _inputs, row of that input) of each of its experts
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> _sources;
+    uint32_t _rows;
+    uint32_t _embd;
+    uint32_t _top_k;
+    uint32_t _rows_per_tile;
+
+    void calculate_loops();
+    void initialize_tiles();
+    Tile initialize_instructions(uint32_t start, uint32_t end);
+};
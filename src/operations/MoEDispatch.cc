@@ -0,0 +1,145 @@
+#include "MoEDispatch.h"
+
+MoEDispatch::MoEDispatch(std::string name, std::vector<std::vector<uint32_t>> expert_rows)
+    : Operation(name), _expert_rows(expert_rows) {
+    _inputs.resize(2);
+}
+
+std::vector<Ptr<BTensor>> MoEDispatch::get_outputs(std::vector<Ptr<BTensor>> inputs) {
+    set_as_parent_tensor(inputs);
+
+    assert(inputs.size() == 2);
+    _inputs.assign(inputs.begin(), inputs.end());
+
+    auto input_dims = _inputs[0]->get_dims();
+    auto logit_dims = _inputs[1]->get_dims();
+    assert(input_dims.size() == 2 && logit_dims.size() == 2);
+    assert(input_dims[0] == logit_dims[0] && logit_dims[1] == _expert_rows.size());
+    _rows = input_dims[0];
+    _embd = input_dims[1];
+    _n_experts = logit_dims[1];
+
+    std::vector<uint32_t> experts_per_row(_rows, 0);
+    for (uint32_t e = 0; e < _n_experts; e++) {
+        if (_expert_rows[e].empty()) continue;
+        uint32_t output = _outputs.size();
+        _outputs.push_back(std::make_shared<NPUTensor>(
+            _name + "_output" + std::to_string(e),
+            std::vector<uint32_t>{(uint32_t)_expert_rows[e].size(), _embd}, NPUTensorBufType::ACT,
+            false));
+        for (uint32_t row = 0; row < _expert_rows[e].size(); row++) {
+            assert(_expert_rows[e][row] < _rows);
+            _copies.push_back(Copy{.output = output, .row = row, .source = _expert_rows[e][row]});
+            experts_per_row[_expert_rows[e][row]]++;
+        }
+    }
+    _top_k = *std::max_element(experts_per_row.begin(), experts_per_row.end());
+    _outputs.push_back(std::make_shared<NPUTensor>(_name + "_gates",
+                                                   std::vector<uint32_t>{_rows, _top_k},
+                                                   NPUTensorBufType::ACT, false));
+
+    calculate_loops();
+    initialize_tiles();
+
+    return _outputs;
+}
+
+void MoEDispatch::initialize_tiles() {
+    for (uint32_t start = 0; start < _rows; start += _rows_per_tile)
+        _tiles.push_back(gate_instructions(start, MIN(start + _rows_per_tile, _rows)));
+    for (uint32_t start = 0; start < _copies.size(); start += _rows_per_tile)
+        _tiles.push_back(
+            gather_instructions(start, MIN(start + _rows_per_tile, (uint32_t)_copies.size())));
+}
+
+// rows [start, end) of the router logits
+//  MOVIN   : logits of the row -> spad
+//  SOFTMAX : gates of the row; the top-k of a handful of experts is read off them
+//  MOVOUT  : top-k gates -> gates row
+Tile MoEDispatch::gate_instructions(uint32_t start, uint32_t end) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = (uint32_t)_tiles.size(),
+        .K = 0,
+        .accum = false,
+    };
+
+    auto logit_tensor = std::static_pointer_cast<NPUTensor>(_inputs[1]);
+    auto gate_tensor = std::static_pointer_cast<NPUTensor>(_outputs.back());
+    for (uint32_t row = start; row < end; ++row) {
+        addr_type sram_offset = SPAD_BASE + (row - start) * _n_experts * _config.precision;
+        addr_type accum_offset = ACCUM_SPAD_BASE + (row - start) * _n_experts * _config.precision;
+
+        auto logit_addrs = logit_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVIN,
+            .dest_addr = sram_offset,
+            .size = (uint32_t)logit_addrs.size() * _config.precision,
+            .src_addrs = std::move(logit_addrs),
+            .operand_id = _INPUT_OPERAND + 1,
+        });
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::SOFTMAX,
+            .dest_addr = accum_offset,
+            .size = _n_experts,
+            .src_addrs = std::vector<addr_type>{sram_offset},
+        });
+
+        auto gate_addrs = gate_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = accum_offset,
+            .size = (uint32_t)gate_addrs.size() * _config.precision,
+            .src_addrs = std::move(gate_addrs),
+            .operand_id = _OUTPUT_OPERAND,
+        });
+    }
+    return tile;
+}
+
+// copies [start, end)
+//  MOVIN  : input row -> spad
+//  MOVOUT : spad -> row of the expert input
+Tile MoEDispatch::gather_instructions(uint32_t start, uint32_t end) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = (uint32_t)_tiles.size(),
+        .K = 0,
+        .accum = false,
+    };
+
+    auto input_tensor = std::static_pointer_cast<NPUTensor>(_inputs[0]);
+    for (uint32_t i = start; i < end; ++i) {
+        auto &copy = _copies[i];
+        addr_type sram_offset = SPAD_BASE + (i - start) * _embd * _config.precision;
+
+        auto input_addrs = input_tensor->get_row_addrs(copy.source);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVIN,
+            .dest_addr = sram_offset,
+            .size = (uint32_t)input_addrs.size() * _config.precision,
+            .src_addrs = std::move(input_addrs),
+            .operand_id = _INPUT_OPERAND,
+        });
+
+        auto output_tensor = std::static_pointer_cast<NPUTensor>(_outputs[copy.output]);
+        auto output_addrs = output_tensor->get_row_addrs(copy.row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = sram_offset,
+            .size = (uint32_t)output_addrs.size() * _config.precision,
+            .src_addrs = std::move(output_addrs),
+            .operand_id = _OUTPUT_OPERAND,
+        });
+    }
+    return tile;
+}
+
+void MoEDispatch::calculate_loops() {
+    uint32_t row_size = MAX(_embd, _n_experts) * _config.precision;
+    _rows_per_tile = MAX((_config.spad_size KB / 2) / row_size, 1);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../tensor/NPUTensor.h"
+#include "Operation.h"
+
+// Routes the rows of an MoE FFN to its experts: (N,E) activations and (N,X) router logits ->
+// a (rows,E) input per expert that gets any row, in expert order, then the (N,k) gates.
+// expert_rows[e] lists the rows routed to expert e (see MoERouter).
+//   gate:   softmax over the router logits of each row, the top-k gates are read off it
+//   gather: each row is copied to the input of every expert it is routed to
+class MoEDispatch : public Operation {
+   public:
+    MoEDispatch(std::string name, std::vector<std::vector<uint32_t>> expert_rows);
+
+    std::vector<Ptr<BTensor>> get_outputs(std::vector<Ptr<BTensor>> inputs) override;
+
+   private:
+    typedef struct {
+        uint32_t output;  // index in _outputs
+        uint32_t row;     // of the output
+        uint32_t source;  // row of the input
+    } Copy;
+
+    std::vector<std::vector<uint32_t>> _expert_rows;
+    std::vector<Copy> _copies;
+    uint32_t _rows;
+    uint32_t _embd;
+    uint32_t _n_experts;
+    uint32_t _top_k;
+    uint32_t _rows_per_tile;
+
+    void calculate_loops();
+    void initialize_tiles();
+    Tile gate_instructions(uint32_t start, uint32_t end);
+    Tile gather_instructions(uint32_t start, uint32_t end);
+};
@@ -239,6 +239,21 @@ Tile NeuPIMSAttend::initialize_instructions(int start, int end) {
                         sram_readres_addrs[ti].push_back(sram_addr);
                 }
             }
+            if (kv_quantized()) {
+                // outputs over a quantized value cache, scaled back to precision
+                for (int ti = 0; ti < _tiles_per_chunk; ++ti) {
+                    auto sram_dequant_entry = allocate_sram_addr(chunks * _banks_per_channel, true);
+                    tile.instructions.push_back(Instruction{
+                        .opcode = Opcode::DEQUANT_KV,
+                        .dest_addr = sram_dequant_entry.first,
+                        .size = sram_dequant_entry.second,
+                        .src_addrs = sram_readres_addrs[ti],
+                        .tile_k = chunks,
+                        .tile_n = _banks_per_channel,
+                    });
+                    sram_readres_addrs[ti] = std::vector<addr_type>{sram_dequant_entry.first};
+                }
+            }
             if (chunks > 1) {
                 for (int ti = 0; ti < _tiles_per_chunk; ++ti) {
                     assert(sram_readres_addrs[ti].size() == chunks);
@@ -251,6 +266,7 @@ Tile NeuPIMSAttend::initialize_instructions(int start, int end) {
                         .dest_addr = sram_acc_entry.first,
                         .size = sram_acc_entry.second,
                         .src_addrs = sram_readres_addrs[ti],
+                        .src_from_accum = kv_quantized(),
                     });
                     tile.instructions.push_back(Instruction{
                         .opcode = Opcode::MOVOUT,
@@ -272,14 +288,14 @@ Tile NeuPIMSAttend::initialize_instructions(int start, int end) {
 void NeuPIMSAttend::calculate_loops() {
     // assert(sram_size_needed() < _config.spad_size KB / 2);
 
-    uint32_t E = _config.model_n_embd / _config.n_tp;
+    uint32_t E = _nh * _dk;
 
     // memory spec
-    _page_size = _config.dram_page_size / _config.precision;
+    _page_size = kv_page_elements(_config);
     _banks_per_channel = _config.dram_banks_per_ch;
 
     _tiles_per_chunk = ceil((double)_dk / _banks_per_channel);
-    _datas_per_comp_cmd = _config.pim_comp_coverage;
+    _datas_per_comp_cmd = kv_comp_coverage(_config);
 
     // npu tiling
     int heads_per_dram_page = floor((double)_page_size / _dk);
@@ -298,7 +314,8 @@ void NeuPIMSAttend::calculate_loops() {
 
         if (q_len == 1) {
             // incremental phase
-            need_sram_for_req = (seq_len + chunks * _dk) * _nh * _config.precision;
+            uint32_t dequant = kv_quantized() ? chunks * _dk : 0;
+            need_sram_for_req = (seq_len + chunks * _dk + dequant) * _nh * _config.precision;
             sram_needs += need_sram_for_req;
         } else {
             // initiation phase
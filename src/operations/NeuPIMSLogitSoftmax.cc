@@ -272,6 +272,19 @@ Tile NeuPIMSLogitSoftmax::initialize_instructions(int start, int end) {
         for (int hi = 0; hi < _nh; hi++) {
             assert(sram_readres_addrs[hi].size() == tiles_per_chunk);
             uint32_t column_height = key->_seq_len;  // tiles_per_chunk * banks_per_channel;
+            if (kv_quantized()) {
+                // logits over a quantized key cache, scaled back to precision
+                auto sram_dequant_entry = allocate_sram_addr(column_height, true);
+                tile.instructions.push_back(Instruction{
+                    .opcode = Opcode::DEQUANT_KV,
+                    .dest_addr = sram_dequant_entry.first,
+                    .size = sram_dequant_entry.second,
+                    .src_addrs = sram_readres_addrs[hi],
+                    .tile_k = 1,
+                    .tile_n = column_height,
+                });
+                sram_readres_addrs[hi] = std::vector<addr_type>{sram_dequant_entry.first};
+            }
             std::pair<addr_type, uint32_t> sram_acc_entry = allocate_sram_addr(column_height, true);
 
             // spdlog::info("col height: {}, seq_len: {}", column_height, key->_seq_len);
@@ -280,6 +293,7 @@ Tile NeuPIMSLogitSoftmax::initialize_instructions(int start, int end) {
                 .dest_addr = sram_acc_entry.first,
                 .size = sram_acc_entry.second,
                 .src_addrs = sram_readres_addrs[hi],
+                .src_from_accum = kv_quantized(),
             });
             tile.instructions.push_back(Instruction{
                 .opcode = Opcode::MOVOUT,
@@ -303,11 +317,11 @@ Tile NeuPIMSLogitSoftmax::initialize_instructions(int start, int end) {
 void NeuPIMSLogitSoftmax::calculate_loops() {
     assert(sram_size_needed() < _config.spad_size KB / 2);
 
-    uint32_t E = _config.model_n_embd / _config.n_tp;
+    uint32_t E = _E;
     // dram row capacity (unit: number of parameter)
-    uint32_t page_size = _config.dram_page_size / _config.precision;
+    uint32_t page_size = kv_page_elements(_config);
     uint32_t banks_per_channel = _config.dram_banks_per_ch;
-    uint32_t datas_per_comp_cmd = _config.pim_comp_coverage;
+    uint32_t datas_per_comp_cmd = kv_comp_coverage(_config);
 
     _chunks = ceil((double)E / page_size);            // # of gwrite
     _heads_per_tile = ceil((double)page_size / _dk);  // # of readres
@@ -328,7 +342,7 @@ uint32_t NeuPIMSLogitSoftmax::sram_size_needed() {
 
     int sram_size = _config.spad_size KB / _config.precision;
 
-    int dram_page_size = _config.dram_page_size / _config.precision;
+    int dram_page_size = kv_page_elements(_config);
     int heads_per_dram_page = floor((double)dram_page_size / _dk);
     int heads_space_in_page = heads_per_dram_page * _dk;
     int chunks = ceil((double)_E / heads_space_in_page);
@@ -347,7 +361,8 @@ uint32_t NeuPIMSLogitSoftmax::sram_size_needed() {
 
         if (q_len == 1) {
             // incremental phase
-            need_sram_for_req = (2 * seq_len + _dk) * _nh * _config.precision;
+            uint32_t dequant = kv_quantized() ? seq_len : 0;
+            need_sram_for_req = (2 * seq_len + _dk + dequant) * _nh * _config.precision;
             sram_needs += need_sram_for_req;
         } else {
             // initiation phase
@@ -358,7 +373,7 @@ uint32_t NeuPIMSLogitSoftmax::sram_size_needed() {
         }
 
         if (sram_needs > sram_size) {
-            spdlog::info("---");
+            SPDLOG_DEBUG("---");
             assert(i > 0);
             _req_idxs.push_back(i - 1);
             sram_needs = need_sram_for_req;
@@ -2,12 +2,12 @@
 
 #include <memory>
 
-SimulationConfig Operation::_config;
+thread_local SimulationConfig Operation::_config;
 
 Operation::Operation(MappingTable mapping_table) {
     _id = generate_id();
     _finish = false;
-    spdlog::trace("Node {} op_type {}", _name.c_str(), _optype.c_str());
+    SPDLOG_TRACE("Node {} op_type {}", _name.c_str(), _optype.c_str());
     if (_config.layout == "NCHW") {
         Ndim = 0;
         Cdim = 1;
@@ -51,6 +51,16 @@ std::pair<addr_type, uint32_t> Operation::allocate_sram_addr(uint32_t size, bool
     return std::make_pair(spad_addr, size_in_byte);
 }
 
+// The DRAM accesses of a MOVIN scale with its address count, so a weight tile stored at
+// weight_dtype loads as weight_bits / (8 * precision) of its precision addresses. Striped
+// weights need no packing, their addresses are already at packed offsets.
+std::vector<addr_type> Operation::pack_weight_addrs(std::vector<addr_type> addrs) {
+    uint64_t packed = ((uint64_t)addrs.size() * _config.weight_bits + 8 * _config.precision - 1) /
+                      (8 * _config.precision);
+    addrs.resize(packed);
+    return addrs;
+}
+
 std::vector<Ptr<BTensor>> Operation::get_outputs(std::vector<Ptr<BTensor>> inputs) {
     spdlog::info("parent");
 
@@ -90,13 +100,13 @@ void Operation::set_finish() {
         output->set_produced();
     }
     _finish = true;
-    spdlog::trace("layer {} finish", _name.c_str());
+    SPDLOG_TRACE("layer {} finish", _name.c_str());
 }
 
 std::vector<std::shared_ptr<Operation>> Operation::get_child_nodes() {
     std::vector<std::shared_ptr<Operation>> result;
     for (auto output : _outputs) {
-        spdlog::trace("num child nodes {}", output->num_child_nodes());
+        SPDLOG_TRACE("num child nodes {}", output->num_child_nodes());
         for (auto child : output->get_child_nodes()) {
             result.push_back(child);
         }
@@ -109,8 +119,8 @@ bool Operation::check_executable() {
     bool result = true;
     for (auto input : _inputs) {
         result = result && input->get_produced();
-        spdlog::trace("Layer {}: Input {} Produced {}", _name.c_str(), input->get_name().c_str(),
-                      input->get_produced());
+        SPDLOG_TRACE("Layer {}: Input {} Produced {}", _name.c_str(), input->get_name().c_str(),
+                     input->get_produced());
     }
     return result;
 }
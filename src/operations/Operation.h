@@ -63,7 +63,7 @@ class Operation : public std::enable_shared_from_this<Operation> {
     uint32_t _id;
     std::string _name;
     std::string _optype;
-    static SimulationConfig _config;
+    static thread_local SimulationConfig _config;
     std::vector<Ptr<BTensor>> _inputs;
     std::vector<Ptr<BTensor>> _outputs;
     std::map<std::string, std::string> _attributes;
@@ -90,4 +90,7 @@ class Operation : public std::enable_shared_from_this<Operation> {
     addr_type _acc_spad_addr;
 
     std::pair<addr_type, uint32_t> allocate_sram_addr(uint32_t size, bool accum);
+    bool weights_quantized() { return _config.weight_bits < 8 * _config.precision; }
+    bool kv_quantized() { return _config.kv_bits < 8 * _config.precision; }
+    std::vector<addr_type> pack_weight_addrs(std::vector<addr_type> addrs);
 };
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "Sampling.h"
+
+Sampling::Sampling(std::string name) : Operation(name) { _inputs.resize(1); }
+
+std::vector<Ptr<BTensor>> Sampling::get_outputs(std::vector<Ptr<BTensor>> inputs) {
+    set_as_parent_tensor(inputs);
+
+    _outputs.resize(1);
+
+    assert(inputs.size() == 1);
+    _inputs[0] = inputs[0];
+
+    _input_dim = inputs[0]->get_dims();
+    assert(_input_dim.size() == 2);
+    _outputs[0] = std::make_shared<NPUTensor>(
+        _name + "_output", std::vector<uint32_t>{_input_dim[0], 1}, NPUTensorBufType::ACT, false);
+
+    calculate_loops();
+    initialize_tiles();
+
+    return _outputs;
+}
+
+void Sampling::initialize_tiles() {
+    for (uint32_t N = 0; N < _outer_loop[0]; ++N) {
+        _tiles.push_back(initialize_instructions(N));
+    }
+}
+
+Tile Sampling::initialize_instructions(uint32_t N) {
+    auto tile = Tile{
+        .status = Tile::Status::INITIALIZED,
+        .optype = get_name(),
+        .operation_id = _id,
+        .batch = N,
+        .K = 0,
+        .accum = false,
+    };
+
+    uint32_t vocab_size = _input_dim.back();
+
+    auto n_inner = _inner_loop[0];
+    auto n_outer_offset = n_inner * N;
+
+    addr_type sram_activation_base = SPAD_BASE;
+    addr_type sram_accumulation_base = ACCUM_SPAD_BASE;
+
+    auto logit_tensor = std::static_pointer_cast<NPUTensor>(_inputs[0]);
+    auto output_tensor = std::static_pointer_cast<NPUTensor>(_outputs[0]);
+
+    for (uint32_t n_inner_offset = 0; n_inner_offset < n_inner; ++n_inner_offset) {
+        uint32_t row = n_outer_offset + n_inner_offset;
+        if (row >= _input_dim[0]) break;
+        addr_type sram_activation_offset =
+            sram_activation_base + n_inner_offset * vocab_size * _config.precision;
+        addr_type sram_accumulation_offset =
+            sram_accumulation_base + n_inner_offset * _config.precision;
+
+        // -- logits --
+        auto logit_addrs = logit_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVIN,
+            .dest_addr = sram_activation_offset,
+            .size = (uint32_t)logit_addrs.size() * _config.precision,
+            .src_addrs = std::move(logit_addrs),
+            .operand_id = _INPUT_OPERAND,
+        });
+
+        // -- compute --
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::SAMPLE,
+            .dest_addr = sram_accumulation_offset,
+            .size = vocab_size,
+            .src_addrs = std::vector<addr_type>{sram_activation_offset},
+        });
+
+        // -- token id --
+        auto output_addrs = output_tensor->get_row_addrs(row);
+        tile.instructions.push_back(Instruction{
+            .opcode = Opcode::MOVOUT,
+            .dest_addr = sram_accumulation_offset,
+            .size = (uint32_t)output_addrs.size() * _config.precision,
+            .src_addrs = std::move(output_addrs),
+            .operand_id = _OUTPUT_OPERAND,
+        });
+    }
+
+    return tile;
+}
+
+void Sampling::calculate_loops() {
+    _inner_loop.assign(1, _input_dim[0]);
+    _outer_loop.assign(1, 1);
+
+    while (sram_size_needed() > _config.spad_size KB / 2 && _inner_loop[0] > 1) {
+        _inner_loop[0] = (_inner_loop[0] & 1) + (_inner_loop[0] >> 1);
+    }
+    _outer_loop[0] = (_input_dim[0] + _inner_loop[0] - 1) / _inner_loop[0];
+}
+
+uint32_t Sampling::sram_size_needed() {
+    auto n = _inner_loop[0];
+    auto k = _input_dim.back();
+    if (k % _config.vector_core_width != 0) {
+        k += _config.vector_core_width - k % _config.vector_core_width;
+    }
+
+    return n * (k + 1) * _config.precision;
+}
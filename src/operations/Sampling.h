@@ -0,0 +1,23 @@
+#pragma once
+#include "../tensor/NPUTensor.h"
+#include "Operation.h"
+
+// Picks the next token of each row from its logits: (N,V) -> (N,1).
+// Top-k / top-p selection runs on the vector unit (see VectorUnit::get_sample_phases).
+class Sampling : public Operation {
+   public:
+    Sampling(std::string name);
+
+    std::vector<Ptr<BTensor>> get_outputs(std::vector<Ptr<BTensor>> inputs) override;
+
+   private:
+    std::vector<uint32_t> _input_dim;
+
+    std::vector<uint32_t> _inner_loop;
+    std::vector<uint32_t> _outer_loop;
+
+    void calculate_loops();
+    void initialize_tiles();
+    Tile initialize_instructions(uint32_t N);
+    uint32_t sram_size_needed();
+};
@@ -0,0 +1,118 @@
+#include "AdmissionPolicy.h"
+
+#include <functional>
+#include <random>
+
+std::unique_ptr<AdmissionPolicy> AdmissionPolicy::create(SimulationConfig config) {
+    if (config.scheduler_type == "sjf")
+        return std::make_unique<SJFPolicy>(config.sjf_prediction_error);
+    if (config.scheduler_type == "edf") return std::make_unique<EDFPolicy>();
+    if (config.scheduler_type == "fair") return std::make_unique<FairSharePolicy>();
+    return std::make_unique<FCFSPolicy>();
+}
+
+void AdmissionPolicy::sort_by(std::vector<Ptr<InferRequest>> &waiting,
+                              std::function<double(const Ptr<InferRequest> &)> key) {
+    std::vector<std::pair<double, Ptr<InferRequest>>> keyed;
+    for (auto &request : waiting) keyed.push_back({key(request), request});
+    std::stable_sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) {
+        auto &x = a.second;
+        auto &y = b.second;
+        if (x->priority != y->priority) return x->priority > y->priority;
+        if (a.first != b.first) return a.first < b.first;
+        if (x->arrival_cycle != y->arrival_cycle) return x->arrival_cycle < y->arrival_cycle;
+        return x->id < y->id;
+    });
+    for (size_t i = 0; i < waiting.size(); i++) waiting[i] = keyed[i].second;
+}
+
+void FCFSPolicy::order(std::vector<Ptr<InferRequest>> &waiting,
+                       const std::vector<Ptr<InferRequest>> & /*running*/,
+                       cycle_type /*cycle*/) {
+    sort_by(waiting, [](const Ptr<InferRequest> &) { return 0; });
+}
+
+double SJFPolicy::predict(const Ptr<InferRequest> &request) {
+    auto it = _predictions.find(request->id);
+    if (it != _predictions.end()) return it->second;
+    double prediction = request->output_size;
+    if (_prediction_error > 0) {
+        std::mt19937_64 gen(request->id);
+        std::normal_distribution<double> error(0, _prediction_error);
+        prediction *= std::exp(error(gen));
+    }
+    return _predictions[request->id] = prediction;
+}
+
+void SJFPolicy::order(std::vector<Ptr<InferRequest>> &waiting,
+                      const std::vector<Ptr<InferRequest>> & /*running*/,
+                      cycle_type /*cycle*/) {
+    sort_by(waiting, [this](const Ptr<InferRequest> &request) {
+        return predict(request) - request->generated;
+    });
+}
+
+void EDFPolicy::order(std::vector<Ptr<InferRequest>> &waiting,
+                      const std::vector<Ptr<InferRequest>> & /*running*/,
+                      cycle_type /*cycle*/) {
+    sort_by(waiting, [](const Ptr<InferRequest> &request) {
+        return (double)request->arrival_cycle + request->ttft_slo +
+               (double)request->generated * request->tpot_slo;
+    });
+}
+
+void FairSharePolicy::order(std::vector<Ptr<InferRequest>> &waiting,
+                            const std::vector<Ptr<InferRequest>> &running,
+                            cycle_type /*cycle*/) {
+    std::set<uint64_t> busy;
+    for (auto &request : running) busy.insert(request->tenant);
+    for (auto &request : waiting) busy.insert(request->tenant);
+
+    // a returning tenant does not get credit for the time it was idle
+    uint64_t least = UINT64_MAX;
+    for (auto tenant : _busy) least = MIN(least, _service[tenant]);
+    for (auto tenant : busy) {
+        if (_busy.find(tenant) == _busy.end() && least != UINT64_MAX)
+            _service[tenant] = MAX(_service[tenant], least);
+    }
+    _busy = busy;
+
+    // per-tenant FIFO (priority first), merged by the service each admission would add
+    std::map<uint64_t, std::deque<Ptr<InferRequest>>> queues;
+    sort_by(waiting, [](const Ptr<InferRequest> &) { return 0; });
+    for (auto &request : waiting) queues[request->tenant].push_back(request);
+
+    std::map<uint64_t, uint64_t> service;
+    for (auto &[tenant, queue] : queues) service[tenant] = _service[tenant];
+    waiting.clear();
+    while (!queues.empty()) {
+        auto next = queues.begin();
+        for (auto it = queues.begin(); it != queues.end(); it++) {
+            auto &a = it->second.front();
+            auto &b = next->second.front();
+            if (a->priority > b->priority ||
+                (a->priority == b->priority && service[it->first] < service[next->first]))
+                next = it;
+        }
+        auto request = next->second.front();
+        next->second.pop_front();
+        service[next->first] += request->input_size;
+        waiting.push_back(request);
+        if (next->second.empty()) queues.erase(next);
+    }
+}
+
+void FairSharePolicy::on_admit(Ptr<InferRequest> request) {
+    // the prompt, unless it is a readmission
+    if (request->generated == 0 || request->kv_remote)
+        _service[request->tenant] += request->input_size;
+}
+
+void FairSharePolicy::on_token(Ptr<InferRequest> request) { _service[request->tenant]++; }
+
+json FairSharePolicy::checkpoint() { return {{"service", _service}, {"busy", _busy}}; }
+
+void FairSharePolicy::restore(json state) {
+    _service = state["service"].get<std::map<uint64_t, uint64_t>>();
+    _busy = state["busy"].get<std::set<uint64_t>>();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "../Common.h"
+
+// Order in which Scheduler::allocate_requests admits waiting requests (scheduler config):
+//   simple, fcfs: arrival order
+//   sjf:          shortest predicted remaining output first. The prediction is the trace output
+//                 length times exp(N(0, sjf_prediction_error)), fixed per request
+//   edf:          earliest deadline first, the deadline of the next token being
+//                 arrival + ttft_slo + generated * tpot_slo
+//   fair:         tenants take turns by the tokens they were served (virtual token counter):
+//                 the tenant with the least service goes next, FIFO within a tenant. A tenant
+//                 that comes back is lifted to the least service of the busy tenants
+// Higher priority goes first under every policy. Admission stops at max_batch_size running
+// requests or max_active_reqs requests holding a KV cache.
+class AdmissionPolicy {
+   public:
+    static std::unique_ptr<AdmissionPolicy> create(SimulationConfig config);
+    virtual ~AdmissionPolicy() = default;
+
+    // sorts waiting, the first is admitted first
+    virtual void order(std::vector<Ptr<InferRequest>> &waiting,
+                       const std::vector<Ptr<InferRequest>> &running, cycle_type cycle) = 0;
+    virtual void on_admit(Ptr<InferRequest> /*request*/) {}
+    virtual void on_token(Ptr<InferRequest> /*request*/) {}
+
+    virtual json checkpoint() { return json::object(); }
+    virtual void restore(json /*state*/) {}
+
+   protected:
+    // stable sort by (-priority, key, arrival, id)
+    void sort_by(std::vector<Ptr<InferRequest>> &waiting,
+                 std::function<double(const Ptr<InferRequest> &)> key);
+};
+
+class FCFSPolicy : public AdmissionPolicy {
+   public:
+    void order(std::vector<Ptr<InferRequest>> &waiting,
+               const std::vector<Ptr<InferRequest>> &running, cycle_type cycle) override;
+};
+
+class SJFPolicy : public AdmissionPolicy {
+   public:
+    SJFPolicy(double prediction_error) : _prediction_error(prediction_error) {}
+    void order(std::vector<Ptr<InferRequest>> &waiting,
+               const std::vector<Ptr<InferRequest>> &running, cycle_type cycle) override;
+
+   private:
+    double _prediction_error;
+    std::map<uint32_t, double> _predictions;  // request id -> predicted output tokens
+    double predict(const Ptr<InferRequest> &request);
+};
+
+class EDFPolicy : public AdmissionPolicy {
+   public:
+    void order(std::vector<Ptr<InferRequest>> &waiting,
+               const std::vector<Ptr<InferRequest>> &running, cycle_type cycle) override;
+};
+
+class FairSharePolicy : public AdmissionPolicy {
+   public:
+    void order(std::vector<Ptr<InferRequest>> &waiting,
+               const std::vector<Ptr<InferRequest>> &running, cycle_type cycle) override;
+    void on_admit(Ptr<InferRequest> request) override;
+    void on_token(Ptr<InferRequest> request) override;
+
+    json checkpoint() override;
+    void restore(json state) override;
+
+   private:
+    std::map<uint64_t, uint64_t> _service;  // tenant -> prompt and generated tokens served
+    std::set<uint64_t> _busy;               // tenants with requests at the last order()
+};
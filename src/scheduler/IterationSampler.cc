@@ -0,0 +1,120 @@
+#include "IterationSampler.h"
+
+#include <cmath>
+
+IterationSampler::IterationSampler(SimulationConfig config)
+    : _detailed_iters(config.sampling_detailed_iters),
+      _seq_bin(config.sampling_seq_bin),
+      _batch_bin(config.sampling_batch_bin) {
+    ast(_seq_bin > 0);
+    ast(_batch_bin > 0);
+}
+
+// "bs<batch bin>" followed by "/<token bin>x<# channels>" for every non-empty bin
+std::string IterationSampler::cluster_of(
+    const std::vector<std::vector<Ptr<InferRequest>>> &channel_requests) {
+    uint32_t batch_size = 0;
+    std::map<uint32_t, uint32_t> histogram;  // token bin -> # channels
+    for (auto &requests : channel_requests) {
+        uint64_t tokens = 0;
+        for (auto &request : requests) tokens += request->input_size + request->generated;
+        batch_size += requests.size();
+        histogram[tokens / _seq_bin]++;
+    }
+
+    std::string cluster = "bs" + std::to_string(batch_size / _batch_bin);
+    for (auto &[bin, channels] : histogram)
+        cluster += "/" + std::to_string(bin) + "x" + std::to_string(channels);
+    return cluster;
+}
+
+bool IterationSampler::should_simulate(std::string cluster) {
+    return _clusters[cluster].detailed.size() < _detailed_iters;
+}
+
+void IterationSampler::record_detailed(std::string cluster, cycle_type cycles) {
+    _clusters[cluster].detailed.push_back(cycles);
+}
+
+void IterationSampler::record_skipped(std::string cluster) { _clusters[cluster].skipped++; }
+
+json IterationSampler::checkpoint() {
+    json state = json::object();
+    for (auto &[name, cluster] : _clusters)
+        state[name] = {{"detailed", cluster.detailed}, {"skipped", cluster.skipped}};
+    return state;
+}
+
+void IterationSampler::restore(json state) {
+    _clusters.clear();
+    for (auto &[name, cluster] : state.items()) {
+        _clusters[name] = Cluster{.detailed = cluster["detailed"].get<std::vector<cycle_type>>(),
+                                  .skipped = cluster["skipped"]};
+    }
+}
+
+double IterationSampler::mean(const Cluster &cluster) {
+    if (cluster.detailed.empty()) return 0;
+    double sum = 0;
+    for (auto cycles : cluster.detailed) sum += cycles;
+    return sum / cluster.detailed.size();
+}
+
+double IterationSampler::variance(const Cluster &cluster) {
+    uint32_t n = cluster.detailed.size();
+    if (n < 2) return 0;
+    double avg = mean(cluster);
+    double sum = 0;
+    for (auto cycles : cluster.detailed) sum += (cycles - avg) * (cycles - avg);
+    return sum / (n - 1);
+}
+
+double IterationSampler::estimate(const Cluster &cluster) {
+    double detailed = 0;
+    for (auto cycles : cluster.detailed) detailed += cycles;
+    return detailed + cluster.skipped * mean(cluster);
+}
+
+// only the fast-forwarded iterations are uncertain: Var(skipped * mean) = skipped^2 * s^2 / n
+double IterationSampler::estimate_variance(const Cluster &cluster) {
+    if (cluster.detailed.empty()) return 0;
+    return (double)cluster.skipped * cluster.skipped * variance(cluster) / cluster.detailed.size();
+}
+
+IterationSampler::Total IterationSampler::total() {
+    Total total{};
+    for (auto &[name, cluster] : _clusters) {
+        total.detailed += cluster.detailed.size();
+        total.skipped += cluster.skipped;
+        total.cycles += estimate(cluster);
+        total.variance += estimate_variance(cluster);
+    }
+    return total;
+}
+
+void IterationSampler::print_stat() {
+    Total all = total();
+    spdlog::info("Sampling : {} clusters, {} detailed / {} fast-forwarded iterations",
+                 _clusters.size(), all.detailed, all.skipped);
+    spdlog::info("Sampling : estimated {:.0f} +- {:.0f} cycles (95% CI)", all.cycles,
+                 1.96 * std::sqrt(all.variance));
+}
+
+void IterationSampler::log(std::string fname) {
+    std::ofstream ofile(fname + ".tsv");
+    if (!ofile.is_open()) {
+        assert(0);
+    }
+    ofile << "Cluster\tdetailed_iters\tskipped_iters\tmean_cycles\tstddev_cycles\t"
+             "est_cycles\tci95_cycles\n";
+    for (auto &[name, cluster] : _clusters) {
+        ofile << fmt::format("{}\t{}\t{}\t{:.1f}\t{:.1f}\t{:.0f}\t{:.0f}\n", name,
+                             cluster.detailed.size(), cluster.skipped, mean(cluster),
+                             std::sqrt(variance(cluster)), estimate(cluster),
+                             1.96 * std::sqrt(estimate_variance(cluster)));
+    }
+    Total all = total();
+    ofile << fmt::format("total\t{}\t{}\t-\t-\t{:.0f}\t{:.0f}\n", all.detailed, all.skipped,
+                         all.cycles, 1.96 * std::sqrt(all.variance));
+    ofile.close();
+}
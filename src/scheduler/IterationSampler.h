@@ -0,0 +1,48 @@
+#pragma once
+#include "../Common.h"
+
+// Sampled simulation (sampling_detailed_iters > 0), in the style of SMARTS.
+// Iterations are clustered by batch size and the histogram of KV tokens per PIM channel. The
+// first sampling_detailed_iters iterations of a cluster are simulated in detail; the others are
+// fast-forwarded and counted with the mean latency of their cluster. The estimated total comes
+// with a 95% confidence interval from the spread of the detailed iterations.
+class IterationSampler {
+   public:
+    IterationSampler(SimulationConfig config);
+
+    bool enabled() { return _detailed_iters > 0; }
+    std::string cluster_of(const std::vector<std::vector<Ptr<InferRequest>>> &channel_requests);
+    bool should_simulate(std::string cluster);
+    void record_detailed(std::string cluster, cycle_type cycles);
+    void record_skipped(std::string cluster);
+
+    json checkpoint();  // the clusters recorded so far
+    void restore(json state);
+
+    void print_stat();
+    void log(std::string fname);  // per-cluster estimates to {fname}.tsv
+
+   private:
+    typedef struct {
+        std::vector<cycle_type> detailed;  // latency of each detailed iteration
+        uint64_t skipped;
+    } Cluster;
+
+    uint32_t _detailed_iters;
+    uint32_t _seq_bin;
+    uint32_t _batch_bin;
+    std::map<std::string, Cluster> _clusters;
+
+    double mean(const Cluster &cluster);
+    double variance(const Cluster &cluster);  // sample variance of the detailed latencies
+    double estimate(const Cluster &cluster);
+    double estimate_variance(const Cluster &cluster);
+
+    typedef struct {
+        uint64_t detailed;
+        uint64_t skipped;
+        double cycles;
+        double variance;
+    } Total;
+    Total total();
+};
@@ -0,0 +1,134 @@
+#include "PIMLatencyModel.h"
+
+#include "newtonsim/NewtonSim.h"
+
+PIMLatencyModel::PIMLatencyModel(SimulationConfig config) : _config(config) {
+    _gwrite_latency = 100;
+    _gemv_latency = 184;
+
+    uint32_t dk = _config.model_n_embd / _config.model_n_head;
+    uint32_t page_size = kv_page_elements(_config);
+    _num_readres = ceil((double)page_size / dk);
+    _comps_per_readres = ceil((double)dk / kv_comp_coverage(_config));
+}
+
+// Run 1, 2, 4, ..., 32 back-to-back commands of each kind and fit the per-command latency as
+// the slope of cycles over # of commands, so the fixed pipeline fill cost does not leak in.
+void PIMLatencyModel::calibrate() {
+    if (_config.dram_type == DramType::DRAM) {
+        spdlog::info("PIM latency calibration skipped: dram_type is not PIM");
+        return;
+    }
+
+    std::vector<double> counts;
+    std::vector<double> gwrite_cycles;
+    std::vector<double> gemv_cycles;
+    for (int n = 1; n <= 32; n *= 2) {
+        counts.push_back(n);
+        gwrite_cycles.push_back(run_commands(gwrite_commands(n)));
+        gemv_cycles.push_back(run_commands(gemv_commands(n)));
+    }
+
+    _gwrite_latency = MAX(1, round(fit_slope(counts, gwrite_cycles)));
+    _gemv_latency = MAX(1, round(fit_slope(counts, gemv_cycles)));
+
+    spdlog::info("PIM latency calibration ({}): gwrite {} cycles, gemv {} cycles",
+                 _config.pim_config_path, _gwrite_latency, _gemv_latency);
+    dump();
+}
+
+std::vector<PIMLatencyModel::Command> PIMLatencyModel::gwrite_commands(int num_gwrites) {
+    std::vector<Command> commands;
+    for (int i = 0; i < num_gwrites; i++) {
+        addr_type addr = AddressConfig::make_address(0, 0, 0, 0, i, 0);
+        commands.push_back(std::make_pair(addr, MemoryAccessType::GWRITE));
+    }
+    return commands;
+}
+
+// same command sequence as a tile of NeuPIMSLogitSoftmax, each GEMV on a different DRAM row
+std::vector<PIMLatencyModel::Command> PIMLatencyModel::gemv_commands(int num_gemvs) {
+    std::vector<Command> commands;
+    for (int i = 0; i < num_gemvs; i++) {
+        int row = 100 + i;
+        addr_type header_addr = AddressConfig::encode_pim_header(
+            0, row, false, _num_readres * _comps_per_readres, _num_readres);
+        commands.push_back(std::make_pair(header_addr, MemoryAccessType::P_HEADER));
+
+        for (int r = 0; r < _num_readres; r++) {
+            addr_type addr = AddressConfig::encode_pim_comps_readres(0, row, _comps_per_readres,
+                                                                     r == _num_readres - 1);
+            if (_config.dram_type == DramType::NEWTON) {
+                for (int c = 0; c < _comps_per_readres; c++)
+                    commands.push_back(std::make_pair(addr, MemoryAccessType::COMP));
+                commands.push_back(std::make_pair(addr, MemoryAccessType::READRES));
+            } else {
+                commands.push_back(std::make_pair(addr, MemoryAccessType::COMPS_READRES));
+            }
+        }
+    }
+    return commands;
+}
+
+// issue at most one command per cycle (as the interconnect does) and return the # of DRAM
+// cycles until every response has come back.
+uint64_t PIMLatencyModel::run_commands(std::vector<Command> commands) {
+    dramsim3::NewtonSim mem(_config.pim_config_path, _config.log_dir);
+    constexpr uint64_t max_cycles = 10000000;
+
+    int dummy;  // NewtonSim hands the request pointer back, responses are only counted.
+    uint64_t expected = 0;
+    for (auto &command : commands)
+        if (command.second != MemoryAccessType::P_HEADER) expected++;
+
+    uint64_t responses = 0;
+    uint64_t cycles = 0;
+    size_t next = 0;
+    while (responses < expected) {
+        if (next < commands.size()) {
+            auto &[addr, type] = commands[next];
+            if (mem.WillAcceptTransaction(addr, int(type))) {
+                mem.AddTransaction(addr, int(type), &dummy);
+                next++;
+            }
+        }
+        mem.ClockTick();
+        cycles++;
+
+        while (!mem.IsEmpty(0)) {
+            mem.Pop(0);
+            responses++;
+        }
+        ast(cycles < max_cycles);
+    }
+    return cycles;
+}
+
+// least squares slope of ys over xs
+double PIMLatencyModel::fit_slope(std::vector<double> xs, std::vector<double> ys) {
+    assert(xs.size() == ys.size() && xs.size() > 1);
+    double n = xs.size();
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (int i = 0; i < xs.size(); i++) {
+        sum_x += xs[i];
+        sum_y += ys[i];
+        sum_xx += xs[i] * xs[i];
+        sum_xy += xs[i] * ys[i];
+    }
+    return (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+}
+
+// also read by trace-generator/channel_load_balancing.py
+void PIMLatencyModel::dump() {
+    json latency;
+    latency["pim_config_path"] = _config.pim_config_path;
+    latency["gwrite_latency"] = _gwrite_latency;
+    latency["gemv_latency"] = _gemv_latency;
+
+    std::ofstream ofile(_config.log_dir + "/pim_latency.json");
+    if (!ofile.is_open()) {
+        spdlog::error("Failed to write {}/pim_latency.json", _config.log_dir);
+        return;
+    }
+    ofile << latency.dump(4) << std::endl;
+}
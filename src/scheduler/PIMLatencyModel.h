@@ -0,0 +1,32 @@
+#pragma once
+#include "../Common.h"
+
+// Per-command PIM latencies (DRAM cycles) used by Scheduler::estimate_mha_latency.
+// Defaults are the values measured on HBM2_8Gb_x128_dualpim.ini. With `pim_calibration`, they
+// are fitted on a standalone NewtonSim instance built from the active pim_config_path.
+class PIMLatencyModel {
+   public:
+    PIMLatencyModel(SimulationConfig config);
+
+    void calibrate();
+
+    uint32_t get_gwrite_latency() { return _gwrite_latency; }
+    uint32_t get_gemv_latency() { return _gemv_latency; }
+
+   private:
+    SimulationConfig _config;
+    uint32_t _gwrite_latency;
+    uint32_t _gemv_latency;
+
+    // shape of one GEMV tile of NeuPIMSLogitSoftmax (P_HEADER + COMP/READRES of a DRAM row)
+    uint32_t _num_readres;
+    uint32_t _comps_per_readres;
+
+    typedef std::pair<addr_type, MemoryAccessType> Command;
+
+    std::vector<Command> gwrite_commands(int num_gwrites);
+    std::vector<Command> gemv_commands(int num_gemvs);
+    uint64_t run_commands(std::vector<Command> commands);
+    double fit_slope(std::vector<double> xs, std::vector<double> ys);
+    void dump();
+};
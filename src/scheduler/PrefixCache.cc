@@ -0,0 +1,157 @@
+#include "PrefixCache.h"
+
+#include "../allocator/AddressAllocator.h"
+
+PrefixCache::PrefixCache(std::vector<uint32_t> model_n_embd) : _E(model_n_embd) {
+    _uses = 0;
+    _lookups = 0;
+    _hits = 0;
+    _hit_tokens = 0;
+    _shared_rows = 0;
+    _evictions = 0;
+}
+
+uint32_t PrefixCache::prefix_tokens(Ptr<InferRequest> request) {
+    if (request->prefix_id == 0 || request->input_size == 0) return 0;
+    uint32_t tokens = request->prefix_len > 0 ? request->prefix_len : request->input_size;
+    return MIN(tokens, request->input_size - 1);
+}
+
+uint32_t PrefixCache::key_tokens(uint32_t tokens) {
+    uint32_t period = KVCacheAlloc::GetInstance()->_bank_per_ch;
+    return tokens / period * period;
+}
+
+uint32_t PrefixCache::value_tokens(uint32_t tokens) {
+    uint32_t period = KVCacheAlloc::GetInstance()->_num_ele_per_row;
+    return tokens / period * period;
+}
+
+int PrefixCache::channel_of(Ptr<InferRequest> request) {
+    uint32_t tokens = prefix_tokens(request);
+    int best = -1;
+    uint32_t best_tokens = 0;
+    for (uint32_t ch = 0; ch < KVCacheAlloc::GetInstance()->_dram_channels; ch++) {
+        auto it = _entries.find({request->model, request->prefix_id, ch});
+        if (it == _entries.end()) continue;
+        uint32_t matched = key_tokens(MIN(tokens, it->second.tokens));
+        if (matched > best_tokens) {
+            best = ch;
+            best_tokens = matched;
+        }
+    }
+    return best;
+}
+
+PrefixCache::Hit PrefixCache::acquire(Ptr<InferRequest> request, uint32_t ch) {
+    Hit hit{.tokens = 0};
+    Key id{request->model, request->prefix_id, ch};
+    auto it = _entries.find(id);
+    if (it == _entries.end()) return hit;
+    auto &entry = it->second;
+
+    uint32_t tokens = MIN(prefix_tokens(request), entry.tokens);
+    uint32_t E = _E[request->model];
+    uint32_t key_rows = PIMTensor::get_num_rows(PIMTensorKVType::KEY, key_tokens(tokens), E);
+    uint32_t value_rows =
+        PIMTensor::get_num_rows(PIMTensorKVType::VALUE, value_tokens(tokens), E);
+    if (key_rows + value_rows == 0) return hit;
+
+    hit.tokens = MIN(key_tokens(tokens), value_tokens(tokens));
+    hit.key_rows.assign(entry.key_rows.begin(), entry.key_rows.begin() + key_rows);
+    hit.value_rows.assign(entry.value_rows.begin(), entry.value_rows.begin() + value_rows);
+    entry.refs++;
+    entry.last_use = ++_uses;
+    _users[request->id] = id;
+    return hit;
+}
+
+void PrefixCache::release(Ptr<InferRequest> request) {
+    auto it = _users.find(request->id);
+    if (it == _users.end()) return;
+    auto &entry = _entries.at(it->second);
+    assert(entry.refs > 0);
+    entry.refs--;
+    entry.last_use = ++_uses;
+    _users.erase(it);
+}
+
+void PrefixCache::insert(Ptr<InferRequest> request, Ptr<PIMTensor> key, Ptr<PIMTensor> value) {
+    uint32_t tokens = prefix_tokens(request);
+    if (tokens == 0) return;
+    _lookups++;
+    bool hit = holds(request);
+    if (hit) {
+        _hits++;
+        uint32_t key_hit = key->_shared_rows / key->_num_rows_per_alloc * key->_bank_per_ch;
+        uint32_t value_hit =
+            value->_shared_rows / value->_num_rows_per_alloc * value->_num_ele_per_row;
+        _hit_tokens += MIN(key_hit, value_hit);
+        _shared_rows += key->_shared_rows + value->_shared_rows;
+    }
+
+    Key id{request->model, request->prefix_id, key->get_channel()};
+    uint32_t E = _E[request->model];
+    uint32_t key_rows = PIMTensor::get_num_rows(PIMTensorKVType::KEY, key_tokens(tokens), E);
+    uint32_t value_rows =
+        PIMTensor::get_num_rows(PIMTensorKVType::VALUE, value_tokens(tokens), E);
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        if (key_rows + value_rows == 0) return;
+        it = _entries.insert({id, Entry{.tokens = 0, .refs = 0}}).first;
+    }
+    auto &entry = it->second;
+
+    // the path grows only from its end: the request has to read all of the cached rows
+    if (tokens <= entry.tokens || key->_shared_rows != entry.key_rows.size() ||
+        value->_shared_rows != entry.value_rows.size())
+        return;
+    key->share(key_rows);
+    value->share(value_rows);
+    entry.tokens = tokens;
+    entry.key_rows.assign(key->_rows.begin(), key->_rows.begin() + key_rows);
+    entry.value_rows.assign(value->_rows.begin(), value->_rows.begin() + value_rows);
+    entry.last_use = ++_uses;
+    if (!hit) {
+        entry.refs++;
+        _users[request->id] = id;
+    }
+}
+
+bool PrefixCache::holds(Ptr<InferRequest> request) {
+    return _users.find(request->id) != _users.end();
+}
+
+uint64_t PrefixCache::rows(uint32_t ch, uint32_t model) {
+    uint64_t rows = 0;
+    for (auto &[id, entry] : _entries) {
+        if (std::get<0>(id) != model || std::get<2>(id) != ch) continue;
+        rows += entry.key_rows.size() + entry.value_rows.size();
+    }
+    return rows;
+}
+
+bool PrefixCache::evict(uint32_t ch, int model) {
+    auto victim = _entries.end();
+    for (auto it = _entries.begin(); it != _entries.end(); it++) {
+        auto &[id, entry] = *it;
+        if (entry.refs > 0 || std::get<2>(id) != ch) continue;
+        if (model >= 0 && std::get<0>(id) != model) continue;
+        if (victim == _entries.end() || entry.last_use < victim->second.last_use) victim = it;
+    }
+    if (victim == _entries.end()) return false;
+
+    auto alloc = KVCacheAlloc::GetInstance();
+    for (auto row : victim->second.key_rows) alloc->free(ch, row);
+    for (auto row : victim->second.value_rows) alloc->free(ch, row);
+    _entries.erase(victim);
+    _evictions++;
+    return true;
+}
+
+void PrefixCache::print_stat() {
+    spdlog::info("Prefix cache : {} of {} admissions hit ({:.2f}%), {} prefill tokens skipped, "
+                 "{} rows shared, {} evictions, {} prefixes cached",
+                 _hits, _lookups, _lookups > 0 ? 100.0 * _hits / _lookups : 0, _hit_tokens,
+                 _shared_rows, _evictions, _entries.size());
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../Common.h"
+#include "../tensor/PIMTensor.h"
+
+/**
+ * PrefixCache keeps the PIM KV rows of prompt prefixes (prefix_caching), so the requests of a
+ * prefix_id on a channel read one copy of its KEY and VALUE rows in their GEMVs.
+ * Traces carry no token ids: the prefix of a request is the first prefix_len tokens of its
+ * prompt (all of it if prefix_len is 0), and requests with the same prefix_id agree on their
+ * common tokens. The radix tree over token prefixes thus has one path per prefix_id; an entry
+ * is that path on one channel for one model, as long as the longest prefix inserted so far.
+ *   rows:    whole KEY (dram_banks_per_ch tokens) and VALUE (a DRAM row of tokens) allocations
+ *            only; the tokens after them go to rows the request owns
+ *   hit:     the tokens whose KEY and VALUE are both in shared rows skip the prefill; the last
+ *            prompt token is always computed
+ *   refs:    requests holding the rows; entries without any are evicted LRU when their
+ *            channel (or model quota) runs out of rows
+ */
+class PrefixCache {
+   public:
+    PrefixCache(std::vector<uint32_t> model_n_embd);
+
+    typedef struct {
+        uint32_t tokens;  // prompt tokens that skip the prefill
+        std::vector<uint64_t> key_rows;
+        std::vector<uint64_t> value_rows;
+    } Hit;
+
+    static uint32_t prefix_tokens(Ptr<InferRequest> request);  // at most input_size - 1
+
+    int channel_of(Ptr<InferRequest> request);  // channel of its longest cached prefix, or -1
+    Hit acquire(Ptr<InferRequest> request, uint32_t ch);  // takes a reference if any row hits
+    void release(Ptr<InferRequest> request);              // drops its reference, if any
+    // caches the prefix rows of an admitted request, extending the entry it hit
+    void insert(Ptr<InferRequest> request, Ptr<PIMTensor> key, Ptr<PIMTensor> value);
+    bool holds(Ptr<InferRequest> request);  // whether the request reads shared rows
+
+    uint64_t rows(uint32_t ch, uint32_t model);  // rows cached for the model on ch
+    bool evict(uint32_t ch, int model);  // LRU unused entry (of the model if >= 0), false if none
+
+    void print_stat();
+
+   private:
+    typedef std::tuple<uint32_t, uint64_t, uint32_t> Key;  // model, prefix_id, channel
+    typedef struct {
+        uint32_t tokens;  // prefix tokens, the rows cover the whole allocations among them
+        std::vector<uint64_t> key_rows;
+        std::vector<uint64_t> value_rows;
+        uint32_t refs;
+        uint64_t last_use;
+    } Entry;
+
+    std::vector<uint32_t> _E;  // per model
+    std::map<Key, Entry> _entries;
+    std::map<uint32_t, Key> _users;  // request id -> entry it holds
+    uint64_t _uses;                  // LRU clock
+
+    uint32_t _lookups;
+    uint32_t _hits;
+    uint64_t _hit_tokens;
+    uint64_t _shared_rows;  // rows hits did not allocate
+    uint32_t _evictions;
+
+    uint32_t key_tokens(uint32_t tokens);    // in whole KEY allocations
+    uint32_t value_tokens(uint32_t tokens);  // in whole VALUE allocations
+};
@@ -1,26 +1,71 @@
 #include "Scheduler.h"
 
+#include <algorithm>
 #include <cmath>
+#include <list>
 
+#include "../allocator/AddressAllocator.h"
 #include "../tensor/NPUTensor.h"
 #include "../tensor/PIMTensor.h"
 
 Scheduler::Scheduler(SimulationConfig config, const cycle_type* core_cycle)
-    : _config(config), _core_cycle(core_cycle), _cycles(0) {
-    _max_batch_size = 1024;   // 256;   // config.max_batch_size;
-    _max_active_reqs = 1024;  // 256;  // 70;
+    : _core_cycle(core_cycle),
+      _config(config),
+      _cycles(0),
+      _pim_latency_model(config),
+      _sampler(config) {
+    _max_batch_size = config.max_batch_size;
+    _max_active_reqs = config.max_active_reqs;
+    _admission_policy = AdmissionPolicy::create(config);
+    _completed_requests = 0;
+    _ttft_slo_met = 0;
+    _tpot_slo_met = 0;
     _active_reqs = 0;
     _next_ch = 0;
     _ch_load_balancing = config.ch_load_balancing;
+    _kv_migration = config.kv_migration;
+    _kv_migration_threshold = config.kv_migration_threshold;
+    _migrated_requests = 0;
+    _migrated_rows = 0;
+    _ingested_requests = 0;
+    _ingested_rows = 0;
+    _iterations = 0;
+    _iteration_start_cycle = 0;
+    _iteration_detailed = true;
+
+    _preemption = config.preemption;
+    _preemption_victim = config.preemption_victim;
+    // GB/s over MHz
+    _swap_bytes_per_cycle = config.swap_bandwidth * 1e9 / (config.core_freq * 1e6);
+    _swap_space = config.swap_space GB;
+    _swap_used = 0;
+    _pending_stall_cycles = 0;
+    _stall_until = 0;
+    _recomputed_requests = 0;
+    _recomputed_tokens = 0;
+    _swapped_requests = 0;
+    _swapped_total_bytes = 0;
 
     // Model dimension init
-    _nh = _config.model_n_head / _config.n_tp;
-    _dk = _config.model_n_embd / _config.model_n_head;
-    _effective_e = _nh * _dk;
+    for (uint32_t m = 0; m < _config.models.size(); m++) {
+        _model_configs.push_back(model_config_of(_config, m));
+        auto &model_config = _model_configs.back();
+        _nh.push_back(model_config.model_n_head / model_config.n_tp);
+        _dk.push_back(model_config.model_n_embd / model_config.model_n_head);
+        _effective_e.push_back(_nh.back() * _dk.back());
+    }
+    _kv_partition = _config.kv_partition;
+    if (_config.prefix_caching) {
+        std::vector<uint32_t> model_n_embd;
+        for (auto &model_config : _model_configs) model_n_embd.push_back(model_config.model_n_embd);
+        _prefix_cache = std::make_unique<PrefixCache>(model_n_embd);
+    }
+    _model_generated.assign(_model_configs.size(), 0);
+    _model_completed.assign(_model_configs.size(), 0);
 
     // Memory spec init
     _dram_channels = _config.dram_channels;
-    _dram_page_size = _config.dram_page_size / _config.precision;
+    _dram_page_size = kv_page_elements(_config);
     _dram_banks_per_ch = _config.dram_banks_per_ch;
 
     // 1: Systolic Array Program
@@ -31,11 +76,16 @@ Scheduler::Scheduler(SimulationConfig config, const cycle_type* core_cycle)
     _init_stage = Stage::A;
     // _init_stage = Stage::C;
     _stage = _init_stage;
+    _resume_stage = _init_stage;
     _just_one_stage = false;
 
     _has_stage_changed = false;
 
-    _partition_alg_simple = true;
+    _partition_alg_simple = false;
+    _num_sub_batches = _config.num_sub_batches;
+    _sub_batches.resize(_num_sub_batches);
+    _sub_batch_models.assign(_num_sub_batches, 0);
+    _model_turn = 0;
 
     // Request queue for channel
     for (int i = 0; i < _dram_channels; i++) {
@@ -49,9 +99,12 @@ Scheduler::Scheduler(SimulationConfig config, const cycle_type* core_cycle)
     }
 
     // KV allocate by pim tile
-    int model_weight = _config.model_params_b * _config.precision / _config.n_tp;  // GB
+    double model_weight = 0;  // GB, at weight_bits
+    for (auto &model_config : _model_configs)
+        model_weight += (double)model_config.model_params_b * model_config.weight_bits / 8 /
+                        model_config.n_tp;
     int memory_capacity = _dram_channels;                                          // GB
-    int available_for_kv = memory_capacity - model_weight;                         // GB
+    double available_for_kv = memory_capacity - model_weight;                      // GB
     int pim_tile_size = _config.dram_page_size * _dram_banks_per_ch;               // B
     _total_tiles = floor((double)available_for_kv GB / pim_tile_size);
     _total_available_tiles = _total_tiles;
@@ -70,22 +123,30 @@ Scheduler::Scheduler(SimulationConfig config, const cycle_type* core_cycle)
     _value_period = _dram_page_size;
 
     // how many PIM tiles compose a page.
-    _key_page_size = ceil((double)_effective_e / _value_period);
-    _value_page_size = ceil((double)_effective_e / _key_period);
+    _key_page_size = ceil((double)_effective_e[0] / _value_period);
+    _value_page_size = ceil((double)_effective_e[0] / _key_period);
 
     spdlog::info("_key_period: {}", _key_period);
     spdlog::info("_key_page_size: {}", _key_page_size);
     spdlog::info("_value_period: {}", _value_period);
     spdlog::info("_value_page_size: {}", _value_page_size);
-    spdlog::info("Effective E(_nh * _dk):{}", _nh * _dk);
+    spdlog::info("Effective E(_nh * _dk):{}", _effective_e[0]);
 
     // PIM GEMV latency
-    _gwrite_latency = 100;
-    _gemv_latency = 184;
+    if (_config.pim_calibration) _pim_latency_model.calibrate();
+    _gwrite_latency = _pim_latency_model.get_gwrite_latency();
+    _gemv_latency = _pim_latency_model.get_gemv_latency();
+    _stage_estimated_pim_cycles = 0;
+    _prev_stage_estimated_pim_cycles = 0;
 }
 
 void Scheduler::launch(Ptr<Model> model) {
-    _model = model;
+    uint32_t m = _models.size();
+    ast(m < _model_configs.size());
+    _models.push_back(model);
+    auto alloc = KVCacheAlloc::GetInstance();
+    double share = _config.models[m].value("kv_share", 1.0 / _model_configs.size());
+    _kv_quota_rows.push_back(alloc->_rows.empty() ? 0 : share * alloc->_rows[0]->size());
     spdlog::info("MODEL {} Launched in Scheduler", model->get_name());
 }
 
@@ -167,57 +228,112 @@ int Scheduler::allocate_pim_tile(uint32_t seq_len) {
     return ch;
 }
 
+// channel of a request the trace did not map: the channel with the least MHA load with
+// ch_load_balancing, round-robin otherwise
+int Scheduler::assign_channel() {
+    if (_ch_load_balancing) {
+        return std::min_element(_active_request_accum_latencys.begin(),
+                                _active_request_accum_latencys.end()) -
+               _active_request_accum_latencys.begin();
+    }
+    return _next_ch++ % _dram_channels;
+}
+
 void Scheduler::allocate_requests() {
-    uint32_t batch_size = 0;
-
-    // if (_ch_load_balancing) {
-    //     // sort request_queue by sequence length
-    //     // for channel load balancing algorithm
-    //     // greedy algorithm
-    //     std::sort(_request_queue.begin(), _request_queue.end(),
-    //               [this](const Ptr<InferRequest>& a, const Ptr<InferRequest>& b) {
-    //                   return compare_by_seqlen(a, b);
-    //               });
-    // }
-    for (auto it = _request_queue.begin(); it != _request_queue.end(); it++) {
-        if (batch_size == _max_batch_size) break;
-        Ptr<InferRequest> request = *it;
+    // running requests stay in the batch, waiting ones are admitted in _admission_policy order
+    std::vector<Ptr<InferRequest>> running;
+    std::vector<Ptr<InferRequest>> waiting;
+    for (auto request : _request_queue) {
         assert(request->output_size > request->generated);
+        (request->is_initiated ? running : waiting).push_back(request);
+    }
+    _admission_policy->order(waiting, running, *_core_cycle);
 
-        if (!request->is_initiated) {
-            int ch = request->channel;
-            assert(ch < _dram_channels);
-            spdlog::info("request#{} seq_len:{} channel:{}", request->id, request->input_size,
-                         request->channel);
-            // allocate_pim_tile(request->input_size);
-            if (ch == -1) continue;
-
-            uint32_t seq_len = request->input_size;
-
-            std::vector<uint32_t> dim_key{_nh, _dk, seq_len};
-            std::vector<uint32_t> dim_value{_nh, seq_len, _dk};
-
-            if (_active_reqs >= _max_active_reqs) continue;
-            _active_reqs++;
-            // spdlog::info("Scheduler allocate request#{}(seq_len:{}) to channel {}<<",
-            //              request->id, seq_len, ch);
-            auto k = std::make_shared<PIMTensor>(
-                name_gen(std::to_string(request->id), "KEY", std::to_string(0)), ch, dim_key,
-                PIMTensorKVType::KEY, true);
-            auto v = std::make_shared<PIMTensor>(
-                name_gen(std::to_string(request->id), "VALUE", std::to_string(0)), ch, dim_value,
-                PIMTensorKVType::VALUE, true);
-            request->K_cache.push_back(k);
-            request->V_cache.push_back(v);
-
-            _active_request_queues[ch].push_back(request);
-            uint32_t mha_latency = estimate_mha_latency(request);
-            _active_request_latency_queues[ch].push_back(mha_latency);
-            // todo: when return req, decrease accum latency
-            _active_request_accum_latencys[ch] += mha_latency;
+    uint32_t batch_size = running.size();
+    for (auto it = waiting.begin(); it != waiting.end(); it++) {
+        if (batch_size >= _max_batch_size || _active_reqs >= _max_active_reqs) break;
+        Ptr<InferRequest> request = *it;
+        // requests of a prefix go where its rows are cached
+        if (request->channel < 0 && _prefix_cache)
+            request->channel = _prefix_cache->channel_of(request);
+        if (request->channel < 0) request->channel = assign_channel();
+        int ch = request->channel;
+        assert(ch < _dram_channels);
+
+        // a preempted request gets back the KV cache of its generated tokens too
+        uint32_t seq_len = request->input_size + request->generated;
+        PrefixCache::Hit hit{.tokens = 0};
+        if (_prefix_cache) hit = _prefix_cache->acquire(request, ch);
+        if (!has_kv_room(ch, seq_len, request->model,
+                         hit.key_rows.size() + hit.value_rows.size())) {
+            if (_prefix_cache) _prefix_cache->release(request);
+            bool rows_freeable = _kv_partition == "static" ? kv_rows_held(ch, request->model) > 0
+                                                           : !_active_request_queues[ch].empty();
+            if (!rows_freeable) {
+                spdlog::error("request#{} ({} tokens) does not fit in channel {}", request->id,
+                              seq_len, ch);
+                exit(EXIT_FAILURE);
+            }
+            continue;  // waits for rows to be freed
+        }
+        spdlog::info("request#{} seq_len:{} channel:{}", request->id, seq_len, request->channel);
+
+        uint32_t m = request->model;
+        std::vector<uint32_t> dim_key{_nh[m], _dk[m], seq_len};
+        std::vector<uint32_t> dim_value{_nh[m], seq_len, _dk[m]};
+
+        _active_reqs++;
+        // spdlog::info("Scheduler allocate request#{}(seq_len:{}) to channel {}<<",
+        //              request->id, seq_len, ch);
+        auto k = std::make_shared<PIMTensor>(
+            name_gen(std::to_string(request->id), "KEY", std::to_string(0)), ch, dim_key,
+            PIMTensorKVType::KEY, true, _model_configs[m].model_n_embd, hit.key_rows);
+        auto v = std::make_shared<PIMTensor>(
+            name_gen(std::to_string(request->id), "VALUE", std::to_string(0)), ch, dim_value,
+            PIMTensorKVType::VALUE, true, _model_configs[m].model_n_embd, hit.value_rows);
+        request->K_cache.push_back(k);
+        request->V_cache.push_back(v);
+        if (_prefix_cache) _prefix_cache->insert(request, k, v);
+
+        _active_request_queues[ch].push_back(request);
+        uint32_t mha_latency = estimate_mha_latency(request);
+        _active_request_latency_queues[ch].push_back(mha_latency);
+        // todo: when return req, decrease accum latency
+        _active_request_accum_latencys[ch] += mha_latency;
 
-            request->is_initiated = true;
+        request->is_initiated = true;
+        request->admitted_cycle = *_core_cycle;
+
+        if (_swapped_bytes.find(request->id) != _swapped_bytes.end()) {
+            // swap-in
+            uint64_t bytes = _swapped_bytes[request->id];
+            _pending_stall_cycles += ceil(bytes / _swap_bytes_per_cycle);
+            _swap_used -= bytes;
+            _swapped_total_bytes += bytes;
+            _swapped_bytes.erase(request->id);
+        } else if (request->kv_remote) {
+            // prompt KV cache from a prefill device, written into the rows allocated above
+            // (the cached prefix rows already hold theirs)
+            KVMigration ingest{
+                .request_id = request->id,
+                .src_ch = (uint32_t)ch,
+                .dst_ch = (uint32_t)ch,
+            };
+            for (auto kv : {k, v}) {
+                auto rows = kv->get_rows();
+                ingest.dst_rows.insert(ingest.dst_rows.end(), rows.begin() + kv->_shared_rows,
+                                       rows.end());
+            }
+            _ingested_requests++;
+            _ingested_rows += ingest.dst_rows.size();
+            _pending_kv_migrations.push_back(ingest);
+        } else if (request->generated > 0) {
+            // recompute: prefill of the prompt and the generated tokens, but the cached prefix
+            _pending_stall_cycles += recompute_cycles(seq_len - hit.tokens, m);
+            _recomputed_tokens += seq_len - hit.tokens;
         }
+        _admission_policy->on_admit(request);
+        request->kv_remote = false;
 
         batch_size++;
     }
@@ -241,50 +357,104 @@ void Scheduler::allocate_requests() {
     // exit(-1);
 }
 
+int Scheduler::sa_sub_batch_idx(Stage stage) {
+    uint32_t stage_idx = static_cast<int>(stage);
+    uint32_t sb = stage_idx % stagePeriod();
+    return sb < _num_sub_batches ? sb : -1;
+}
+
+int Scheduler::pim_sub_batch_idx(Stage stage) {
+    uint32_t stage_idx = static_cast<int>(stage);
+    if (stage_idx == 0 || stage_idx > 2 * stagePeriod()) return -1;
+    uint32_t sb = (stage_idx - 1) % stagePeriod();
+    return sb < _num_sub_batches ? sb : -1;
+}
+
+// stages after the last Pj/FFNs of the last sub-batch are empty
+uint32_t Scheduler::num_stages() { return 2 * stagePeriod() + _num_sub_batches; }
+
 void Scheduler::make_program() {
-    std::shared_ptr<BatchedRequest> sub_batch_on_sa;
-    std::shared_ptr<BatchedRequest> sub_batch_on_pim;
-    if (static_cast<int>(_stage) % 2 == 0) {
-        sub_batch_on_sa = std::make_shared<BatchedRequest>(_breq1);
-        sub_batch_on_pim = std::make_shared<BatchedRequest>(_breq2);
-    } else {
-        sub_batch_on_sa = std::make_shared<BatchedRequest>(_breq2);
-        sub_batch_on_pim = std::make_shared<BatchedRequest>(_breq1);
-    }
+    int sa_idx = sa_sub_batch_idx(_stage);
+    int pim_idx = pim_sub_batch_idx(_stage);
+    std::shared_ptr<BatchedRequest> sub_batch_on_sa = std::make_shared<BatchedRequest>(
+        sa_idx >= 0 ? _sub_batches[sa_idx] : std::vector<Ptr<InferRequest>>());
+    std::shared_ptr<BatchedRequest> sub_batch_on_pim = std::make_shared<BatchedRequest>(
+        pim_idx >= 0 ? _sub_batches[pim_idx] : std::vector<Ptr<InferRequest>>());
 
     spdlog::info("New Program for SA  (sub-batch.size: {})", sub_batch_on_sa->_reqs.size());
     spdlog::info("New Program for PIM (sub-batch.size: {})", sub_batch_on_pim->_reqs.size());
 
-    _model_program1 =
-        std::make_unique<StageProgram>(_model, sub_batch_on_sa, StagePlatform::SA, _stage);
+    // pending KV cache copies ride on the first SA program that has requests
+    std::vector<KVMigration> kv_migrations;
+    if (sub_batch_on_sa->_reqs.size() > 0) {
+        kv_migrations.swap(_pending_kv_migrations);
+    }
+
+    // sub-batches of different models interleave like sub-batches of one model
+    auto sa_model = _models[sa_idx >= 0 ? _sub_batch_models[sa_idx] : 0];
+    auto pim_model = _models[pim_idx >= 0 ? _sub_batch_models[pim_idx] : 0];
+    _model_program1 = std::make_unique<StageProgram>(sa_model, sub_batch_on_sa, StagePlatform::SA,
+                                                     _stage, kv_migrations);
     _model_program2 =
-        std::make_unique<StageProgram>(_model, sub_batch_on_pim, StagePlatform::PIM, _stage);
+        std::make_unique<StageProgram>(pim_model, sub_batch_on_pim, StagePlatform::PIM, _stage);
+
+    _stage_estimated_pim_cycles = estimate_pim_cycles(sub_batch_on_pim);
 
     refresh_status1();
     refresh_status2();
 }
 
+uint64_t Scheduler::estimate_pim_cycles(Ptr<BatchedRequest> sub_batch) {
+    if (_config.run_mode != RunMode::NPU_PIM) return 0;
+
+    uint64_t total_latency = 0;
+    for (auto request : sub_batch->_reqs) total_latency += estimate_mha_latency(request);
+    return total_latency / _dram_channels;
+}
+
 int Scheduler::estimate_mha_latency(Ptr<InferRequest> request) {
     // calculate MHA latency with sequence length
     int latency = 0;
-    int seq_len = request->input_size;
+    int seq_len = request->input_size + request->generated;  // prompt and generated tokens
+    uint32_t m = request->model;
 
     // key * query
-    int chunks = ceil((double)_effective_e / _dram_page_size);
+    int chunks = ceil((double)_effective_e[m] / _dram_page_size);
     int tiles = ceil((double)seq_len / _dram_banks_per_ch);
     latency += chunks * _gwrite_latency;
     latency += chunks * tiles * _gemv_latency;
 
     // logit * value
-    chunks = ceil((double)seq_len / _dram_page_size) * _nh;
-    tiles = ceil((double)_dk / _dram_banks_per_ch);
+    chunks = ceil((double)seq_len / _dram_page_size) * _nh[m];
+    tiles = ceil((double)_dk[m] / _dram_banks_per_ch);
     latency += chunks * _gwrite_latency;
     latency += chunks * tiles * _gemv_latency;
 
     return latency;
 }
 
+// A sub-batch holds requests of one model, so the SA runs one model while the PIM runs the MHA
+// of another. Models with running requests get the sub-batches round-robin; when they outnumber
+// the sub-batches, they take turns over iterations.
 void Scheduler::group_sub_batches() {
+    _sub_batches.assign(_num_sub_batches, std::vector<Ptr<InferRequest>>());
+
+    std::set<uint32_t> running;
+    for (auto &req_queue : _active_request_queues)
+        for (auto &request : req_queue) running.insert(request->model);
+    std::vector<uint32_t> models(running.begin(), running.end());
+    if (models.size() > _num_sub_batches) {
+        std::rotate(models.begin(), models.begin() + _model_turn % models.size(), models.end());
+        models.resize(_num_sub_batches);
+        _model_turn += _num_sub_batches;
+    }
+    if (models.empty()) models.push_back(0);
+    std::vector<std::vector<uint32_t>> model_sub_batches(_model_configs.size());
+    for (int sb = 0; sb < _num_sub_batches; sb++) {
+        _sub_batch_models[sb] = models[sb % models.size()];
+        model_sub_batches[_sub_batch_models[sb]].push_back(sb);
+    }
+
     if (!_config.sub_batch_mode) {
         //>>>
         // Consolidate to one batch
@@ -292,129 +462,576 @@ void Scheduler::group_sub_batches() {
             auto req_queue = _active_request_queues[ch];
             for (auto it = req_queue.begin(); it != req_queue.end(); it++) {
                 Ptr<InferRequest> request = *it;
-                _breq1.push_back(request);
+                if (request->model == _sub_batch_models[0]) _sub_batches[0].push_back(request);
             }
         }
         return;
         //<<<
     }
 
-    bool ceil_turn = true;
+    // rotates which sub-batch takes the larger share of a channel, per model
+    std::vector<uint32_t> turns(_model_configs.size(), 0);
     for (int ch = 0; ch < _dram_channels; ch++) {
-        auto req_queue = _active_request_queues[ch];
-        auto latency_queue = _active_request_latency_queues[ch];
+        auto &req_queue = _active_request_queues[ch];
+        auto &latency_queue = _active_request_latency_queues[ch];
         assert(req_queue.size() == latency_queue.size());
 
-        if (_partition_alg_simple) {
-            size_t sb1_size = req_queue.size() / 2;
+        for (uint32_t m : models) {
+            std::vector<Ptr<InferRequest>> model_req_queue;
+            std::vector<uint32_t> model_latency_queue;
+            for (int i = 0; i < req_queue.size(); i++) {
+                if (req_queue[i]->model != m) continue;
+                model_req_queue.push_back(req_queue[i]);
+                model_latency_queue.push_back(latency_queue[i]);
+            }
+            partition_channel(model_req_queue, model_latency_queue, model_sub_batches[m],
+                              turns[m]);
+        }
+    }
 
-            if (req_queue.size() % 2 != 0) {
-                if (ceil_turn)
-                    sb1_size = ceil((double)req_queue.size() / 2);
-                else
-                    sb1_size = floor((double)req_queue.size() / 2);
+    uint32_t total_batch_size = 0;
+    for (int sb = 0; sb < _num_sub_batches; sb++) {
+        spdlog::info("sub-batch#{} size: {} (model {})", sb, _sub_batches[sb].size(),
+                     _sub_batch_models[sb]);
+        total_batch_size += _sub_batches[sb].size();
+    }
+    spdlog::info("total batch_size: {}", total_batch_size);
+}
 
-                ceil_turn = !ceil_turn;
-            }
+// splits the requests of a channel over sub_batches
+void Scheduler::partition_channel(const std::vector<Ptr<InferRequest>> &req_queue,
+                                  const std::vector<uint32_t> &latency_queue,
+                                  const std::vector<uint32_t> &sub_batches, uint32_t &turn) {
+    uint32_t n = sub_batches.size();
+    if (_partition_alg_simple) {
+        // contiguous chunks, the remainder goes one by one from sub-batch `turn`
+        uint32_t base_size = req_queue.size() / n;
+        uint32_t remainder = req_queue.size() % n;
+
+        int i = 0;
+        for (int l = 0; l < n; l++) {
+            uint32_t extra = (l + n - turn) % n < remainder;
+            for (int j = 0; j < base_size + extra; j++, i++)
+                _sub_batches[sub_batches[l]].push_back(req_queue[i]);
+        }
+        turn = (turn + remainder) % n;
 
-            for (int i = 0; i < req_queue.size(); i++) {
-                Ptr<InferRequest> request = req_queue[i];
-                if (i < sb1_size)
-                    _breq1.push_back(request);
-                else
-                    _breq2.push_back(request);
-            }
+    } else {
+        // lists are ordered by descending latency sum
+        auto index_lists = partition_lists_kk(latency_queue, n);
+        for (int l = 0; l < n; l++) {
+            int sb = sub_batches[(l + turn) % n];
+            for (int req_idx : index_lists[l]) _sub_batches[sb].push_back(req_queue[req_idx]);
+        }
+        turn = (turn + 1) % n;
+    }
+}
 
-        } else {
-            auto index_lists = partition_lists_dp(latency_queue);
-            std::vector<int> list1 = index_lists.first;
-            std::vector<int> list2 = index_lists.second;
-
-            int sum_list1_latencies = 0;
-            int sum_list2_latencies = 0;
-            std::string list1_str = "";
-            std::string list2_str = "";
-            std::string time1_str = "";
-            std::string time2_str = "";
-            for (auto it = list1.begin(); it != list1.end(); it++) {
-                int req_id = *it;
-                Ptr<InferRequest> request = req_queue[req_id];
-                sum_list1_latencies += latency_queue[req_id];
-                _breq1.push_back(request);
-                list1_str += std::to_string(req_id) + ", ";
-                time1_str += std::to_string(latency_queue[req_id]) + ", ";
+// Called at the start of each iteration
+void Scheduler::init_batches() {
+    allocate_requests();
+    if (_kv_migration) rebalance_channels();
+    group_sub_batches();
+
+    _stall_until = *_core_cycle + _pending_stall_cycles;
+    _pending_stall_cycles = 0;
+
+    _iteration_start_cycle = *_core_cycle;
+    _iteration_detailed = true;
+    if (_sampler.enabled()) {
+        _iteration_cluster = _sampler.cluster_of(_active_request_queues);
+        _iteration_detailed = _sampler.should_simulate(_iteration_cluster);
+        if (!_iteration_detailed) {
+            // fast-forward: no program runs, the requests complete right away
+            _sampler.record_skipped(_iteration_cluster);
+            _pending_kv_migrations.clear();
+            _stage = Stage::Finish;
+        }
+    }
+}
+
+void Scheduler::finish_iteration() {
+    for (int ch = 0; ch < _dram_channels; ch++) {
+        auto &req_queue = _active_request_queues[ch];
+        auto &latency_queue = _active_request_latency_queues[ch];
+        for (int i = req_queue.size() - 1; i >= 0; i--) {
+            if (req_queue[i]->generated < req_queue[i]->output_size) continue;
+            std::static_pointer_cast<PIMTensor>(req_queue[i]->K_cache[0])->free();
+            std::static_pointer_cast<PIMTensor>(req_queue[i]->V_cache[0])->free();
+            if (_prefix_cache) _prefix_cache->release(req_queue[i]);
+            _active_request_accum_latencys[ch] -= latency_queue[i];
+            req_queue.erase(req_queue.begin() + i);
+            latency_queue.erase(latency_queue.begin() + i);
+        }
+    }
+    grow_kv_caches();
+    // activations of the finished iteration are dead
+    ActAlloc::GetInstance()->flush();
+
+    if (_sampler.enabled() && _iteration_detailed)
+        _sampler.record_detailed(_iteration_cluster, *_core_cycle - _iteration_start_cycle);
+    _iterations++;
+    _stage = _init_stage;
+}
+
+// rows of the model on channel ch, its cached prefixes counted once
+uint64_t Scheduler::kv_rows_held(uint32_t ch, uint32_t model) {
+    uint64_t rows = _prefix_cache ? _prefix_cache->rows(ch, model) : 0;
+    for (auto &request : _active_request_queues[ch]) {
+        if (request->model != model) continue;
+        rows += std::static_pointer_cast<PIMTensor>(request->K_cache[0])->get_num_owned_rows() +
+                std::static_pointer_cast<PIMTensor>(request->V_cache[0])->get_num_owned_rows();
+    }
+    return rows;
+}
+
+// whether channel ch has `rows` more rows for the model, after evicting cached prefixes no
+// request reads
+bool Scheduler::kv_fits(uint32_t ch, uint32_t model, uint64_t rows) {
+    auto free_rows = [&]() { return KVCacheAlloc::GetInstance()->_rows[ch]->size(); };
+    while (free_rows() < rows)
+        if (!_prefix_cache || !_prefix_cache->evict(ch, -1)) return false;
+    if (_kv_partition != "static") return true;
+    while (kv_rows_held(ch, model) + rows > _kv_quota_rows[model])
+        if (!_prefix_cache || !_prefix_cache->evict(ch, model)) return false;
+    return true;
+}
+
+// rows for seq_len tokens and the next one, so the request is not preempted right away
+bool Scheduler::has_kv_room(int ch, uint32_t seq_len, uint32_t model, uint32_t shared_rows) {
+    uint32_t E = _model_configs[model].model_n_embd;
+    uint32_t rows = PIMTensor::get_num_rows(PIMTensorKVType::KEY, seq_len + 1, E) +
+                    PIMTensor::get_num_rows(PIMTensorKVType::VALUE, seq_len + 1, E);
+    return kv_fits(ch, model, rows - shared_rows);
+}
+
+// The generated token joins the context of the next decode iteration. When its channel has no
+// rows left for it (or its model has used up its share), requests of the channel (of the model)
+// are preempted until it fits (or it is preempted).
+void Scheduler::grow_kv_caches() {
+    for (int ch = 0; ch < _dram_channels; ch++) {
+        auto requests = _active_request_queues[ch];
+        for (auto request : requests) {
+            if (!request->is_initiated) continue;  // preempted for an earlier request
+            auto k = std::static_pointer_cast<PIMTensor>(request->K_cache[0]);
+            auto v = std::static_pointer_cast<PIMTensor>(request->V_cache[0]);
+            // its model had no sub-batch this iteration
+            if (k->_seq_len == request->input_size + request->generated) continue;
+            uint32_t rows = k->get_num_rows_to_add_token() + v->get_num_rows_to_add_token();
+            int victim_model = _kv_partition == "static" ? request->model : -1;
+            while (request->is_initiated && !kv_fits(ch, request->model, rows))
+                preempt_request(ch, select_victim(ch, victim_model));
+            if (!request->is_initiated) continue;
+
+            k->add_token();
+            v->add_token();
+            auto &queue = _active_request_queues[ch];
+            int i = std::find(queue.begin(), queue.end(), request) - queue.begin();
+            uint32_t mha_latency = estimate_mha_latency(request);
+            _active_request_accum_latencys[ch] +=
+                mha_latency - _active_request_latency_queues[ch][i];
+            _active_request_latency_queues[ch][i] = mha_latency;
+        }
+    }
+}
+
+// lru: the request admitted longest ago, priority: the lowest priority, the latest admitted
+// among equals
+int Scheduler::select_victim(uint32_t ch, int model) {
+    auto &queue = _active_request_queues[ch];
+    int victim = -1;
+    for (int i = 0; i < queue.size(); i++) {
+        auto &a = queue[i];
+        if (model >= 0 && a->model != model) continue;
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        auto &b = queue[victim];
+        if (_preemption_victim == "lru") {
+            if (a->admitted_cycle < b->admitted_cycle) victim = i;
+        } else if (a->priority < b->priority ||
+                   (a->priority == b->priority && a->admitted_cycle >= b->admitted_cycle)) {
+            victim = i;
+        }
+    }
+    assert(victim >= 0);
+    return victim;
+}
+
+// Frees the KV cache of a running request, which goes back to waiting. It keeps its place in
+// _request_queue, so allocate_requests readmits it before later arrivals.
+//  recompute: the KV cache is rebuilt by a prefill on readmission
+//  swap:      the KV cache is copied to host memory now and back on readmission
+// Both are charged as a stall of the next iteration (prefill is not simulated, see
+// recompute_cycles; the host link is a plain bandwidth).
+void Scheduler::preempt_request(uint32_t ch, int idx) {
+    Ptr<InferRequest> request = _active_request_queues[ch][idx];
+    auto k = std::static_pointer_cast<PIMTensor>(request->K_cache[0]);
+    auto v = std::static_pointer_cast<PIMTensor>(request->V_cache[0]);
+
+    // a PIM row spans all banks of the channel
+    uint64_t bytes = (uint64_t)(k->get_num_rows() + v->get_num_rows()) * _dram_banks_per_ch *
+                     _config.dram_page_size;
+    bool swap = _preemption == "swap" && _swap_used + bytes <= _swap_space;
+    if (swap) {
+        _swapped_bytes[request->id] = bytes;
+        _swap_used += bytes;
+        _pending_stall_cycles += ceil(bytes / _swap_bytes_per_cycle);
+        _swapped_requests++;
+        _swapped_total_bytes += bytes;
+    } else {
+        _recomputed_requests++;
+    }
+    spdlog::info("preempt request#{} on channel {}: {} ({} tokens)", request->id, ch,
+                 swap ? "swap" : "recompute", request->input_size + request->generated);
+
+    k->free();
+    v->free();
+    if (_prefix_cache) _prefix_cache->release(request);
+    request->K_cache.clear();
+    request->V_cache.clear();
+    request->is_initiated = false;
+
+    _active_request_accum_latencys[ch] -= _active_request_latency_queues[ch][idx];
+    _active_request_queues[ch].erase(_active_request_queues[ch].begin() + idx);
+    _active_request_latency_queues[ch].erase(_active_request_latency_queues[ch].begin() + idx);
+    _active_reqs--;
+}
+
+// prefill of tokens on the SA: a MAC per weight of this chip per token
+cycle_type Scheduler::recompute_cycles(uint32_t tokens, uint32_t model) {
+    auto &model_config = _model_configs[model];
+    double macs = (double)model_config.model_params_b * 1e9 / model_config.n_tp * tokens;
+    return ceil(macs / ((double)_config.core_width * _config.core_height * _config.num_cores));
+}
+
+// Channels are fixed by the trace when requests arrive, so the MHA load of the PIM channels can
+// drift apart. While the skew (max - min) / max exceeds the threshold, move the request whose
+// latency best halves the gap from the most loaded channel to the least loaded channel.
+void Scheduler::rebalance_channels() {
+    while (true) {
+        int max_ch = 0;
+        int min_ch = 0;
+        for (int ch = 0; ch < _dram_channels; ch++) {
+            if (_active_request_accum_latencys[ch] > _active_request_accum_latencys[max_ch])
+                max_ch = ch;
+            if (_active_request_accum_latencys[ch] < _active_request_accum_latencys[min_ch])
+                min_ch = ch;
+        }
+
+        uint32_t max_latency = _active_request_accum_latencys[max_ch];
+        uint32_t min_latency = _active_request_accum_latencys[min_ch];
+        if (max_latency == 0) return;
+        double skew = (double)(max_latency - min_latency) / max_latency;
+        if (skew <= _kv_migration_threshold) return;
+
+        // moving a request with latency l shrinks the gap only if l < gap.
+        uint32_t gap = max_latency - min_latency;
+        auto &latency_queue = _active_request_latency_queues[max_ch];
+        int best_idx = -1;
+        uint32_t best_diff = UINT32_MAX;
+        for (int i = 0; i < latency_queue.size(); i++) {
+            uint32_t latency = latency_queue[i];
+            if (latency >= gap) continue;
+            // shared prefix rows stay on their channel
+            if (_prefix_cache && _prefix_cache->holds(_active_request_queues[max_ch][i]))
+                continue;
+            uint32_t diff = std::abs((int64_t)latency * 2 - (int64_t)gap);
+            if (diff < best_diff) {
+                best_diff = diff;
+                best_idx = i;
             }
-            for (auto it = list2.begin(); it != list2.end(); it++) {
-                int req_id = *it;
-                Ptr<InferRequest> request = req_queue[req_id];
-                sum_list2_latencies += latency_queue[req_id];
-                _breq2.push_back(request);
-                list2_str += std::to_string(req_id) + ", ";
-                time2_str += std::to_string(latency_queue[req_id]) + ", ";
+        }
+        if (best_idx == -1) return;
+        if (!migrate_request(max_ch, min_ch, best_idx)) return;
+    }
+}
+
+// returns false if dst_ch has no room for the KV cache of the request
+bool Scheduler::migrate_request(uint32_t src_ch, uint32_t dst_ch, int idx) {
+    Ptr<InferRequest> request = _active_request_queues[src_ch][idx];
+    uint32_t mha_latency = _active_request_latency_queues[src_ch][idx];
+    auto k = std::static_pointer_cast<PIMTensor>(request->K_cache[0]);
+    auto v = std::static_pointer_cast<PIMTensor>(request->V_cache[0]);
+
+    if (!kv_fits(dst_ch, request->model, k->get_num_rows() + v->get_num_rows())) return false;
+
+    KVMigration migration{
+        .request_id = request->id,
+        .src_ch = src_ch,
+        .dst_ch = dst_ch,
+    };
+    for (auto kv : {k, v}) {
+        auto src_rows = kv->get_rows();
+        auto dst_rows = kv->migrate(dst_ch);
+        migration.src_rows.insert(migration.src_rows.end(), src_rows.begin(), src_rows.end());
+        migration.dst_rows.insert(migration.dst_rows.end(), dst_rows.begin(), dst_rows.end());
+    }
+
+    _active_request_queues[src_ch].erase(_active_request_queues[src_ch].begin() + idx);
+    _active_request_latency_queues[src_ch].erase(_active_request_latency_queues[src_ch].begin() +
+                                                 idx);
+    _active_request_accum_latencys[src_ch] -= mha_latency;
+
+    _active_request_queues[dst_ch].push_back(request);
+    _active_request_latency_queues[dst_ch].push_back(mha_latency);
+    _active_request_accum_latencys[dst_ch] += mha_latency;
+    request->channel = dst_ch;
+
+    spdlog::info("migrate request#{} KV cache: channel {} -> {} ({} rows)", request->id, src_ch,
+                 dst_ch, migration.src_rows.size());
+    _migrated_requests++;
+    _migrated_rows += migration.src_rows.size();
+    _pending_kv_migrations.push_back(migration);
+    return true;
+}
+
+json Scheduler::checkpoint() {
+    assert(_model_program1 == nullptr && _model_program2 == nullptr);
+    json state;
+    state["stage"] = static_cast<int>(_stage);
+    state["cycles"] = _cycles;
+    state["stage_stats"] = _stage_stats;
+    state["active_reqs"] = _active_reqs;
+    state["next_ch"] = _next_ch;
+    state["available_tiles"] = _available_tiles;
+    state["total_available_tiles"] = _total_available_tiles;
+    state["migrated_requests"] = _migrated_requests;
+    state["migrated_rows"] = _migrated_rows;
+    state["swap_used"] = _swap_used;
+    state["swapped_bytes"] = _swapped_bytes;
+    state["pending_stall_cycles"] = _pending_stall_cycles;
+    state["stall_until"] = _stall_until;
+    state["recomputed_requests"] = _recomputed_requests;
+    state["recomputed_tokens"] = _recomputed_tokens;
+    state["swapped_requests"] = _swapped_requests;
+    state["swapped_total_bytes"] = _swapped_total_bytes;
+    state["admission_policy"] = _admission_policy->checkpoint();
+    state["completed_requests"] = _completed_requests;
+    state["ttft_slo_met"] = _ttft_slo_met;
+    state["tpot_slo_met"] = _tpot_slo_met;
+    state["model_generated"] = _model_generated;
+    state["model_completed"] = _model_completed;
+    state["model_turn"] = _model_turn;
+    state["iterations"] = _iterations;
+    state["iteration_start_cycle"] = _iteration_start_cycle;
+    state["iteration_cluster"] = _iteration_cluster;
+    state["iteration_detailed"] = _iteration_detailed;
+    state["sampler"] = _sampler.checkpoint();
+
+    state["requests"] = json::array();
+    for (auto request : _request_queue) {
+        json req = {{"id", request->id},
+                    {"arrival_cycle", request->arrival_cycle},
+                    {"input_size", request->input_size},
+                    {"output_size", request->output_size},
+                    {"is_initiated", request->is_initiated},
+                    {"generated", request->generated},
+                    {"channel", request->channel},
+                    {"admitted_cycle", request->admitted_cycle},
+                    {"first_token_cycle", request->first_token_cycle},
+                    {"kv_cache", json::array()}};
+        if (request->is_initiated) {
+            for (auto tensor : {request->K_cache[0], request->V_cache[0]}) {
+                auto kv = std::static_pointer_cast<PIMTensor>(tensor);
+                req["kv_cache"].push_back(
+                    {{"dims", kv->get_dims()}, {"channel", kv->_ch}, {"rows", kv->_rows}});
             }
-            // spdlog::info("====Channel {}====", ch);
-            // spdlog::info("#1 sum:{:2d}, idx:[{}], time:[{}]", sum_list1_latencies, list1_str,
-            //              time1_str);
-            // spdlog::info("#2 sum:{:2d}, idx:[{}], time:[{}]", sum_list2_latencies, list2_str,
-            //              time2_str);
-            // spdlog::info("req_q.size:{}, latency_q.size:{}", req_queue.size(),
-            // latency_queue.size());
         }
+        state["requests"].push_back(req);
     }
 
-    spdlog::info("total batch_size: {}", _breq1.size() + _breq2.size());
+    // requests are stored by id
+    auto ids = [](std::vector<Ptr<InferRequest>> &requests) {
+        std::vector<uint32_t> ret;
+        for (auto request : requests) ret.push_back(request->id);
+        return ret;
+    };
+    for (auto &queue : _active_request_queues) state["active_request_queues"].push_back(ids(queue));
+    state["active_request_latency_queues"] = _active_request_latency_queues;
+    state["active_request_accum_latencys"] = _active_request_accum_latencys;
+    for (auto &sub_batch : _sub_batches) state["sub_batches"].push_back(ids(sub_batch));
+    state["sub_batch_models"] = _sub_batch_models;
+
+    state["pending_kv_migrations"] = json::array();
+    for (auto &migration : _pending_kv_migrations) {
+        state["pending_kv_migrations"].push_back({{"request_id", migration.request_id},
+                                                  {"src_ch", migration.src_ch},
+                                                  {"dst_ch", migration.dst_ch},
+                                                  {"src_rows", migration.src_rows},
+                                                  {"dst_rows", migration.dst_rows}});
+    }
+
+    auto alloc = KVCacheAlloc::GetInstance();
+    if (alloc->_mode == RunMode::NPU_PIM) {
+        for (auto &rows : alloc->_rows)
+            state["kv_free_rows"].push_back(std::vector<uint64_t>(rows->begin(), rows->end()));
+    } else {
+        state["kv_free_entries"] =
+            std::vector<addr_type>(alloc->_kv_cache.begin(), alloc->_kv_cache.end());
+    }
+    return state;
 }
 
-// Called exactly once
-void Scheduler::init_batches() {
-    allocate_requests();
-    group_sub_batches();
+// finish_iteration() still rewinds to _init_stage, only the first iteration starts at
+// _resume_stage
+void Scheduler::restore(json state) {
+    _restore_state = state;
+    _resume_stage = static_cast<Stage>(state["stage"].get<int>());
+    _stage = _resume_stage;
+    _iterations = state["iterations"];
+    _cycles = state["cycles"];
+    _stage_stats = state["stage_stats"].get<std::vector<std::pair<std::string, cycle_type>>>();
+    spdlog::info("Scheduler resumes from stage {}", stageToString(_stage));
+}
+
+// The client skips the requests completed before the checkpoint and re-sends the others;
+// requests that arrived after it are new and stay as sent.
+bool Scheduler::restore_batches() {
+    json &state = _restore_state;
+    std::map<uint32_t, Ptr<InferRequest>> requests;
+    for (auto request : _request_queue) requests[request->id] = request;
+    for (auto &req : state["requests"])
+        if (requests.find(req["id"].get<uint32_t>()) == requests.end()) return false;
+
+    for (auto &req : state["requests"]) {
+        uint32_t id = req["id"];
+        Ptr<InferRequest> request = requests[id];
+        request->arrival_cycle = req["arrival_cycle"];
+        request->input_size = req["input_size"];
+        request->output_size = req["output_size"];
+        request->is_initiated = req["is_initiated"];
+        request->generated = req["generated"];
+        request->channel = req["channel"];
+        request->admitted_cycle = req["admitted_cycle"];
+        request->first_token_cycle = req["first_token_cycle"];
+        if (!request->is_initiated) continue;
+
+        // tensors allocate rows on construction; the free lists are overwritten below
+        std::vector<Ptr<PIMTensor>> kv;
+        for (auto type : {PIMTensorKVType::KEY, PIMTensorKVType::VALUE}) {
+            json &saved = req["kv_cache"][kv.size()];
+            auto tensor = std::make_shared<PIMTensor>(
+                name_gen(std::to_string(id), type == PIMTensorKVType::KEY ? "KEY" : "VALUE",
+                         std::to_string(0)),
+                saved["channel"].get<uint32_t>(), saved["dims"].get<std::vector<uint32_t>>(),
+                type, true, _model_configs[request->model].model_n_embd);
+            tensor->_rows = saved["rows"].get<std::vector<uint64_t>>();
+            kv.push_back(tensor);
+        }
+        request->K_cache = {kv[0]};
+        request->V_cache = {kv[1]};
+    }
+
+    auto lookup = [&](json ids) {
+        std::vector<Ptr<InferRequest>> ret;
+        for (uint32_t id : ids) ret.push_back(requests[id]);
+        return ret;
+    };
+    for (int ch = 0; ch < _dram_channels; ch++)
+        _active_request_queues[ch] = lookup(state["active_request_queues"][ch]);
+    _active_request_latency_queues =
+        state["active_request_latency_queues"].get<std::vector<std::vector<uint32_t>>>();
+    _active_request_accum_latencys =
+        state["active_request_accum_latencys"].get<std::vector<uint32_t>>();
+    for (int sb = 0; sb < _num_sub_batches; sb++)
+        _sub_batches[sb] = lookup(state["sub_batches"][sb]);
+    _sub_batch_models = state["sub_batch_models"].get<std::vector<uint32_t>>();
+
+    _pending_kv_migrations.clear();
+    for (auto &migration : state["pending_kv_migrations"]) {
+        _pending_kv_migrations.push_back(KVMigration{
+            .request_id = migration["request_id"],
+            .src_ch = migration["src_ch"],
+            .dst_ch = migration["dst_ch"],
+            .src_rows = migration["src_rows"].get<std::vector<uint64_t>>(),
+            .dst_rows = migration["dst_rows"].get<std::vector<uint64_t>>(),
+        });
+    }
+
+    _active_reqs = state["active_reqs"];
+    _next_ch = state["next_ch"];
+    _available_tiles = state["available_tiles"].get<std::vector<uint32_t>>();
+    _total_available_tiles = state["total_available_tiles"];
+    _migrated_requests = state["migrated_requests"];
+    _migrated_rows = state["migrated_rows"];
+    _swap_used = state["swap_used"];
+    _swapped_bytes = state["swapped_bytes"].get<std::map<uint32_t, uint64_t>>();
+    _pending_stall_cycles = state["pending_stall_cycles"];
+    _stall_until = state["stall_until"];
+    _recomputed_requests = state["recomputed_requests"];
+    _recomputed_tokens = state["recomputed_tokens"];
+    _swapped_requests = state["swapped_requests"];
+    _swapped_total_bytes = state["swapped_total_bytes"];
+    _admission_policy->restore(state["admission_policy"]);
+    _completed_requests = state["completed_requests"];
+    _ttft_slo_met = state["ttft_slo_met"];
+    _tpot_slo_met = state["tpot_slo_met"];
+    _model_generated = state["model_generated"].get<std::vector<uint64_t>>();
+    _model_completed = state["model_completed"].get<std::vector<uint32_t>>();
+    _model_turn = state["model_turn"];
+    _iteration_start_cycle = state["iteration_start_cycle"];
+    _iteration_cluster = state["iteration_cluster"];
+    _iteration_detailed = state["iteration_detailed"];
+    _sampler.restore(state["sampler"]);
+
+    auto alloc = KVCacheAlloc::GetInstance();
+    if (alloc->_mode == RunMode::NPU_PIM) {
+        for (int ch = 0; ch < alloc->_rows.size(); ch++) {
+            auto rows = state["kv_free_rows"][ch].get<std::vector<uint64_t>>();
+            alloc->_rows[ch]->assign(rows.begin(), rows.end());
+        }
+    } else {
+        auto entries = state["kv_free_entries"].get<std::vector<addr_type>>();
+        alloc->_kv_cache.assign(entries.begin(), entries.end());
+    }
+    _restore_state = nullptr;
+    return true;
+}
+
+bool Scheduler::stage_ready() {
+    if (_model_program1 != nullptr || _model_program2 != nullptr) return false;
+    if (!_restore_state.is_null()) return false;  // waits for the requests of the checkpoint
+    return _stage != _init_stage || !_request_queue.empty();
 }
 
 void Scheduler::cycle() {
     bool step_next_stage = _model_program1 == nullptr && _model_program2 == nullptr;
 
-    if (step_next_stage && _stage == _init_stage && !_request_queue.empty()) {
+    if (step_next_stage && !_restore_state.is_null()) {
+        // a checkpoint of the initial stage is taken before its batches are formed
+        if (restore_batches() && _resume_stage == _init_stage) init_batches();
+    } else if (step_next_stage && _stage == _init_stage && !_request_queue.empty()) {
         init_batches();
         // exit(-1);
     }
 
     _cycles++;
 
-    if (_config.sub_batch_mode) {
-        bool lets_make_program1 = _model_program1 == nullptr && _breq1.size() > 0;
-        bool lets_make_program2 = _model_program2 == nullptr && _breq2.size() > 0;
+    bool both_program_none = _model_program1 == nullptr && _model_program2 == nullptr;
+    bool exist_request = false;
+    for (auto &sub_batch : _sub_batches) exist_request = exist_request || sub_batch.size() > 0;
 
-        if (lets_make_program1 && lets_make_program2) {
-            if (_stage == Stage::Finish) {
-                cleanup_sub_batch(_breq1);
-                cleanup_sub_batch(_breq2);
-                _breq1.clear();
-                _breq2.clear();
-                return;
-            } else {
-                std::string red = "\033[1;31m";
-                std::string reset = "\033[0m";
-                spdlog::info("{}----------Stage {}----------{}", red, stageToString(_stage), reset);
-                make_program();
-            }
-        }
-    } else {
-        bool both_program_none = _model_program1 == nullptr && _model_program2 == nullptr;
-        bool exist_request = _breq2.size() > 0 || _breq1.size() > 0;
-        if (both_program_none && exist_request) {
-            if (_stage == Stage::Finish) {
-                cleanup_sub_batch(_breq1);
-                cleanup_sub_batch(_breq2);
-                _breq1.clear();
-                _breq2.clear();
-                return;
-            } else {
-                std::string red = "\033[1;31m";
-                std::string reset = "\033[0m";
-                spdlog::info("{}----------Stage {}----------{}", red, stageToString(_stage), reset);
-                make_program();
+    if (both_program_none && exist_request) {
+        if (_stage == Stage::Finish) {
+            for (auto &sub_batch : _sub_batches) {
+                cleanup_sub_batch(sub_batch);
+                sub_batch.clear();
             }
+            finish_iteration();
+            return;
+        } else {
+            // recompute and swap transfers of preempted requests
+            if (*_core_cycle < _stall_until) return;
+
+            std::string red = "\033[1;31m";
+            std::string reset = "\033[0m";
+            spdlog::info("{}----------Stage {}----------{}", red, stageToString(_stage), reset);
+            EventTrace::record(EventTrace::Type::StageBegin, *_core_cycle, 0,
+                               static_cast<uint32_t>(_stage), sa_sub_batch_idx(_stage),
+                               pim_sub_batch_idx(_stage));
+            make_program();
         }
     }
 }
@@ -433,7 +1050,7 @@ std::shared_ptr<InferRequest> Scheduler::pop_completed_request() {
 }
 
 Tile& Scheduler::top_tile1(uint32_t core_id) {
-    static Tile empty_tile = Tile{.status = Tile::Status::EMPTY};
+    static thread_local Tile empty_tile = Tile{.status = Tile::Status::EMPTY};
     if (_executable_tile_queue1.empty()) {
         return empty_tile;
     } else {
@@ -448,7 +1065,7 @@ Tile& Scheduler::top_tile1(uint32_t core_id) {
 }
 
 Tile& Scheduler::top_tile2(uint32_t core_id) {
-    static Tile empty_tile = Tile{.status = Tile::Status::EMPTY};
+    static thread_local Tile empty_tile = Tile{.status = Tile::Status::EMPTY};
     if (_executable_tile_queue2.empty()) {
         return empty_tile;
     } else {
@@ -481,7 +1098,7 @@ void Scheduler::get_tile1(uint32_t core_id) {
         } else {
             _active_operation_stats[tile.operation_id].launched_tiles++;
             _executable_tile_queue1.pop_front();
-            spdlog::debug("Operation {} Core {} Get Tile at {}", tile.optype, core_id,
+            SPDLOG_DEBUG("Operation {} Core {} Get Tile at {}", tile.optype, core_id,
                           *_core_cycle);
             return;
         }
@@ -504,7 +1121,7 @@ void Scheduler::get_tile2(uint32_t core_id) {
         } else {
             _active_operation_stats[tile.operation_id].launched_tiles++;
             _executable_tile_queue2.pop_front();
-            spdlog::debug("Operation {} Core {} Get Tile at {}", tile.optype, core_id,
+            SPDLOG_DEBUG("Operation {} Core {} Get Tile at {}", tile.optype, core_id,
                           *_core_cycle);
             return;
         }
@@ -516,13 +1133,15 @@ void Scheduler::get_tile2(uint32_t core_id) {
 //      apply to _model_program & return true
 bool Scheduler::finish_tile(uint32_t core_id, Tile& tile) {
     bool result = false;
-    spdlog::debug("Tile {} Core {} Finish Tile at {}", tile.operation_id, core_id, *_core_cycle);
+    SPDLOG_DEBUG("Tile {} Core {} Finish Tile at {}", tile.operation_id, core_id, *_core_cycle);
+    EventTrace::record(EventTrace::Type::TileFinish, *_core_cycle, core_id, tile.operation_id,
+                       tile.batch, static_cast<uint64_t>(tile.stage_platform));
     assert(_active_operation_stats.find(tile.operation_id) != _active_operation_stats.end());
     assert(_finished_operation_stats.find(tile.operation_id) == _finished_operation_stats.end());
     assert(_active_operation_stats[tile.operation_id].remain_tiles > 0);
     _active_operation_stats[tile.operation_id].remain_tiles--;
 
-    spdlog::info("Finish tile stage_platform:{}", stagePlatformToString(tile.stage_platform));
+    SPDLOG_DEBUG("Finish tile stage_platform:{}", stagePlatformToString(tile.stage_platform));
 
     if (tile.stage_platform == StagePlatform::SA)
         _model_program1->finish_operation_tile(tile);
@@ -531,9 +1150,9 @@ bool Scheduler::finish_tile(uint32_t core_id, Tile& tile) {
 
     if (_active_operation_stats[tile.operation_id].remain_tiles == 0) {
         result = true;
-        spdlog::info("Layer {} finish at {}", _active_operation_stats[tile.operation_id].name,
+        SPDLOG_DEBUG("Layer {} finish at {}", _active_operation_stats[tile.operation_id].name,
                      *_core_cycle);
-        spdlog::info("Total compute time {}",
+        SPDLOG_DEBUG("Total compute time {}",
                      *_core_cycle - _active_operation_stats[tile.operation_id].start_cycle);
 
         if (tile.stage_platform == StagePlatform::SA)
@@ -568,6 +1187,9 @@ void Scheduler::cleanup_sub_batch(std::vector<Ptr<InferRequest>> sub_batch) {
         // iteration done -> update request stat in batch
         request->is_initiated = true;
         request->generated++;
+        if (request->generated == 1) request->first_token_cycle = *_core_cycle;
+        _admission_policy->on_token(request);
+        _model_generated[request->model]++;
 
         // clear child operations of Key/Value tensor
         request->K_cache[0]->clear_child_nodes();
@@ -578,6 +1200,15 @@ void Scheduler::cleanup_sub_batch(std::vector<Ptr<InferRequest>> sub_batch) {
             // spdlog::info("Scheduler::return request_id: {}", request->id);
             _completed_request_queue.push(request);
 
+            _completed_requests++;
+            _model_completed[request->model]++;
+            if (request->first_token_cycle - request->arrival_cycle <= request->ttft_slo)
+                _ttft_slo_met++;
+            if (request->generated == 1 ||
+                (*_core_cycle - request->first_token_cycle) / (request->generated - 1) <=
+                    request->tpot_slo)
+                _tpot_slo_met++;
+
             // when completed, free KV cache
             for (auto itr = _request_queue.begin(); itr != _request_queue.end();) {
                 Ptr<InferRequest> cur = *itr;
@@ -600,11 +1231,15 @@ void Scheduler::refresh_stage() {
         std::string reset = "\033[0m";
         std::string stage_name = stageToString(_stage);
         spdlog::info("{}------- Stage {} Done -------{}", red, stage_name, reset);
+        EventTrace::record(EventTrace::Type::StageEnd, *_core_cycle, 0,
+                           static_cast<uint32_t>(_stage));
 
         // Update stat
         _stage_stats.push_back(std::make_pair(stage_name, _cycles));
 
         _prev_stage = _stage;
+        _prev_stage_estimated_pim_cycles = _stage_estimated_pim_cycles;
+        _stage_estimated_pim_cycles = 0;
 
         // Update stage
         int stageValue = static_cast<int>(_stage);
@@ -614,11 +1249,11 @@ void Scheduler::refresh_stage() {
         _has_stage_changed = true;
 
         if (!_config.sub_batch_mode) {
-            // >> newton
-            if (_stage == Stage::C) _stage = Stage::E;
-            if (_stage == Stage::F) _stage = Stage::Finish;
+            // >> newton: skip the steady round (C, D)
+            if (stageValue == stagePeriod()) _stage = static_cast<Stage>(2 * stagePeriod());
             // << newton
         }
+        if (static_cast<int>(_stage) >= num_stages()) _stage = Stage::Finish;
         if (_just_one_stage) _stage = Stage::Finish;  // force to execute just one stage
     }
 }
@@ -658,7 +1293,7 @@ void Scheduler::refresh_status1() {
         // spdlog::info("executable operation count {}",
         //              _model_program1->get_executable_operations().size());
         auto op = _model_program1->get_executable_operations().front();
-        spdlog::info("Start operation {}", op->get_name());
+        SPDLOG_DEBUG("Start operation {}", op->get_name());
         if (count_active_operations()) {
             // for (auto& op_stat : _active_operation_stats) {
             //     spdlog::info("op stat currently in is {}", op_stat.second.name);
@@ -706,7 +1341,7 @@ void Scheduler::refresh_status2() {
         // spdlog::info("executable operation count {}",
         //              _model_program2->get_executable_operations().size());
         auto op = _model_program2->get_executable_operations().front();
-        spdlog::info("Start operation {}", op->get_name());
+        SPDLOG_DEBUG("Start operation {}", op->get_name());
         if (count_active_operations()) {
             if (_active_operation_stats.find(op->get_id()) != _active_operation_stats.end()) {
                 return;
@@ -756,67 +1391,71 @@ std::pair<std::vector<int>, std::vector<int>> Scheduler::partition_lists_simple(
     return std::make_pair(list1, list2);
 }
 
-std::pair<std::vector<int>, std::vector<int>> Scheduler::partition_lists_dp(
-    std::vector<uint32_t> inputList) {
-    int totalSum = 0;
-    for (int num : inputList) {
-        totalSum += num;
+// Karmarkar-Karp largest differencing method for num_lists-way partitioning. O(n log n) for a
+// fixed num_lists. Returns lists of indexes of latency_list, ordered by descending latency sum.
+std::vector<std::vector<int>> Scheduler::partition_lists_kk(std::vector<uint32_t> latency_list,
+                                                            int num_lists) {
+    assert(num_lists > 0);
+
+    // partial partition: num_lists subsets kept in descending order of their sums
+    struct Partition {
+        std::vector<uint64_t> sums;
+        std::vector<std::list<int>> lists;
+        uint64_t spread() const { return sums.front() - sums.back(); }
+    };
+    auto less_spread = [](const Partition &a, const Partition &b) {
+        return a.spread() < b.spread();
+    };
+
+    std::vector<Partition> heap;
+    heap.reserve(latency_list.size());
+    for (int i = 0; i < latency_list.size(); i++) {
+        Partition partition{std::vector<uint64_t>(num_lists, 0),
+                            std::vector<std::list<int>>(num_lists)};
+        partition.sums[0] = latency_list[i];
+        partition.lists[0].push_back(i);
+        heap.push_back(std::move(partition));
     }
-
-    int n = inputList.size();
-    int targetSum = totalSum / 2;
-
-    // Initialize a matrix to store intermediate results
-    std::vector<std::vector<bool>> dp(n + 1, std::vector<bool>(targetSum + 1, false));
-
-    // Base case: an empty subset can always achieve a sum of 0
-    for (int i = 0; i <= n; ++i) {
-        dp[i][0] = true;
-    }
-
-    // Fill the matrix using dynamic programming
-    for (int i = 1; i <= n; ++i) {
-        for (int j = 1; j <= targetSum; ++j) {
-            dp[i][j] = dp[i - 1][j];
-            if (j >= inputList[i - 1]) {
-                dp[i][j] = dp[i][j] || dp[i - 1][j - inputList[i - 1]];
-            }
+    std::make_heap(heap.begin(), heap.end(), less_spread);
+
+    // merge the two partitions with the largest spreads, largest subset with smallest subset
+    while (heap.size() > 1) {
+        std::pop_heap(heap.begin(), heap.end(), less_spread);
+        Partition a = std::move(heap.back());
+        heap.pop_back();
+        std::pop_heap(heap.begin(), heap.end(), less_spread);
+        Partition b = std::move(heap.back());
+        heap.pop_back();
+
+        std::vector<std::pair<uint64_t, int>> order;
+        for (int i = 0; i < num_lists; i++) {
+            int j = num_lists - 1 - i;
+            a.sums[i] += b.sums[j];
+            a.lists[i].splice(a.lists[i].end(), b.lists[j]);
+            order.push_back(std::make_pair(a.sums[i], i));
         }
-    }
+        std::sort(order.begin(), order.end(), std::greater<std::pair<uint64_t, int>>());
 
-    // Find the maximum sum that can be achieved
-    int maxSum = 0;
-    for (int j = targetSum; j >= 0; --j) {
-        if (dp[n][j]) {
-            maxSum = j;
-            break;
+        Partition merged;
+        for (auto &[sum, i] : order) {
+            merged.sums.push_back(sum);
+            merged.lists.push_back(std::move(a.lists[i]));
         }
+        heap.push_back(std::move(merged));
+        std::push_heap(heap.begin(), heap.end(), less_spread);
     }
 
-    // Reconstruct the two lists
-    std::vector<int> list1, list2;
-    int i = n, j = maxSum;
-    while (i > 0 && j > 0) {
-        if (dp[i][j] && !dp[i - 1][j]) {
-            list1.push_back(i - 1);
-            j -= inputList[i - 1];
-        } else {
-            list2.push_back(i - 1);
-        }
-        --i;
+    std::vector<std::vector<int>> ret(num_lists);
+    if (heap.empty()) return ret;
+    for (int i = 0; i < num_lists; i++) {
+        ret[i].assign(heap[0].lists[i].begin(), heap[0].lists[i].end());
+        std::sort(ret[i].begin(), ret[i].end());
     }
-
-    // If there are remaining elements, add them to list1
-    while (i > 0) {
-        list2.push_back(i - 1);
-        --i;
-    }
-
-    return std::make_pair(list1, list2);
+    return ret;
 }
 
 void Scheduler::print_stat() {
-    int prev_cycles = 0;
+    cycle_type prev_cycles = 0;
     for (auto stage_stat : _stage_stats) {
         auto stage_name = stage_stat.first;
         auto stage_cycles = stage_stat.second;
@@ -826,4 +1465,41 @@ void Scheduler::print_stat() {
 
         prev_cycles = stage_cycles;
     }
+
+    if (_kv_migration) {
+        spdlog::info("KV cache migration : {} requests, {} rows", _migrated_requests,
+                     _migrated_rows);
+    }
+
+    if (_ingested_requests > 0) {
+        spdlog::info("KV cache from prefill devices : {} requests, {} rows", _ingested_requests,
+                     _ingested_rows);
+    }
+
+    if (_prefix_cache) _prefix_cache->print_stat();
+
+    if (_recomputed_requests + _swapped_requests > 0) {
+        spdlog::info("Preemption : {} recomputed ({} tokens), {} swapped ({} bytes moved)",
+                     _recomputed_requests, _recomputed_tokens, _swapped_requests,
+                     _swapped_total_bytes);
+    }
+
+    if (_completed_requests > 0) {
+        spdlog::info("SLO attainment ({}) : TTFT {:.2f}%, TPOT {:.2f}% of {} requests",
+                     _config.scheduler_type, 100.0 * _ttft_slo_met / _completed_requests,
+                     100.0 * _tpot_slo_met / _completed_requests, _completed_requests);
+    }
+
+    if (_models.size() > 1) {
+        for (uint32_t m = 0; m < _models.size(); m++) {
+            spdlog::info("Model {} ({}) : {} requests completed, {} tokens generated", m,
+                         _models[m]->get_name(), _model_completed[m], _model_generated[m]);
+        }
+    }
+
+    spdlog::info("Iterations : {}", _iterations);
+    if (_sampler.enabled()) {
+        _sampler.print_stat();
+        _sampler.log(_config.log_dir + "/_sampling");
+    }
 }
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include "../Model.h"
 #include "../ModelProgram.h"
 #include "../StageProgram.h"
+#include "AdmissionPolicy.h"
+#include "IterationSampler.h"
+#include "PIMLatencyModel.h"
+#include "PrefixCache.h"
 
 class Scheduler {
    public:
@@ -22,7 +26,15 @@ class Scheduler {
 
     bool has_stage_changed() { return _has_stage_changed; }
     Stage get_prev_stage() { return _prev_stage; }
+    uint64_t get_prev_stage_estimated_pim_cycles() { return _prev_stage_estimated_pim_cycles; }
     void reset_has_stage_changed_status() { _has_stage_changed = false; }
+    Stage get_stage() { return _stage; }
+    uint32_t get_iterations() { return _iterations; }
+    bool stage_ready();  // the next cycle() starts _stage
+
+    /* checkpoint between stages, when no program is running */
+    json checkpoint();
+    void restore(json state);  // resumes from state["stage"] once the requests have arrived
 
     /* for communicating inference request & response with Client */
     virtual void cycle();
@@ -46,7 +58,8 @@ class Scheduler {
     } RunningOperationStat;
 
     const cycle_type *_core_cycle;
-    Ptr<Model> _model;
+    std::vector<Ptr<Model>> _models;  // indexed by InferRequest::model
+    std::vector<SimulationConfig> _model_configs;
 
     std::unique_ptr<StageProgram> _model_program1;
     std::unique_ptr<StageProgram> _model_program2;
@@ -66,29 +79,48 @@ class Scheduler {
 
     uint32_t count_active_operations();
 
-    uint32_t _cycles;
+    cycle_type _cycles;
     std::deque<std::shared_ptr<InferRequest>> _request_queue;
     std::queue<std::shared_ptr<InferRequest>> _completed_request_queue;
     std::vector<std::vector<Ptr<InferRequest>>> _active_request_queues;
     std::vector<std::vector<uint32_t>> _active_request_latency_queues;
     std::vector<uint32_t> _active_request_accum_latencys;
-    uint32_t _max_batch_size;
-    uint32_t _max_active_reqs;
-
-    std::vector<Ptr<InferRequest>> _breq1;
-    std::vector<Ptr<InferRequest>> _breq2;
+    uint32_t _max_batch_size;   // running requests per iteration
+    uint32_t _max_active_reqs;  // requests holding a KV cache
+    std::unique_ptr<AdmissionPolicy> _admission_policy;
+
+    // SLO attainment of completed requests
+    uint32_t _completed_requests;
+    uint32_t _ttft_slo_met;
+    uint32_t _tpot_slo_met;
+
+    // per model
+    std::vector<uint64_t> _model_generated;
+    std::vector<uint32_t> _model_completed;
+
+    // sub-batch interleaving
+    uint32_t _num_sub_batches;
+    std::vector<std::vector<Ptr<InferRequest>>> _sub_batches;
+    std::vector<uint32_t> _sub_batch_models;  // a sub-batch holds requests of one model
+    uint32_t _model_turn;  // first model of the next iteration if models outnumber sub-batches
+    void partition_channel(const std::vector<Ptr<InferRequest>> &req_queue,
+                           const std::vector<uint32_t> &latency_queue,
+                           const std::vector<uint32_t> &sub_batches, uint32_t &turn);
+    int sa_sub_batch_idx(Stage stage);   // -1 if SA has no sub-batch in the stage
+    int pim_sub_batch_idx(Stage stage);  // -1 if PIM has no sub-batch in the stage
+    uint32_t num_stages();
 
     // channel load balancing
     bool _ch_load_balancing;
     uint32_t _next_ch;
     bool compare_by_seqlen(const Ptr<InferRequest> &a, const Ptr<InferRequest> &b) {
-        return a->input_size > b->input_size;
+        return a->input_size + a->generated > b->input_size + b->generated;
     }
 
-    // model dimension
-    uint32_t _nh;
-    uint32_t _dk;
-    uint32_t _effective_e;
+    // model dimension, per model
+    std::vector<uint32_t> _nh;
+    std::vector<uint32_t> _dk;
+    std::vector<uint32_t> _effective_e;
 
     // memory spec
     uint32_t _dram_channels;
@@ -96,32 +128,88 @@ class Scheduler {
     uint32_t _dram_banks_per_ch;
     uint32_t _gwrite_latency;
     uint32_t _gemv_latency;
+    PIMLatencyModel _pim_latency_model;
+
+    // estimated PIM cycles (avg over channels) of the MHA sub-batch, to compare with NewtonSim
+    uint64_t _stage_estimated_pim_cycles;
+    uint64_t _prev_stage_estimated_pim_cycles;
+    uint64_t estimate_pim_cycles(Ptr<BatchedRequest> sub_batch);
 
     void init_batches();
+    void finish_iteration();  // frees completed requests and rewinds to _init_stage
+    bool restore_batches();  // init_batches() of a restored run, false until the requests arrive
+    json _restore_state;
     void allocate_requests();  // allocate channel & assign kv cache
+    int assign_channel();
+    void rebalance_channels();  // migrate kv cache from the most to the least loaded channel
+    bool migrate_request(uint32_t src_ch, uint32_t dst_ch, int idx);
     void group_sub_batches();  // sub-batch interleaving algorithm
     int estimate_mha_latency(Ptr<InferRequest> request);
 
     int allocate_pim_tile(uint32_t seq_len);
 
     bool _partition_alg_simple;
-    std::pair<std::vector<int>, std::vector<int>> partition_lists_dp(
-        std::vector<uint32_t> latency_list);
+    std::vector<std::vector<int>> partition_lists_kk(std::vector<uint32_t> latency_list,
+                                                     int num_lists);
     std::pair<std::vector<int>, std::vector<int>> partition_lists_simple(
         std::vector<uint32_t> latency_list);
 
     void make_program();
 
+    // KV cache migration between PIM channels
+    bool _kv_migration;
+    double _kv_migration_threshold;
+    std::vector<KVMigration> _pending_kv_migrations;  // issued with the next SA program
+    uint32_t _migrated_requests;
+    uint64_t _migrated_rows;
+    uint32_t _ingested_requests;  // prompt KV caches written from the KV link (prefill_devices)
+    uint64_t _ingested_rows;
+
+    // KV cache preemption when a PIM channel runs out of rows
+    std::string _preemption;         // recompute or swap
+    std::string _preemption_victim;  // lru or priority
+    double _swap_bytes_per_cycle;    // host link
+    uint64_t _swap_space;            // host memory bytes
+    uint64_t _swap_used;
+    std::map<uint32_t, uint64_t> _swapped_bytes;  // request id -> KV cache bytes on the host
+    cycle_type _pending_stall_cycles;  // recompute and swap time charged to the next iteration
+    cycle_type _stall_until;           // the iteration starts its first stage at this cycle
+    uint32_t _recomputed_requests;
+    uint64_t _recomputed_tokens;
+    uint32_t _swapped_requests;
+    uint64_t _swapped_total_bytes;  // out and in
+
+    // KV cache rows of the models: static kv_partition caps a model at _kv_quota_rows per channel
+    std::string _kv_partition;
+    std::vector<uint64_t> _kv_quota_rows;
+    uint64_t kv_rows_held(uint32_t ch, uint32_t model);
+    std::unique_ptr<PrefixCache> _prefix_cache;  // prefix_caching
+    bool kv_fits(uint32_t ch, uint32_t model, uint64_t rows);
+
+    bool has_kv_room(int ch, uint32_t seq_len, uint32_t model, uint32_t shared_rows = 0);
+    void grow_kv_caches();  // adds the generated token, preempting requests on full channels
+    int select_victim(uint32_t ch, int model);  // model -1: any request of the channel
+    void preempt_request(uint32_t ch, int idx);
+    cycle_type recompute_cycles(uint32_t tokens, uint32_t model);
+
     void refresh_stage();
     void finish_program1();
     void finish_program2();
 
     void cleanup_sub_batch(std::vector<Ptr<InferRequest>> sub_batch);
 
+    // iterations (one pass of a batch through all stages)
+    uint32_t _iterations;
+    cycle_type _iteration_start_cycle;
+    IterationSampler _sampler;
+    std::string _iteration_cluster;
+    bool _iteration_detailed;  // false: fast-forwarded by _sampler
+
     uint32_t _active_reqs;
 
     Stage _stage;
     Stage _init_stage;     // default A, if you want to start from other stage, set it
+    Stage _resume_stage;   // stage of the restored checkpoint, for its first iteration only
     bool _just_one_stage;  // default false, if you want to run just one stage, set it
 
     uint32_t _total_tiles;
@@ -143,6 +231,10 @@ class Scheduler {
     // number of layers (variable): N
     // Total execution time: A + B + (C+D)*(N-1) + E + F
     //
+    // stage s runs sub-batch (s mod 2) on SA, and sub-batch ((s - 1) mod 2) on PIM in B..E.
+    // Without sub_batch_mode (newton) there is only sub-batch#1: the stages of #2 idle and the
+    // steady round is skipped.
+    //
 
-    std::vector<std::pair<std::string, uint32_t>> _stage_stats;
+    std::vector<std::pair<std::string, cycle_type>> _stage_stats;
 };
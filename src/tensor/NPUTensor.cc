@@ -79,6 +79,7 @@ NPUTensor::NPUTensor(std::string name, Ptr<NPUTensor2D> tensor, bool produced) {
     _produced = produced;
     _precision = Config::global_config.precision;
     _inners = {tensor};
+    _is_transposed = false;
 }
 
 void NPUTensor::set_transposed() {
@@ -2,28 +2,56 @@
 
 #include "../allocator/AddressAllocator.h"
 
-NPUTensor2D::NPUTensor2D(std::vector<uint32_t> dims, NPUTensorBufType buf_type)
+NPUTensor2D::NPUTensor2D(std::vector<uint32_t> dims, NPUTensorBufType buf_type, bool allocate)
     : NPUTensorInner(dims, buf_type) {
-    _size = Config::global_config.precision;
+    // weights are stored packed at weight_dtype
+    _bits = buf_type == NPUTensorBufType::WGT ? Config::global_config.weight_bits : 8 * _precision;
+    _size = _bits;
     for (auto dim : dims) {
         _size *= dim;
     }
+    _size = (_size + 7) / 8;
 
-    if (buf_type == NPUTensorBufType::WGT)
+    _row_pitch = ((uint64_t)dims.back() * _bits + 7) / 8;
+    _first_channel = 0;
+    _channels = 0;
+    if (buf_type == NPUTensorBufType::WGT && dims.size() == 2) {
+        _row_pitch = WgtAlloc::GetInstance()->row_pitch(_row_pitch);
+        if (allocate) _base_addr = WgtAlloc::GetInstance()->allocate(dims[0] * _row_pitch);
+    } else if (buf_type == NPUTensorBufType::WGT)
         _base_addr = WgtAlloc::GetInstance()->allocate(_size);
     else if (buf_type == NPUTensorBufType::ACT)
         _base_addr = ActAlloc::GetInstance()->allocate(_size);
 }
 
+// a weight allocated by the caller on `channels` channels from first_channel, see
+// WgtAlloc::allocate_experts
+void NPUTensor2D::place(addr_type base_addr, uint32_t first_channel, uint32_t channels) {
+    ast(_dims.size() == 2 && _buf_type == NPUTensorBufType::WGT);
+    _base_addr = base_addr;
+    _first_channel = first_channel;
+    _channels = channels;
+}
+
+// bytes into the tensor -> linear address. A placed tensor takes the interleave units of its
+// channels in turn, stripe after stripe.
+addr_type NPUTensor2D::linear(uint64_t bytes) {
+    if (_channels == 0) return _base_addr + bytes;
+    uint64_t unit = AddressConfig::alignment << AddressConfig::linear_layout.pos[AddressConfig::CH];
+    uint64_t stripe = unit * Config::global_config.dram_channels;
+    uint64_t units = bytes / unit;
+    return _base_addr + units / _channels * stripe + (_first_channel + units % _channels) * unit +
+           bytes % unit;
+}
+
 addr_type NPUTensor2D::get_addr(std::vector<uint32_t> indexes) {
     assert(indexes.size() == _dims.size());
 
     if (indexes.size() == 1)  // bias
-        return _base_addr + indexes[0] * _precision;
+        return _base_addr + offset(indexes[0]);
 
     // return _base_addr + (indexes[0] * _dims[1] + indexes[1]) * _precision;
-    return AddressConfig::switch_co_ch(_base_addr +
-                                       (indexes[0] * _dims[1] + indexes[1]) * _precision);
+    return AddressConfig::linear_to_dram(linear(indexes[0] * _row_pitch + offset(indexes[1])));
 }
 
 std::vector<addr_type> NPUTensor2D::get_all_addrs() {
@@ -31,12 +59,12 @@ std::vector<addr_type> NPUTensor2D::get_all_addrs() {
 
     if (_dims.size() == 1) {
         for (uint32_t i = 0; i < _dims[0]; i++) {
-            ret.push_back(_base_addr + i * _precision);
+            ret.push_back(_base_addr + offset(i));
         }
     } else {
         for (uint32_t i = 0; i < _dims[0]; i++) {
             for (uint32_t j = 0; j < _dims[1]; j++) {
-                ret.push_back(_base_addr + (i * _dims[1] + j) * _precision);
+                ret.push_back(linear(i * _row_pitch + offset(j)));
             }
         }
     }
@@ -48,13 +76,13 @@ std::vector<addr_type> NPUTensor2D::get_row_addrs(uint32_t row_idx) {
     // _dims: [row, column]
     uint32_t col_size = _dims[1];
     for (uint32_t j = 0; j < col_size; j++) {
-        ret.push_back(_base_addr + (row_idx * col_size + j) * _precision);
+        ret.push_back(linear(row_idx * _row_pitch + offset(j)));
     }
     return ret;
 }
 
 std::vector<Ptr<NPUTensor2D>> NPUTensor2D::split_by_row(std::vector<uint32_t> row_dims) {
-    ast(_dims.size() == 2);
+    ast(_dims.size() == 2 && _channels == 0);
     ast(std::accumulate(row_dims.begin(), row_dims.end(), 0) == _dims[0]);
 
     std::vector<Ptr<NPUTensor2D>> ret;
@@ -63,11 +91,15 @@ std::vector<Ptr<NPUTensor2D>> NPUTensor2D::split_by_row(std::vector<uint32_t> ro
 
     for (auto row_dim : row_dims) {
         auto tensor = std::make_shared<NPUTensor2D>();
-        tensor->_base_addr = get_addr({base_idx, 0});
+        tensor->_base_addr = _base_addr + base_idx * _row_pitch;  // linear, not yet mapped
         tensor->_dims = {row_dim, column_size};
-        tensor->_size = _precision * row_dim * column_size;
+        tensor->_size = ((uint64_t)row_dim * column_size * _bits + 7) / 8;
         tensor->_buf_type = _buf_type;
         tensor->_precision = _precision;
+        tensor->_bits = _bits;
+        tensor->_first_channel = 0;
+        tensor->_channels = 0;
+        tensor->_row_pitch = _row_pitch;
         ret.push_back(tensor);
         base_idx += row_dim;
     }
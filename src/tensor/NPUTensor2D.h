@@ -5,9 +5,19 @@
 class NPUTensor2D : public NPUTensorInner {
    public:
     NPUTensor2D() = default;
-    NPUTensor2D(std::vector<uint32_t> dims, NPUTensorBufType buf_type);
+    NPUTensor2D(std::vector<uint32_t> dims, NPUTensorBufType buf_type, bool allocate = true);
+    void place(addr_type base_addr, uint32_t first_channel, uint32_t channels);
     virtual addr_type get_addr(std::vector<uint32_t> indexes);
     virtual std::vector<addr_type> get_all_addrs();
     std::vector<addr_type> get_row_addrs(uint32_t row_idx);
     std::vector<Ptr<NPUTensor2D>> split_by_row(std::vector<uint32_t> row_dims);
+
+    uint64_t _row_pitch;  // bytes between rows, padded for striped weights
+    uint32_t _bits;       // per element, weight_bits for weights
+    uint32_t _first_channel;
+    uint32_t _channels;  // a placed weight lives on these channels only, 0 = all
+
+   private:
+    addr_type offset(uint32_t idx) { return (uint64_t)idx * _bits / 8; }  // of a column in a row
+    addr_type linear(uint64_t bytes);
 };
\ No newline at end of file
@@ -41,7 +41,7 @@ addr_type NPUTensorKV::get_addr(std::vector<uint32_t> indexes) {
     uint32_t idx = floor((double)seq_idx / (double)_kv_cache_entry_size);
     addr_type base_addr = _bases[idx];
     uint32_t offset = ((seq_idx % _kv_cache_entry_size) * dk + byte_idx) * _precision;
-    return AddressConfig::switch_co_ch(base_addr + offset);
+    return AddressConfig::linear_to_dram(base_addr + offset);
 }
 
 std::vector<addr_type> NPUTensorKV::get_all_addrs() {
@@ -3,7 +3,8 @@
 #include "../allocator/AddressAllocator.h"
 
 PIMTensor::PIMTensor(std::string name, uint32_t ch, std::vector<uint32_t> dims,
-                     PIMTensorKVType kv_type, bool produced) {
+                     PIMTensorKVType kv_type, bool produced, uint32_t E,
+                     std::vector<uint64_t> shared_rows) {
     _name = name;
     _ch = ch;
     _dims = dims;  // [h, seq_len, d_k] or [h, d_k, seq_len]
@@ -15,7 +16,7 @@ PIMTensor::PIMTensor(std::string name, uint32_t ch, std::vector<uint32_t> dims,
     _seq_len = kv_type == PIMTensorKVType::KEY ? dims[2] : dims[1];
     _bank_per_ch = alloc->_bank_per_ch;
     _num_ele_per_row = alloc->_num_ele_per_row;
-    _E = Config::global_config.model_n_embd;
+    _E = E;
 
     uint32_t num_alloc_iter = 0;  // calculate # of allocation iterations based on seq_len.
     if (kv_type == PIMTensorKVType::KEY) {
@@ -30,7 +31,10 @@ PIMTensor::PIMTensor(std::string name, uint32_t ch, std::vector<uint32_t> dims,
 
     uint32_t num_required_alloc = num_alloc_iter * _num_rows_per_alloc;
 
-    for (int i = 0; i < num_required_alloc; ++i) _rows.push_back(alloc->allocate(ch));
+    ast(shared_rows.size() <= num_required_alloc && shared_rows.size() % _num_rows_per_alloc == 0);
+    _rows = shared_rows;
+    _shared_rows = shared_rows.size();
+    for (int i = _rows.size(); i < num_required_alloc; ++i) _rows.push_back(alloc->allocate(ch));
 }
 
 addr_type PIMTensor::get_addr(std::vector<uint32_t> indexes) { return 0; }
@@ -40,11 +44,14 @@ std::vector<addr_type> PIMTensor::get_all_addrs() {
     return ret;
 }
 
+// tokens that fit in the allocated rows: a KEY allocation holds _bank_per_ch tokens, a VALUE
+// allocation holds _num_ele_per_row tokens
 uint32_t PIMTensor::get_allocated_seq_len() {
+    uint32_t num_allocs = _rows.size() / _num_rows_per_alloc;
     if (_kv_type == PIMTensorKVType::KEY)
-        return ceil((double)_seq_len / (double)_bank_per_ch) * _bank_per_ch;
+        return num_allocs * _bank_per_ch;
     else
-        return ceil((double)_seq_len / (double)_num_ele_per_row) * _num_ele_per_row;
+        return num_allocs * _num_ele_per_row;
 }
 
 void PIMTensor::add_token() {
@@ -62,6 +69,47 @@ void PIMTensor::add_token() {
 
 uint32_t PIMTensor::get_num_rows() { return _rows.size(); }
 
+uint32_t PIMTensor::get_num_owned_rows() { return _rows.size() - _shared_rows; }
+
+uint32_t PIMTensor::get_num_rows_to_add_token() {
+    return _seq_len + 1 <= get_allocated_seq_len() ? 0 : _num_rows_per_alloc;
+}
+
+// rows the constructor allocates for seq_len tokens
+uint32_t PIMTensor::get_num_rows(PIMTensorKVType kv_type, uint32_t seq_len, uint32_t E) {
+    auto alloc = KVCacheAlloc::GetInstance();
+    if (kv_type == PIMTensorKVType::KEY)
+        return ceil((double)E / alloc->_num_ele_per_row) *
+               ceil((double)seq_len / alloc->_bank_per_ch);
+    return ceil((double)E / alloc->_bank_per_ch) * ceil((double)seq_len / alloc->_num_ele_per_row);
+}
+
 uint32_t PIMTensor::get_channel() { return _ch; }
 
-std::vector<uint64_t> PIMTensor::get_rows() { return _rows; }
\ No newline at end of file
+std::vector<uint64_t> PIMTensor::get_rows() { return _rows; }
+std::vector<uint64_t> PIMTensor::migrate(uint32_t ch) {
+    auto alloc = KVCacheAlloc::GetInstance();
+    ast(_shared_rows == 0);
+    ast(alloc->_rows[ch]->size() >= _rows.size());
+
+    std::vector<uint64_t> new_rows;
+    for (int i = 0; i < _rows.size(); ++i) new_rows.push_back(alloc->allocate(ch));
+    for (auto row : _rows) alloc->free(_ch, row);
+
+    _ch = ch;
+    _rows = new_rows;
+    return new_rows;
+}
+
+void PIMTensor::free() {
+    auto alloc = KVCacheAlloc::GetInstance();
+    for (int i = _shared_rows; i < _rows.size(); ++i) alloc->free(_ch, _rows[i]);
+    _rows.clear();
+    _shared_rows = 0;
+}
+
+// whole allocations only, the tokens after them keep being written into owned rows
+void PIMTensor::share(uint32_t rows) {
+    ast(rows >= _shared_rows && rows <= _rows.size() && rows % _num_rows_per_alloc == 0);
+    _shared_rows = rows;
+}
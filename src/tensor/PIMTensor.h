@@ -7,8 +7,10 @@ enum class PIMTensorKVType { KEY, VALUE };
 class PIMTensor : public BTensor {
    public:
     PIMTensor() = default;
+    // E: model_n_embd of the model the KV cache belongs to
+    // shared_rows: leading rows of a cached prefix (PrefixCache), used instead of new ones
     PIMTensor(std::string name, uint32_t ch, std::vector<uint32_t> dims, PIMTensorKVType kv_type,
-              bool produced);
+              bool produced, uint32_t E, std::vector<uint64_t> shared_rows = {});
     ~PIMTensor() = default;
 
     virtual addr_type get_addr(std::vector<uint32_t> indexes) override;
@@ -18,9 +20,18 @@ class PIMTensor : public BTensor {
 
     uint32_t get_allocated_seq_len();
     uint32_t get_num_rows();
+    uint32_t get_num_owned_rows();  // rows freed with the tensor, i.e. not the shared ones
+    uint32_t get_num_rows_to_add_token();  // rows the next add_token() allocates
+    static uint32_t get_num_rows(PIMTensorKVType kv_type, uint32_t seq_len, uint32_t E);
     uint32_t get_channel();
     std::vector<uint64_t> get_rows();
 
+    // move the tensor to DRAM channel `ch`: allocate the same # of rows there and free the old
+    // rows. returns the newly allocated rows (in the order of the old rows).
+    std::vector<uint64_t> migrate(uint32_t ch);
+    void free();  // return the owned rows to KVCacheAlloc
+    void share(uint32_t rows);  // hand the leading rows over to PrefixCache
+
     PIMTensorKVType _kv_type;
     uint32_t _bank_per_ch;
     uint32_t _E;
@@ -31,5 +42,6 @@ class PIMTensor : public BTensor {
 
     uint32_t _ch;                 // DRAM channel
     std::vector<uint64_t> _rows;  // store the row index allocated from KVCache.
+    uint32_t _shared_rows;        // leading rows owned by PrefixCache
     uint32_t _seq_len;
 };
\ No newline at end of file
@@ -1,4 +1,6 @@
+import json
 import math
+import sys
 from functools import reduce
 
 # memory spec parameters
@@ -7,6 +9,15 @@ _dram_banks_per_ch = 32
 _gwrite_latency = 100
 _gemv_latency = 184
 
+
+# use latencies fitted by the simulator (`pim_calibration`), written to {log_dir}/pim_latency.json
+def load_pim_latency(path):
+    global _gwrite_latency, _gemv_latency
+    with open(path) as f:
+        latency = json.load(f)
+    _gwrite_latency = latency["gwrite_latency"]
+    _gemv_latency = latency["gemv_latency"]
+
 # model spec
 E = 4096
 n_tp = 4
@@ -50,7 +61,9 @@ def distribute_requests(new_seq_lens, channels_seqlen, k):
         
     return channels_seqlen 
 
-# Example usage:
+# Example usage: python channel_load_balancing.py [{log_dir}/pim_latency.json]
+if len(sys.argv) > 1:
+    load_pim_latency(sys.argv[1])
 request_lengths = [5, 8, 3, 2, 7]
 channels_seqlen = [[4, 6], [8, 1], [3, 9]]
 k = 3
@@ -341,10 +341,10 @@ def ff(f):
 def write_output(fname, idx, ongoing_requests):
     fname += f"{idx}.csv"
     
-    data = [["seq_len", "ch_idx"]]
+    data = [["seq_len", "ch_idx", "output_len"]]
     with open(fname, 'w') as f:
         writer = csv.writer(f)
-        data.extend([[r.get_seq_len(), r.channel] for r in ongoing_requests])
+        data.extend([[r.get_seq_len(), r.channel, r.output_tok - r.generated_tok] for r in ongoing_requests])
         writer.writerows(data)
 
 